@@ -0,0 +1,32 @@
+#!/usr/bin/env bash
+# Compare memory and CPU of the Chromium flag presets on the long chat benchmark
+#
+# Usage: bench/flag-presets.sh [path/to/chatgpt-desktop-unix-longchat-bench] [extra bench options...]
+set -euo pipefail
+
+benchBinary="${1:-build/chatgpt-desktop-unix-longchat-bench}"
+shift || true
+presets=(off low-memory balanced throughput software-rendering)
+
+if [[ ! -x "$benchBinary" ]]; then
+  echo "Benchmark binary not found: $benchBinary" >&2
+  exit 1
+fi
+
+reportDirectory="$(mktemp -d)"
+trap 'rm -rf "$reportDirectory"' EXIT
+
+# Pull one numeric field out of the indented report JSON
+metric() {
+  awk -v key="\"$2\":" '$1 == key { gsub(/,/, "", $2); print $2 }' "$1"
+}
+
+printf '%-20s %12s %12s %14s %14s %12s\n' preset renderer-rss browser-rss renderer-cpu browser-cpu frame-p95
+for preset in "${presets[@]}"; do
+  report="$reportDirectory/$preset.json"
+  QT_QPA_PLATFORM="${QT_QPA_PLATFORM:-offscreen}" QTWEBENGINE_DISABLE_SANDBOX=1 \
+    "$benchBinary" --performance-preset="$preset" --output "$report" "$@" >/dev/null
+  printf '%-20s %10.0fMB %10.0fMB %12.0fms %12.0fms %10.1fms\n' "$preset" \
+    "$(metric "$report" rendererRssMb)" "$(metric "$report" browserRssMb)" \
+    "$(metric "$report" rendererCpuMs)" "$(metric "$report" browserCpuMs)" "$(metric "$report" frameTimeP95Ms)"
+done
@@ -0,0 +1,460 @@
+// Offline long chat benchmark
+// Drives a real ChatView over a synthetic conversation and compares the result with stored baselines
+#include "assetstore.h"
+#include "chatview.h"
+#include "chromiumflags.h"
+#include "clipboardchannel.h"
+#include "processstats.h"
+
+#include <QApplication>
+#include <QByteArray>
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+#include <QUrl>
+#include <QVariant>
+#include <QVariantMap>
+#include <QWebEnginePage>
+#include <QWebEngineScript>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+// setHtml with a trusted base URL gives the page a chatgpt.com location without touching the network
+constexpr auto kBenchBaseUrl = "https://chatgpt.com/c/long-chat-benchmark";
+constexpr int kPollIntervalMs = 250;
+constexpr int kRunTimeoutMs = 240 * 1000;
+constexpr int kViewWidth = 1280;
+constexpr int kViewHeight = 900;
+// Costs where lower is better, counts like frames or passes depend on the host and are only reported
+const QStringList kGatedMetrics = {
+    QStringLiteral("frameTimeP50Ms"),    QStringLiteral("frameTimeP95Ms"),    QStringLiteral("frameTimeP99Ms"),
+    QStringLiteral("longTasks"),         QStringLiteral("longTaskTotalMs"),   QStringLiteral("updatePassTotalMs"),
+    QStringLiteral("updatePassMaxMs"),   QStringLiteral("documentElements"), QStringLiteral("jsHeapMb"),
+    QStringLiteral("rendererRssMb"),     QStringLiteral("pageClickP95Ms"),   QStringLiteral("copyClickP95Ms")};
+
+struct BenchOptions {
+  int turns = 2000;
+  int codeEvery = 4;
+  int tokensPerSecond = 40;
+  int settleMs = 2000;
+  int streamSeconds = 5;
+  int scrollSeconds = 5;
+  QString baselinePath;
+  QString outputPath;
+  double tolerance = 1.5;
+  bool updateBaseline = false;
+};
+
+// The page builds its own turns so the HTML stays far below the setHtml size limit
+const QString kBenchPageTemplate = QStringLiteral(R"__html__(<!doctype html>
+<html><head><meta charset="utf-8"><title>long chat benchmark</title>
+<style>
+html, body { margin: 0; height: 100%; }
+main { height: 100vh; overflow-y: auto; font: 14px sans-serif; }
+article { padding: 12px 24px; border-bottom: 1px solid #ddd; }
+pre { background: #f4f4f4; padding: 8px; overflow-x: auto; }
+</style></head>
+<body><main id="thread"></main>
+<script>
+(() => {
+  const config = __BENCH_CONFIG__;
+  const thread = document.getElementById("thread");
+  const words = ["render", "layout", "token", "stream", "scroll", "memory", "paint", "chat", "script", "frame"];
+  const sentence = (seed, count) => {
+    const out = [];
+    for (let index = 0; index < count; ++index) {
+      out.push(words[(seed * 7 + index * 13) % words.length]);
+    }
+    return `${out.join(" ")}.`;
+  };
+
+  const buildTurn = (index) => {
+    const role = index % 2 === 0 ? "user" : "assistant";
+    const article = document.createElement("article");
+    article.setAttribute("data-testid", `conversation-turn-${index}`);
+    const body = document.createElement("div");
+    body.setAttribute("data-message-author-role", role);
+    for (let paragraph = 0; paragraph < (role === "user" ? 1 : 4); ++paragraph) {
+      const node = document.createElement("p");
+      node.textContent = sentence(index + paragraph, 40);
+      body.appendChild(node);
+    }
+    const assistantIndex = (index - 1) / 2;
+    if (role === "assistant" && config.codeEvery > 0 && assistantIndex % config.codeEvery === 0) {
+      const pre = document.createElement("pre");
+      const code = document.createElement("code");
+      code.textContent = Array.from({ length: 24 }, (_, line) => `const value${line} = compute(${index}, ${line});`)
+        .join("\n");
+      pre.appendChild(code);
+      body.appendChild(pre);
+      const copyButton = document.createElement("button");
+      copyButton.setAttribute("aria-label", "Copy code");
+      copyButton.textContent = "Copy";
+      body.appendChild(copyButton);
+    }
+    article.appendChild(body);
+    return article;
+  };
+
+  const results = { frameTimesMs: [], longTasks: 0, longTaskTotalMs: 0, done: false };
+  window.__benchResults = results;
+  try {
+    new PerformanceObserver((list) => {
+      for (const entry of list.getEntries()) {
+        ++results.longTasks;
+        results.longTaskTotalMs += entry.duration;
+      }
+    }).observe({ type: "longtask", buffered: true });
+  } catch (_) {
+  }
+
+  let recording = false;
+  let lastFrameAt = 0;
+  const onFrame = (now) => {
+    if (recording && lastFrameAt > 0) {
+      results.frameTimesMs.push(now - lastFrameAt);
+    }
+    lastFrameAt = now;
+    if (!results.done) {
+      requestAnimationFrame(onFrame);
+    }
+  };
+
+  const wait = (ms) => new Promise((resolve) => setTimeout(resolve, ms));
+
+  const stream = async () => {
+    const turn = buildTurn(config.turns + 1);
+    const target = turn.querySelector("p");
+    target.textContent = "";
+    thread.appendChild(turn);
+    const tokenGapMs = 1000 / Math.max(1, config.tokensPerSecond);
+    const endAt = performance.now() + config.streamSeconds * 1000;
+    for (let token = 0; performance.now() < endAt; ++token) {
+      const span = document.createElement("span");
+      span.textContent = `${words[token % words.length]} `;
+      target.appendChild(span);
+      thread.scrollTop = thread.scrollHeight;
+      await wait(tokenGapMs);
+    }
+  };
+
+  const scrollToTop = () => new Promise((resolve) => {
+    const startedAt = performance.now();
+    const from = thread.scrollTop;
+    const step = (now) => {
+      const progress = Math.min(1, (now - startedAt) / (config.scrollSeconds * 1000));
+      thread.scrollTop = from * (1 - progress);
+      if (progress < 1) {
+        requestAnimationFrame(step);
+        return;
+      }
+      resolve();
+    };
+    requestAnimationFrame(step);
+  });
+
+  const turns = document.createDocumentFragment();
+  for (let index = 0; index < config.turns; ++index) {
+    turns.appendChild(buildTurn(index));
+  }
+  thread.appendChild(turns);
+  thread.scrollTop = thread.scrollHeight;
+
+  // Synchronous dispatch covers every capturing pointerdown handler, the copy bridge included
+  const timeClicks = (targets, limit) => {
+    const samples = [];
+    const stride = Math.max(1, Math.floor(targets.length / limit));
+    for (let index = 0; index < targets.length && samples.length < limit; index += stride) {
+      const startedAt = performance.now();
+      const event = new PointerEvent("pointerdown", { bubbles: true, cancelable: true, composed: true });
+      targets[index].dispatchEvent(event);
+      samples.push(performance.now() - startedAt);
+    }
+    return samples;
+  };
+
+  const measureClicks = () => {
+    // Text next to code blocks is where clicks used to pay for a page search, copy buttons also hand off the copy
+    const codeTurns = Array.from(thread.querySelectorAll("article pre"), (pre) => pre.closest("article"));
+    results.pageClickMs = timeClicks(codeTurns.map((turn) => turn.querySelector("p")).filter(Boolean), 500);
+    results.copyClickMs = timeClicks(Array.from(thread.querySelectorAll("article pre + button")), 50);
+  };
+
+  (async () => {
+    // The initial build is one long task by design, only the measured phases count
+    await wait(config.settleMs);
+    results.longTasks = 0;
+    results.longTaskTotalMs = 0;
+    recording = true;
+    requestAnimationFrame(onFrame);
+    await stream();
+    await scrollToTop();
+    recording = false;
+    measureClicks();
+    results.done = true;
+  })();
+})();
+</script></body></html>
+)__html__");
+
+const QString kResultsQuery = QStringLiteral("window.__benchResults && window.__benchResults.done"
+                                             " ? window.__benchResults : null");
+const QString kStatsQuery = QStringLiteral("globalThis.__chatgptDesktopLongChatStats"
+                                           " ? Object.assign(globalThis.__chatgptDesktopLongChatStats(),"
+                                           " globalThis.__chatgptDesktopCodeCopyStats?.() ?? {}) : null");
+
+QString BuildBenchPage(const BenchOptions &options) {
+  QJsonObject config;
+  config.insert(QStringLiteral("turns"), options.turns);
+  config.insert(QStringLiteral("codeEvery"), options.codeEvery);
+  config.insert(QStringLiteral("tokensPerSecond"), options.tokensPerSecond);
+  config.insert(QStringLiteral("settleMs"), options.settleMs);
+  config.insert(QStringLiteral("streamSeconds"), options.streamSeconds);
+  config.insert(QStringLiteral("scrollSeconds"), options.scrollSeconds);
+
+  QString page = kBenchPageTemplate;
+  page.replace(QStringLiteral("__BENCH_CONFIG__"),
+               QString::fromUtf8(QJsonDocument(config).toJson(QJsonDocument::Compact)));
+  return page;
+}
+
+double Percentile(std::vector<double> samples, double fraction) {
+  if (samples.empty()) {
+    return 0.0;
+  }
+  std::sort(samples.begin(), samples.end());
+  const size_t rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(samples.size())));
+  return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+}
+
+std::vector<double> Samples(const QVariant &list) {
+  std::vector<double> samples;
+  for (const QVariant &sample : list.toList()) {
+    samples.push_back(sample.toDouble());
+  }
+  return samples;
+}
+
+QJsonObject BuildReport(const QVariantMap &pageResults, const QVariantMap &scriptStats, qint64 rendererBytes) {
+  const std::vector<double> frameTimes = Samples(pageResults.value(QStringLiteral("frameTimesMs")));
+  const std::vector<double> pageClicks = Samples(pageResults.value(QStringLiteral("pageClickMs")));
+  const std::vector<double> copyClicks = Samples(pageResults.value(QStringLiteral("copyClickMs")));
+
+  QJsonObject report;
+  report.insert(QStringLiteral("frames"), static_cast<qint64>(frameTimes.size()));
+  report.insert(QStringLiteral("frameTimeP50Ms"), Percentile(frameTimes, 0.50));
+  report.insert(QStringLiteral("frameTimeP95Ms"), Percentile(frameTimes, 0.95));
+  report.insert(QStringLiteral("frameTimeP99Ms"), Percentile(frameTimes, 0.99));
+  report.insert(QStringLiteral("longTasks"), pageResults.value(QStringLiteral("longTasks")).toDouble());
+  report.insert(QStringLiteral("longTaskTotalMs"), pageResults.value(QStringLiteral("longTaskTotalMs")).toDouble());
+  report.insert(QStringLiteral("updatePasses"), scriptStats.value(QStringLiteral("updatePasses")).toDouble());
+  report.insert(QStringLiteral("updatePassTotalMs"), scriptStats.value(QStringLiteral("updatePassTotalMs")).toDouble());
+  report.insert(QStringLiteral("updatePassMaxMs"), scriptStats.value(QStringLiteral("updatePassMaxMs")).toDouble());
+  report.insert(QStringLiteral("documentElements"), scriptStats.value(QStringLiteral("documentElements")).toDouble());
+  report.insert(QStringLiteral("jsHeapMb"),
+                scriptStats.value(QStringLiteral("usedJsHeapBytes")).toDouble() / (1024.0 * 1024.0));
+  report.insert(QStringLiteral("rendererRssMb"), static_cast<double>(rendererBytes) / (1024.0 * 1024.0));
+  report.insert(QStringLiteral("pageClickP50Ms"), Percentile(pageClicks, 0.50));
+  report.insert(QStringLiteral("pageClickP95Ms"), Percentile(pageClicks, 0.95));
+  report.insert(QStringLiteral("copyClickP50Ms"), Percentile(copyClicks, 0.50));
+  report.insert(QStringLiteral("copyClickP95Ms"), Percentile(copyClicks, 0.95));
+  report.insert(QStringLiteral("copyControlsRegistered"),
+                scriptStats.value(QStringLiteral("registeredControls")).toDouble());
+  report.insert(QStringLiteral("copyClickResolves"), scriptStats.value(QStringLiteral("clickResolves")).toDouble());
+  return report;
+}
+
+// Returns false when any metric in the baseline section is exceeded by more than the tolerance
+bool CheckBaseline(const BenchOptions &options, const QString &section, const QJsonObject &report) {
+  QJsonObject baselines;
+  QFile baselineFile(options.baselinePath);
+  if (baselineFile.open(QIODevice::ReadOnly)) {
+    baselines = QJsonDocument::fromJson(baselineFile.readAll()).object();
+    baselineFile.close();
+  } else if (!options.updateBaseline) {
+    qWarning() << "Failed to open baseline file:" << options.baselinePath;
+    return false;
+  }
+
+  if (options.updateBaseline) {
+    QJsonObject baseline;
+    for (const QString &metric : kGatedMetrics) {
+      baseline.insert(metric, report.value(metric));
+    }
+    baselines.insert(section, baseline);
+    QSaveFile outputFile(options.baselinePath);
+    if (!outputFile.open(QIODevice::WriteOnly)) {
+      qWarning() << "Failed to write baseline file:" << options.baselinePath;
+      return false;
+    }
+    outputFile.write(QJsonDocument(baselines).toJson(QJsonDocument::Indented));
+    return outputFile.commit();
+  }
+
+  bool passed = true;
+  const QJsonObject baseline = baselines.value(section).toObject();
+  // An empty section would pass every run, so the gate stays red until a real run is recorded
+  if (baseline.isEmpty()) {
+    qWarning().noquote() << "No baseline recorded for" << section << "in" << options.baselinePath
+                         << "- run with --update-baseline on the reference host";
+    return false;
+  }
+  for (const QString &metric : kGatedMetrics) {
+    if (!baseline.contains(metric)) {
+      continue;
+    }
+    const double expected = baseline.value(metric).toDouble();
+    const double measured = report.value(metric).toDouble();
+    // Tiny baselines would turn scheduler noise into failures
+    if (measured > expected * options.tolerance && measured - expected > 1.0) {
+      qWarning().noquote() << "Regression in" << section + "." + metric << "measured" << measured << "baseline"
+                           << expected << "tolerance" << options.tolerance;
+      passed = false;
+    }
+  }
+  return passed;
+}
+
+BenchOptions ParseOptions(const QCoreApplication &app) {
+  QCommandLineParser parser;
+  parser.setApplicationDescription(QStringLiteral("Offline long chat benchmark for ChatView"));
+  parser.addHelpOption();
+  const QCommandLineOption turnsOption(QStringLiteral("turns"), QStringLiteral("Conversation turns"),
+                                       QStringLiteral("count"), QStringLiteral("2000"));
+  const QCommandLineOption codeEveryOption(QStringLiteral("code-every"),
+                                           QStringLiteral("One code block per this many answers, 0 for none"),
+                                           QStringLiteral("answers"), QStringLiteral("4"));
+  const QCommandLineOption tokenRateOption(QStringLiteral("tokens-per-second"),
+                                           QStringLiteral("Simulated streaming rate"), QStringLiteral("rate"),
+                                           QStringLiteral("40"));
+  const QCommandLineOption streamOption(QStringLiteral("stream-seconds"), QStringLiteral("Streaming phase length"),
+                                        QStringLiteral("seconds"), QStringLiteral("5"));
+  const QCommandLineOption scrollOption(QStringLiteral("scroll-seconds"), QStringLiteral("Scroll to top duration"),
+                                        QStringLiteral("seconds"), QStringLiteral("5"));
+  const QCommandLineOption baselineOption(QStringLiteral("baseline"), QStringLiteral("Baseline JSON to compare with"),
+                                          QStringLiteral("path"));
+  const QCommandLineOption toleranceOption(QStringLiteral("tolerance"),
+                                           QStringLiteral("Allowed ratio over the baseline"),
+                                           QStringLiteral("ratio"), QStringLiteral("1.5"));
+  const QCommandLineOption updateBaselineOption(QStringLiteral("update-baseline"),
+                                                QStringLiteral("Store this run as the new baseline"));
+  // Read by ChromiumFlags::Apply before QApplication, listed here so the parser accepts it
+  const QCommandLineOption presetOption(QStringLiteral("performance-preset"),
+                                        QStringLiteral("Chromium flag preset to measure"), QStringLiteral("name"));
+  const QCommandLineOption outputOption(QStringLiteral("output"), QStringLiteral("Also write the report here"),
+                                        QStringLiteral("path"));
+  parser.addOptions({turnsOption, codeEveryOption, tokenRateOption, streamOption, scrollOption, baselineOption,
+                     toleranceOption, updateBaselineOption, outputOption, presetOption});
+  parser.process(app);
+
+  BenchOptions options;
+  options.turns = std::max(1, parser.value(turnsOption).toInt());
+  options.codeEvery = std::max(0, parser.value(codeEveryOption).toInt());
+  options.tokensPerSecond = std::max(1, parser.value(tokenRateOption).toInt());
+  options.streamSeconds = std::max(0, parser.value(streamOption).toInt());
+  options.scrollSeconds = std::max(1, parser.value(scrollOption).toInt());
+  options.baselinePath = parser.value(baselineOption);
+  options.tolerance = std::max(1.0, parser.value(toleranceOption).toDouble());
+  options.updateBaseline = parser.isSet(updateBaselineOption);
+  options.outputPath = parser.value(outputOption);
+  return options;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  // Keep the run away from the real profile, its login and its caches
+  QTemporaryDir benchHome;
+  if (!benchHome.isValid()) {
+    qWarning() << "Failed to create a temporary home for the benchmark";
+    return 1;
+  }
+  qputenv("HOME", benchHome.path().toLocal8Bit());
+  qunsetenv("XDG_DATA_HOME");
+  qunsetenv("XDG_CACHE_HOME");
+  // Headless software rendering unless the caller picked something else
+  if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  if (!qEnvironmentVariableIsSet("QTWEBENGINE_CHROMIUM_FLAGS")) {
+    qputenv("QTWEBENGINE_CHROMIUM_FLAGS", "--disable-gpu");
+  }
+  // Same preset selection as the app, so --performance-preset compares them on this host
+  ChromiumFlags::Apply(argc, argv);
+
+  // The profile installs the clipboard and asset scheme handlers, so the schemes have to exist first
+  ClipboardChannel::RegisterUrlScheme();
+  AssetStore::RegisterUrlScheme();
+  QApplication app(argc, argv);
+  QCoreApplication::setOrganizationName(QStringLiteral("chatgpt-desktop-unix"));
+  QCoreApplication::setApplicationName(QStringLiteral("chatgpt-desktop-unix"));
+
+  const BenchOptions options = ParseOptions(app);
+
+  ChatView view(QUrl(QStringLiteral("about:blank")));
+  view.resize(kViewWidth, kViewHeight);
+  view.show();
+  view.setHtml(BuildBenchPage(options), QUrl(QString::fromLatin1(kBenchBaseUrl)));
+
+  int exitCode = 1;
+  QTimer::singleShot(kRunTimeoutMs, &app, []() {
+    qWarning() << "Long chat benchmark timed out";
+    QCoreApplication::exit(1);
+  });
+
+  QTimer pollTimer;
+  pollTimer.setInterval(kPollIntervalMs);
+  QObject::connect(&pollTimer, &QTimer::timeout, &view, [&]() {
+    QWebEnginePage *page = view.page();
+    page->runJavaScript(kResultsQuery, QWebEngineScript::MainWorld, [&, page](const QVariant &pageResults) {
+      if (pageResults.isNull() || !pollTimer.isActive()) {
+        return;
+      }
+      pollTimer.stop();
+
+      // Script stats live in the application world next to the injected scripts
+      page->runJavaScript(kStatsQuery, QWebEngineScript::ApplicationWorld,
+                          [&, page, pageResults](const QVariant &stats) {
+        const qint64 rendererPid = page->renderProcessPid();
+        const qint64 browserPid = QCoreApplication::applicationPid();
+        QJsonObject report = BuildReport(pageResults.toMap(), stats.toMap(), ProcessStats::ResidentBytes(rendererPid));
+        // Whole run costs per process, reported for preset comparisons and never gated
+        report.insert(QStringLiteral("performancePreset"), ChromiumFlags::ActivePreset());
+        report.insert(QStringLiteral("rendererCpuMs"), static_cast<double>(ProcessStats::CpuTimeMs(rendererPid)));
+        report.insert(QStringLiteral("browserCpuMs"), static_cast<double>(ProcessStats::CpuTimeMs(browserPid)));
+        report.insert(QStringLiteral("browserRssMb"),
+                      static_cast<double>(ProcessStats::ResidentBytes(browserPid)) / (1024.0 * 1024.0));
+        const QByteArray reportJson = QJsonDocument(report).toJson(QJsonDocument::Indented);
+        QTextStream(stdout) << reportJson;
+
+        if (!options.outputPath.isEmpty()) {
+          QSaveFile outputFile(options.outputPath);
+          if (outputFile.open(QIODevice::WriteOnly)) {
+            outputFile.write(reportJson);
+            outputFile.commit();
+          }
+        }
+
+        exitCode = 0;
+        if (!options.baselinePath.isEmpty()) {
+          exitCode = CheckBaseline(options, QStringLiteral("default"), report) ? 0 : 1;
+        }
+        QCoreApplication::exit(exitCode);
+      });
+    });
+  });
+  pollTimer.start();
+
+  const int loopResult = app.exec();
+  return loopResult != 0 ? loopResult : exitCode;
+}
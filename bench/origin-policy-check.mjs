@@ -0,0 +1,39 @@
+// Runs the generated trusted-hosts.js against the corpus the native benchmark wrote
+// Usage: node origin-policy-check.mjs <generated trusted-hosts.js> <corpus.tsv>
+import { readFileSync } from "node:fs";
+import { runInNewContext } from "node:vm";
+
+const [scriptPath, corpusPath] = process.argv.slice(2);
+if (!scriptPath || !corpusPath) {
+  console.error("usage: origin-policy-check.mjs <trusted-hosts.js> <corpus.tsv>");
+  process.exit(2);
+}
+
+// The helper only needs the performance mark API from the page
+const context = { performance: { mark() {} } };
+runInNewContext(readFileSync(scriptPath, "utf8"), context);
+const { isTrustedHost, isTrustedLocation } = context.__chatgptDesktopTrustedOrigins;
+
+let hosts = 0;
+let mismatches = 0;
+for (const line of readFileSync(corpusPath, "utf8").split("\n")) {
+  if (line.length === 0) {
+    continue;
+  }
+  const separator = line.lastIndexOf("\t");
+  const host = line.slice(0, separator);
+  const expected = line.slice(separator + 1) === "1";
+  hosts += 1;
+  if (isTrustedHost(host) !== expected) {
+    console.error(`isTrustedHost disagrees with the native matcher for ${JSON.stringify(host)}`);
+    mismatches += 1;
+  }
+  if (isTrustedLocation({ protocol: "https:", hostname: host }) !== expected ||
+      isTrustedLocation({ protocol: "http:", hostname: host })) {
+    console.error(`isTrustedLocation disagrees with the native matcher for ${JSON.stringify(host)}`);
+    mismatches += 1;
+  }
+}
+
+console.log(JSON.stringify({ hosts, mismatches }, null, 2));
+process.exit(mismatches === 0 && hosts > 0 ? 0 : 1);
@@ -0,0 +1,247 @@
+// Trusted origin matcher benchmark
+// Checks the generated matcher against the previous QString implementation over a fixed host corpus, then times both
+#include "originpolicy.h"
+#include "trustedorigins.h"
+
+#include <QByteArray>
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <QUrl>
+#include <algorithm>
+#include <random>
+#include <string_view>
+
+namespace {
+constexpr unsigned kCorpusSeed = 20240601;
+constexpr int kGeneratedHosts = 20000;
+
+struct BenchOptions {
+  int iterations = 200;
+  QString corpusPath;
+  QString outputPath;
+};
+
+// What TrustedOrigins did before the policy was generated, allocating on every call. Case folding is
+// ASCII only like the page helper always was, QString::toLower also mapped İ onto a plain i
+bool ReferenceIsTrustedHost(const QString &host) {
+  if (host.isEmpty()) {
+    return false;
+  }
+  QString normalizedHost = host;
+  for (QChar &character : normalizedHost) {
+    if (character >= u'A' && character <= u'Z') {
+      character = QChar(character.unicode() + (u'a' - u'A'));
+    }
+  }
+  for (const std::string_view domain : OriginPolicy::kTrustedDomains) {
+    const QString domainText = QString::fromLatin1(domain.data(), static_cast<qsizetype>(domain.size()));
+    if (normalizedHost == domainText || normalizedHost.endsWith(QLatin1Char('.') + domainText)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ReferenceIsTrustedBlobOrigin(const QUrl &origin) {
+  const QString originString = origin.toString();
+  const QString blobPrefix = QStringLiteral("blob:https://");
+  if (!originString.startsWith(blobPrefix)) {
+    return false;
+  }
+  const QUrl embeddedOrigin(QStringLiteral("https://") + originString.mid(blobPrefix.size()));
+  return ReferenceIsTrustedHost(embeddedOrigin.host());
+}
+
+QString RandomCase(const QString &text, std::mt19937 &random) {
+  QString mixed = text;
+  std::bernoulli_distribution upper(0.3);
+  for (QChar &character : mixed) {
+    if (upper(random)) {
+      character = character.toUpper();
+    }
+  }
+  return mixed;
+}
+
+// Policy hosts, their lookalikes and unrelated hosts in a fixed order
+QStringList BuildCorpus() {
+  QStringList corpus = {
+      QString(),
+      QStringLiteral("."),
+      QStringLiteral("com"),
+      QStringLiteral("localhost"),
+      QStringLiteral("example.com"),
+      // Unicode lookalikes: dotless i, capital I with dot, Kelvin sign and a fullwidth dot
+      QStringLiteral(u"openaı.com"),
+      QStringLiteral(u"OPENAİ.COM"),
+      QStringLiteral(u"Ka.openai.com.evil"),
+      QStringLiteral(u"chatgpt．com"),
+  };
+  for (const std::string_view domain : OriginPolicy::kTrustedDomains) {
+    const QString host = QString::fromLatin1(domain.data(), static_cast<qsizetype>(domain.size()));
+    corpus << host << host.toUpper() << QStringLiteral("www.") + host << QStringLiteral("a.b.c.") + host
+           << QLatin1Char('.') + host << host + QLatin1Char('.') << QStringLiteral("evil") + host
+           << QStringLiteral("evil-") + host << host + QStringLiteral(".evil.net") << host.mid(1)
+           << QStringLiteral("x") + host.mid(1) << host.chopped(1);
+  }
+
+  const QStringList labels = {QStringLiteral("cdn"),    QStringLiteral("files"), QStringLiteral("auth"),
+                              QStringLiteral("status"), QStringLiteral("api"),   QStringLiteral("ab")};
+  const QStringList foreignDomains = {QStringLiteral("example.com"), QStringLiteral("googleapis.com"),
+                                      QStringLiteral("chatgpt.co"), QStringLiteral("openai.org"),
+                                      QStringLiteral("cloudflare.net")};
+  // Fixed seeds give every run the same hosts
+  std::mt19937 random(kCorpusSeed);
+  std::uniform_int_distribution<int> labelCount(0, 3);
+  std::uniform_int_distribution<qsizetype> labelPick(0, labels.size() - 1);
+  std::uniform_int_distribution<qsizetype> foreignPick(0, foreignDomains.size() - 1);
+  std::uniform_int_distribution<std::size_t> domainPick(0, std::size(OriginPolicy::kTrustedDomains) - 1);
+  std::bernoulli_distribution trusted(0.5);
+  for (int index = 0; index < kGeneratedHosts; ++index) {
+    QString host;
+    for (int label = labelCount(random); label > 0; --label) {
+      host += labels.at(labelPick(random)) + QLatin1Char('.');
+    }
+    if (trusted(random)) {
+      const std::string_view domain = OriginPolicy::kTrustedDomains[domainPick(random)];
+      host += QString::fromLatin1(domain.data(), static_cast<qsizetype>(domain.size()));
+    } else {
+      host += foreignDomains.at(foreignPick(random));
+    }
+    corpus.append(RandomCase(host, random));
+  }
+  return corpus;
+}
+
+double NsPerCall(const QElapsedTimer &timer, qint64 calls) {
+  return static_cast<double>(timer.nsecsElapsed()) / static_cast<double>(std::max<qint64>(1, calls));
+}
+
+BenchOptions ParseOptions(const QCoreApplication &app) {
+  QCommandLineParser parser;
+  parser.setApplicationDescription(QStringLiteral("Checks and times the generated trusted origin matcher"));
+  parser.addHelpOption();
+  const QCommandLineOption iterationsOption(QStringLiteral("iterations"),
+                                            QStringLiteral("Timed passes over the corpus"), QStringLiteral("count"),
+                                            QStringLiteral("200"));
+  const QCommandLineOption corpusOption(QStringLiteral("write-corpus"),
+                                        QStringLiteral("Write the hosts and native verdicts as TSV for the JS check"),
+                                        QStringLiteral("path"));
+  const QCommandLineOption outputOption(QStringLiteral("output"), QStringLiteral("Also write the report here"),
+                                        QStringLiteral("path"));
+  parser.addOptions({iterationsOption, corpusOption, outputOption});
+  parser.process(app);
+
+  BenchOptions options;
+  options.iterations = std::max(1, parser.value(iterationsOption).toInt());
+  options.corpusPath = parser.value(corpusOption);
+  options.outputPath = parser.value(outputOption);
+  return options;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  const BenchOptions options = ParseOptions(app);
+  const QStringList corpus = BuildCorpus();
+
+  int mismatches = 0;
+  int trustedHosts = 0;
+  QByteArray corpusText;
+  for (const QString &host : corpus) {
+    const bool verdict = TrustedOrigins::IsTrustedHost(host);
+    if (verdict != ReferenceIsTrustedHost(host)) {
+      qWarning().noquote() << "Matcher disagrees with the reference for" << host;
+      ++mismatches;
+    }
+    trustedHosts += verdict ? 1 : 0;
+    corpusText += host.toUtf8() + '\t' + (verdict ? '1' : '0') + '\n';
+  }
+  const QStringList blobOrigins = {QStringLiteral("blob:https://chatgpt.com/6f1c2a4e-0d9b-4c1e-9a55-3f2b7d8e1a90"),
+                                   QStringLiteral("blob:https://CDN.OAISTATIC.COM:443/file"),
+                                   QStringLiteral("blob:https://chatgpt.com.evil.net/file"),
+                                   QStringLiteral("blob:null/6f1c2a4e")};
+  QList<QUrl> blobUrls;
+  for (const QString &blobOrigin : blobOrigins) {
+    const QUrl origin(blobOrigin);
+    blobUrls.append(origin);
+    if (TrustedOrigins::IsTrustedClipboardOrigin(origin, QUrl()) != ReferenceIsTrustedBlobOrigin(origin)) {
+      qWarning().noquote() << "Blob origin check disagrees with the reference for" << blobOrigin;
+      ++mismatches;
+    }
+  }
+
+  if (!options.corpusPath.isEmpty()) {
+    QSaveFile corpusFile(options.corpusPath);
+    if (!corpusFile.open(QIODevice::WriteOnly) || corpusFile.write(corpusText) != corpusText.size() ||
+        !corpusFile.commit()) {
+      qWarning() << "Failed to write corpus file:" << options.corpusPath;
+      return 1;
+    }
+  }
+
+  // The sink keeps the compiler from dropping calls whose result is unused
+  qint64 sink = 0;
+  const qint64 hostCalls = static_cast<qint64>(corpus.size()) * options.iterations;
+  QElapsedTimer timer;
+  timer.start();
+  for (int iteration = 0; iteration < options.iterations; ++iteration) {
+    for (const QString &host : corpus) {
+      sink += TrustedOrigins::IsTrustedHost(host) ? 1 : 0;
+    }
+  }
+  const double matcherNs = NsPerCall(timer, hostCalls);
+  timer.restart();
+  for (int iteration = 0; iteration < options.iterations; ++iteration) {
+    for (const QString &host : corpus) {
+      sink += ReferenceIsTrustedHost(host) ? 1 : 0;
+    }
+  }
+  const double referenceNs = NsPerCall(timer, hostCalls);
+
+  const qint64 blobCalls = static_cast<qint64>(blobUrls.size()) * options.iterations * 20;
+  timer.restart();
+  for (int iteration = 0; iteration < options.iterations * 20; ++iteration) {
+    for (const QUrl &origin : blobUrls) {
+      sink += TrustedOrigins::IsTrustedClipboardOrigin(origin, QUrl()) ? 1 : 0;
+    }
+  }
+  const double blobNs = NsPerCall(timer, blobCalls);
+  timer.restart();
+  for (int iteration = 0; iteration < options.iterations * 20; ++iteration) {
+    for (const QUrl &origin : blobUrls) {
+      sink += ReferenceIsTrustedBlobOrigin(origin) ? 1 : 0;
+    }
+  }
+  const double referenceBlobNs = NsPerCall(timer, blobCalls);
+
+  QJsonObject report;
+  report.insert(QStringLiteral("hosts"), static_cast<int>(corpus.size()));
+  report.insert(QStringLiteral("trustedHosts"), trustedHosts);
+  report.insert(QStringLiteral("mismatches"), mismatches);
+  report.insert(QStringLiteral("matcherNsPerHost"), matcherNs);
+  report.insert(QStringLiteral("referenceNsPerHost"), referenceNs);
+  report.insert(QStringLiteral("blobOriginNs"), blobNs);
+  report.insert(QStringLiteral("referenceBlobOriginNs"), referenceBlobNs);
+  report.insert(QStringLiteral("checksum"), static_cast<double>(sink));
+
+  const QByteArray reportJson = QJsonDocument(report).toJson(QJsonDocument::Indented);
+  QTextStream(stdout) << reportJson;
+  if (!options.outputPath.isEmpty()) {
+    QSaveFile outputFile(options.outputPath);
+    if (outputFile.open(QIODevice::WriteOnly)) {
+      outputFile.write(reportJson);
+      outputFile.commit();
+    }
+  }
+  return mismatches == 0 ? 0 : 1;
+}
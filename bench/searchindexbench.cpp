@@ -0,0 +1,342 @@
+// Offline search index benchmark
+// Builds an index over synthetic conversations, then times incremental updates and queries against stored baselines
+#include "conversationsnapshots.h"
+#include "searchindex.h"
+
+#include <QByteArray>
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace {
+constexpr auto kBaselineSection = "default";
+constexpr int kVocabularySize = 50000;
+constexpr unsigned kCorpusSeed = 20240601;
+constexpr int kResultLimit = 50;
+// Updates only touch a slice of the index, like a day of chatting would
+constexpr int kIncrementalConversations = 1000;
+// Costs where lower is better, throughput depends on the host and is only reported
+const QStringList kGatedMetrics = {
+    QStringLiteral("buildMsPerThousandTurns"), QStringLiteral("incrementalUpdateP95Ms"),
+    QStringLiteral("queryP50Ms"),              QStringLiteral("queryP95Ms"),
+    QStringLiteral("queryP99Ms"),              QStringLiteral("prefixQueryP95Ms"),
+    QStringLiteral("indexBytesPerTurn")};
+
+struct BenchOptions {
+  int conversations = 20000;
+  int turns = 8;
+  int wordsPerTurn = 60;
+  int queries = 2000;
+  QString baselinePath;
+  QString outputPath;
+  double tolerance = 1.5;
+  bool updateBaseline = false;
+};
+
+// Pronounceable words so the tokenizer sees realistic lengths
+QStringList BuildVocabulary() {
+  static const char *const kSyllables[] = {"ka", "lo", "mi", "ren", "sta", "tor", "vi", "qu", "en", "dal",
+                                           "po", "sen", "ar", "il", "mu", "ne", "xo", "bri", "che", "fa"};
+  constexpr int kSyllableCount = sizeof(kSyllables) / sizeof(kSyllables[0]);
+  QStringList vocabulary;
+  vocabulary.reserve(kVocabularySize);
+  for (int index = 0; index < kVocabularySize; ++index) {
+    QString word;
+    int rest = index;
+    do {
+      word += QString::fromLatin1(kSyllables[rest % kSyllableCount]);
+      rest /= kSyllableCount;
+    } while (rest > 0);
+    vocabulary.append(word);
+  }
+  return vocabulary;
+}
+
+// Word frequencies in chat text follow Zipf's law, common words get long posting lists
+class ZipfSampler {
+public:
+  explicit ZipfSampler(int size) {
+    m_cumulative.reserve(size);
+    double total = 0.0;
+    for (int rank = 1; rank <= size; ++rank) {
+      total += 1.0 / rank;
+      m_cumulative.push_back(total);
+    }
+  }
+
+  int Sample(std::mt19937 &random) const {
+    std::uniform_real_distribution<double> distribution(0.0, m_cumulative.back());
+    const auto found = std::lower_bound(m_cumulative.cbegin(), m_cumulative.cend(), distribution(random));
+    return static_cast<int>(found - m_cumulative.cbegin());
+  }
+
+private:
+  std::vector<double> m_cumulative;
+};
+
+QString BuildTurnText(const QStringList &vocabulary, const ZipfSampler &sampler, std::mt19937 &random, int words) {
+  QStringList turnWords;
+  turnWords.reserve(words);
+  for (int index = 0; index < words; ++index) {
+    turnWords.append(vocabulary.at(sampler.Sample(random)));
+  }
+  return turnWords.join(QLatin1Char(' '));
+}
+
+ConversationSnapshot::Turn BuildTurn(const QString &text, int turnIndex) {
+  ConversationSnapshot::Turn turn;
+  turn.role = turnIndex % 2 == 0 ? QStringLiteral("user") : QStringLiteral("assistant");
+  turn.blocks.append(ConversationSnapshot::Block{false, QString(), text});
+  return turn;
+}
+
+// Each conversation has its own seed, so an update can rebuild the same turns and add one
+ConversationSnapshot BuildConversation(const QStringList &vocabulary, const ZipfSampler &sampler, int conversation,
+                                       int turns, int wordsPerTurn) {
+  std::mt19937 random(kCorpusSeed + static_cast<unsigned>(conversation));
+  ConversationSnapshot snapshot;
+  for (int turnIndex = 0; turnIndex < turns; ++turnIndex) {
+    snapshot.turns.append(BuildTurn(BuildTurnText(vocabulary, sampler, random, wordsPerTurn), turnIndex));
+  }
+  return snapshot;
+}
+
+QString ConversationKey(int conversation) {
+  return QStringLiteral("chatgpt.com/c/bench-%1").arg(conversation);
+}
+
+double Percentile(std::vector<double> samples, double fraction) {
+  if (samples.empty()) {
+    return 0.0;
+  }
+  std::sort(samples.begin(), samples.end());
+  const size_t rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(samples.size())));
+  return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+}
+
+double ElapsedMs(const QElapsedTimer &timer) { return static_cast<double>(timer.nsecsElapsed()) / 1e6; }
+
+// Returns false when any metric in the baseline section is exceeded by more than the tolerance
+bool CheckBaseline(const BenchOptions &options, const QJsonObject &report) {
+  const QString section = QString::fromLatin1(kBaselineSection);
+  QJsonObject baselines;
+  QFile baselineFile(options.baselinePath);
+  if (baselineFile.open(QIODevice::ReadOnly)) {
+    baselines = QJsonDocument::fromJson(baselineFile.readAll()).object();
+    baselineFile.close();
+  } else if (!options.updateBaseline) {
+    qWarning() << "Failed to open baseline file:" << options.baselinePath;
+    return false;
+  }
+
+  if (options.updateBaseline) {
+    QJsonObject baseline;
+    for (const QString &metric : kGatedMetrics) {
+      baseline.insert(metric, report.value(metric));
+    }
+    baselines.insert(section, baseline);
+    QSaveFile outputFile(options.baselinePath);
+    if (!outputFile.open(QIODevice::WriteOnly)) {
+      qWarning() << "Failed to write baseline file:" << options.baselinePath;
+      return false;
+    }
+    outputFile.write(QJsonDocument(baselines).toJson(QJsonDocument::Indented));
+    return outputFile.commit();
+  }
+
+  bool passed = true;
+  const QJsonObject baseline = baselines.value(section).toObject();
+  // An empty section would pass every run, so the gate stays red until a real run is recorded
+  if (baseline.isEmpty()) {
+    qWarning().noquote() << "No baseline recorded for" << section << "in" << options.baselinePath
+                         << "- run with --update-baseline on the reference host";
+    return false;
+  }
+  for (const QString &metric : kGatedMetrics) {
+    if (!baseline.contains(metric)) {
+      continue;
+    }
+    const double expected = baseline.value(metric).toDouble();
+    const double measured = report.value(metric).toDouble();
+    // Tiny baselines would turn scheduler noise into failures
+    if (measured > expected * options.tolerance && measured - expected > 1.0) {
+      qWarning().noquote() << "Regression in" << section + "." + metric << "measured" << measured << "baseline"
+                           << expected << "tolerance" << options.tolerance;
+      passed = false;
+    }
+  }
+  return passed;
+}
+
+BenchOptions ParseOptions(const QCoreApplication &app) {
+  QCommandLineParser parser;
+  parser.setApplicationDescription(QStringLiteral("Offline benchmark for the conversation search index"));
+  parser.addHelpOption();
+  const QCommandLineOption conversationsOption(QStringLiteral("conversations"), QStringLiteral("Indexed conversations"),
+                                               QStringLiteral("count"), QStringLiteral("20000"));
+  const QCommandLineOption turnsOption(QStringLiteral("turns"), QStringLiteral("Turns per conversation"),
+                                       QStringLiteral("count"), QStringLiteral("8"));
+  const QCommandLineOption wordsOption(QStringLiteral("words-per-turn"), QStringLiteral("Words in every turn"),
+                                       QStringLiteral("count"), QStringLiteral("60"));
+  const QCommandLineOption queriesOption(QStringLiteral("queries"), QStringLiteral("Queries per query kind"),
+                                         QStringLiteral("count"), QStringLiteral("2000"));
+  const QCommandLineOption baselineOption(QStringLiteral("baseline"), QStringLiteral("Baseline JSON to compare with"),
+                                          QStringLiteral("path"));
+  const QCommandLineOption toleranceOption(QStringLiteral("tolerance"),
+                                           QStringLiteral("Allowed ratio over the baseline"),
+                                           QStringLiteral("ratio"), QStringLiteral("1.5"));
+  const QCommandLineOption updateBaselineOption(QStringLiteral("update-baseline"),
+                                                QStringLiteral("Store this run as the new baseline"));
+  const QCommandLineOption outputOption(QStringLiteral("output"), QStringLiteral("Also write the report here"),
+                                        QStringLiteral("path"));
+  parser.addOptions({conversationsOption, turnsOption, wordsOption, queriesOption, baselineOption, toleranceOption,
+                     updateBaselineOption, outputOption});
+  parser.process(app);
+
+  BenchOptions options;
+  options.conversations = std::max(1, parser.value(conversationsOption).toInt());
+  options.turns = std::max(1, parser.value(turnsOption).toInt());
+  options.wordsPerTurn = std::max(1, parser.value(wordsOption).toInt());
+  options.queries = std::max(1, parser.value(queriesOption).toInt());
+  options.baselinePath = parser.value(baselineOption);
+  options.tolerance = std::max(1.0, parser.value(toleranceOption).toDouble());
+  options.updateBaseline = parser.isSet(updateBaselineOption);
+  options.outputPath = parser.value(outputOption);
+  return options;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  QCoreApplication app(argc, argv);
+  const BenchOptions options = ParseOptions(app);
+
+  // A private directory keeps the run away from the real profile's index
+  QTemporaryDir indexDirectory;
+  if (!indexDirectory.isValid()) {
+    qWarning() << "Failed to create a temporary directory for the benchmark";
+    return 1;
+  }
+
+  const QStringList vocabulary = BuildVocabulary();
+  const ZipfSampler sampler(vocabulary.size());
+  // Fixed seeds give every run the same corpus and the same queries
+  std::mt19937 random(kCorpusSeed);
+  QJsonObject report;
+
+  {
+    SearchIndex index(indexDirectory.filePath(QStringLiteral("search-index")));
+    QElapsedTimer buildTimer;
+    buildTimer.start();
+    for (int conversation = 0; conversation < options.conversations; ++conversation) {
+      const ConversationSnapshot snapshot =
+          BuildConversation(vocabulary, sampler, conversation, options.turns, options.wordsPerTurn);
+      index.IndexConversation(ConversationKey(conversation), QStringLiteral("Conversation %1").arg(conversation),
+                              snapshot);
+    }
+    const double buildMs = ElapsedMs(buildTimer);
+    const double builtTurns = static_cast<double>(options.conversations) * options.turns;
+    report.insert(QStringLiteral("buildMs"), buildMs);
+    report.insert(QStringLiteral("buildMsPerThousandTurns"), buildMs * 1000.0 / builtTurns);
+    report.insert(QStringLiteral("indexBytesPerTurn"), static_cast<double>(index.DiskBytes()) / builtTurns);
+  }
+
+  // Reopening measures the cold path the app takes on the first search after a restart
+  SearchIndex index(indexDirectory.filePath(QStringLiteral("search-index")));
+  QElapsedTimer openTimer;
+  openTimer.start();
+  const int indexedConversations = index.ConversationCount();
+  report.insert(QStringLiteral("openMs"), ElapsedMs(openTimer));
+  if (indexedConversations != options.conversations) {
+    qWarning() << "Reopened index holds" << indexedConversations << "conversations, expected" << options.conversations;
+    return 1;
+  }
+
+  // Streaming appends one turn to a conversation that is already indexed
+  std::vector<double> updateMs;
+  updateMs.reserve(kIncrementalConversations);
+  std::uniform_int_distribution<int> conversationDistribution(0, options.conversations - 1);
+  for (int update = 0; update < std::min(kIncrementalConversations, options.conversations); ++update) {
+    const int conversation = conversationDistribution(random);
+    // Earlier turns keep their text, so only the new one is tokenized and written
+    ConversationSnapshot snapshot =
+        BuildConversation(vocabulary, sampler, conversation, options.turns, options.wordsPerTurn);
+    snapshot.turns.append(
+        BuildTurn(BuildTurnText(vocabulary, sampler, random, options.wordsPerTurn), options.turns));
+    QElapsedTimer updateTimer;
+    updateTimer.start();
+    index.IndexConversation(ConversationKey(conversation), QStringLiteral("Conversation %1").arg(conversation),
+                            snapshot);
+    updateMs.push_back(ElapsedMs(updateTimer));
+  }
+  report.insert(QStringLiteral("incrementalUpdateP50Ms"), Percentile(updateMs, 0.50));
+  report.insert(QStringLiteral("incrementalUpdateP95Ms"), Percentile(updateMs, 0.95));
+
+  // One to three whole words, drawn the way they were written
+  std::vector<double> queryMs;
+  queryMs.reserve(options.queries);
+  qint64 totalHits = 0;
+  QElapsedTimer throughputTimer;
+  throughputTimer.start();
+  for (int query = 0; query < options.queries; ++query) {
+    QStringList words;
+    for (int word = 0; word <= query % 3; ++word) {
+      words.append(vocabulary.at(sampler.Sample(random)));
+    }
+    // A trailing space marks the last word as finished, so it does not expand as a prefix
+    const QString queryText = words.join(QLatin1Char(' ')) + QLatin1Char(' ');
+    QElapsedTimer queryTimer;
+    queryTimer.start();
+    totalHits += index.Search(queryText, kResultLimit).size();
+    queryMs.push_back(ElapsedMs(queryTimer));
+  }
+  const double queryTotalMs = ElapsedMs(throughputTimer);
+  report.insert(QStringLiteral("queryP50Ms"), Percentile(queryMs, 0.50));
+  report.insert(QStringLiteral("queryP95Ms"), Percentile(queryMs, 0.95));
+  report.insert(QStringLiteral("queryP99Ms"), Percentile(queryMs, 0.99));
+  report.insert(QStringLiteral("queriesPerSecond"), options.queries * 1000.0 / std::max(1.0, queryTotalMs));
+  report.insert(QStringLiteral("averageHits"), static_cast<double>(totalHits) / options.queries);
+
+  // Typing shows the cost of prefix expansion, a common word plus a partly typed one
+  std::vector<double> prefixQueryMs;
+  prefixQueryMs.reserve(options.queries);
+  for (int query = 0; query < options.queries; ++query) {
+    const QString leadingWord = vocabulary.at(sampler.Sample(random));
+    const QString typedWord = vocabulary.at(sampler.Sample(random));
+    const QString typedPrefix = typedWord.left(std::max<qsizetype>(2, typedWord.size() / 2));
+    const QString queryText = leadingWord + QLatin1Char(' ') + typedPrefix;
+    QElapsedTimer queryTimer;
+    queryTimer.start();
+    index.Search(queryText, kResultLimit);
+    prefixQueryMs.push_back(ElapsedMs(queryTimer));
+  }
+  report.insert(QStringLiteral("prefixQueryP50Ms"), Percentile(prefixQueryMs, 0.50));
+  report.insert(QStringLiteral("prefixQueryP95Ms"), Percentile(prefixQueryMs, 0.95));
+
+  const QByteArray reportJson = QJsonDocument(report).toJson(QJsonDocument::Indented);
+  QTextStream(stdout) << reportJson;
+  if (!options.outputPath.isEmpty()) {
+    QSaveFile outputFile(options.outputPath);
+    if (outputFile.open(QIODevice::WriteOnly)) {
+      outputFile.write(reportJson);
+      outputFile.commit();
+    }
+  }
+  if (options.baselinePath.isEmpty()) {
+    return 0;
+  }
+  return CheckBaseline(options, report) ? 0 : 1;
+}
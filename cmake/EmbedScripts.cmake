@@ -0,0 +1,57 @@
+# Minify injected page scripts and embed them as compile-time constants
+#
+# Expects:
+#   SCRIPT_FILES  semicolon separated list of .js files
+#   OUTPUT_HEADER header file to write
+#
+# Minification is line based on purpose: it drops indentation, blank lines and
+# whole-line // comments but never touches code inside a line, so string and
+# regex literals stay byte for byte the same
+
+if(NOT SCRIPT_FILES OR NOT OUTPUT_HEADER)
+  message(FATAL_ERROR "EmbedScripts.cmake needs SCRIPT_FILES and OUTPUT_HEADER")
+endif()
+
+set(headerText "#pragma once\n\n")
+string(APPEND headerText "// Generated by cmake/EmbedScripts.cmake from resources/scripts, do not edit\n")
+string(APPEND headerText "namespace EmbeddedScripts {\n\n")
+
+foreach(scriptFile IN LISTS SCRIPT_FILES)
+  file(READ "${scriptFile}" scriptText)
+
+  # A leading newline lets the same patterns handle the first line
+  set(scriptText "\n${scriptText}")
+  string(REGEX REPLACE "\n[ \t]+" "\n" scriptText "${scriptText}")
+  string(REGEX REPLACE "\n//[^\n]*" "" scriptText "${scriptText}")
+  string(REGEX REPLACE "[ \t]+\n" "\n" scriptText "${scriptText}")
+  string(REGEX REPLACE "\n\n+" "\n" scriptText "${scriptText}")
+  string(STRIP "${scriptText}" scriptText)
+
+  if(scriptText MATCHES "\\)__js__\"")
+    message(FATAL_ERROR "${scriptFile} contains the raw string delimiter used for embedding")
+  endif()
+
+  # long-chat-performance.js becomes kLongChatPerformance
+  get_filename_component(scriptName "${scriptFile}" NAME_WE)
+  string(REPLACE "-" ";" nameParts "${scriptName}")
+  set(constantName "k")
+  foreach(namePart IN LISTS nameParts)
+    string(SUBSTRING "${namePart}" 0 1 firstLetter)
+    string(SUBSTRING "${namePart}" 1 -1 restOfPart)
+    string(TOUPPER "${firstLetter}" firstLetter)
+    string(APPEND constantName "${firstLetter}${restOfPart}")
+  endforeach()
+
+  string(APPEND headerText "inline constexpr char ${constantName}[] = R\"__js__(${scriptText})__js__\";\n\n")
+endforeach()
+
+string(APPEND headerText "} // namespace EmbeddedScripts\n")
+
+# Skip the write when nothing changed so dependent objects do not rebuild
+if(EXISTS "${OUTPUT_HEADER}")
+  file(READ "${OUTPUT_HEADER}" previousHeaderText)
+  if(previousHeaderText STREQUAL headerText)
+    return()
+  endif()
+endif()
+file(WRITE "${OUTPUT_HEADER}" "${headerText}")
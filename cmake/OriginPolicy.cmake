@@ -0,0 +1,103 @@
+# Generate the trusted origin matcher for C++ and the injected JS helper from one list
+#
+# Expects:
+#   POLICY_FILE     resources/policy/trusted-origins.txt
+#   SCRIPT_TEMPLATE trusted-hosts.js with the domain list placeholder
+#   OUTPUT_HEADER   generated C++ header
+#   OUTPUT_SCRIPT   generated JS helper, embedded like the other injected scripts
+
+if(NOT POLICY_FILE OR NOT SCRIPT_TEMPLATE OR NOT OUTPUT_HEADER OR NOT OUTPUT_SCRIPT)
+  message(FATAL_ERROR "OriginPolicy.cmake needs POLICY_FILE, SCRIPT_TEMPLATE, OUTPUT_HEADER and OUTPUT_SCRIPT")
+endif()
+
+file(STRINGS "${POLICY_FILE}" policyLines)
+set(domains "")
+foreach(policyLine IN LISTS policyLines)
+  string(REGEX REPLACE "#.*$" "" policyLine "${policyLine}")
+  string(STRIP "${policyLine}" policyLine)
+  if(policyLine STREQUAL "")
+    continue()
+  endif()
+  # Both matchers fold ASCII case only, so the list itself must already be lowercase ASCII
+  if(NOT policyLine MATCHES "^[a-z0-9-]+(\\.[a-z0-9-]+)+$")
+    message(FATAL_ERROR "${POLICY_FILE}: '${policyLine}' is not a lowercase ASCII domain")
+  endif()
+  list(APPEND domains "${policyLine}")
+endforeach()
+list(LENGTH domains domainCount)
+if(domainCount EQUAL 0)
+  message(FATAL_ERROR "${POLICY_FILE} lists no trusted domains")
+endif()
+
+set(cppDomains "")
+set(jsDomains "")
+foreach(domain IN LISTS domains)
+  string(APPEND cppDomains "    \"${domain}\",\n")
+  if(NOT jsDomains STREQUAL "")
+    string(APPEND jsDomains ", ")
+  endif()
+  string(APPEND jsDomains "\"${domain}\"")
+endforeach()
+
+set(headerText "#pragma once\n\n")
+string(APPEND headerText
+  "// Generated by cmake/OriginPolicy.cmake from resources/policy/trusted-origins.txt, do not edit\n"
+  "#include <cstddef>\n#include <string_view>\n#include <type_traits>\n\nnamespace OriginPolicy {\n\n"
+)
+string(APPEND headerText "inline constexpr std::string_view kTrustedDomains[] = {\n${cppDomains}};\n\n")
+string(APPEND headerText [=[
+// Same walk as isTrustedHost in trusted-hosts.js: ASCII case folding only, and a domain
+// matches itself or a host ending in "." plus the domain. Works on UTF-16 and UTF-8 units
+template <typename CodeUnit> constexpr bool MatchesTrustedDomain(const CodeUnit *host, std::size_t size) {
+  for (const std::string_view domain : kTrustedDomains) {
+    if (size < domain.size()) {
+      continue;
+    }
+    const std::size_t offset = size - domain.size();
+    if (offset > 0 && host[offset - 1] != CodeUnit('.')) {
+      continue;
+    }
+    std::size_t index = 0;
+    for (; index < domain.size(); ++index) {
+      // Widen first so signed UTF-8 bytes never compare equal to ASCII letters
+      auto unit = static_cast<unsigned long>(static_cast<std::make_unsigned_t<CodeUnit>>(host[offset + index]));
+      if (unit >= 'A' && unit <= 'Z') {
+        unit += 'a' - 'A';
+      }
+      if (unit != static_cast<unsigned char>(domain[index])) {
+        break;
+      }
+    }
+    if (index == domain.size()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace OriginPolicy
+]=])
+
+file(READ "${SCRIPT_TEMPLATE}" scriptText)
+if(NOT scriptText MATCHES "__CHATGPT_DESKTOP_TRUSTED_DOMAINS__")
+  message(FATAL_ERROR "${SCRIPT_TEMPLATE} has no __CHATGPT_DESKTOP_TRUSTED_DOMAINS__ placeholder")
+endif()
+string(REPLACE "__CHATGPT_DESKTOP_TRUSTED_DOMAINS__" "[${jsDomains}]" scriptText "${scriptText}")
+
+# Skip writes when nothing changed so dependent objects do not rebuild
+foreach(output IN ITEMS HEADER SCRIPT)
+  if(output STREQUAL "HEADER")
+    set(outputPath "${OUTPUT_HEADER}")
+    set(outputText "${headerText}")
+  else()
+    set(outputPath "${OUTPUT_SCRIPT}")
+    set(outputText "${scriptText}")
+  endif()
+  if(EXISTS "${outputPath}")
+    file(READ "${outputPath}" previousText)
+    if(previousText STREQUAL outputText)
+      continue()
+    endif()
+  endif()
+  file(WRITE "${outputPath}" "${outputText}")
+endforeach()
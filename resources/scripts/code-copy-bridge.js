@@ -15,10 +15,28 @@
   const nativePrompt = (typeof window.prompt === "function")
     ? window.prompt.bind(window)
     : null;
+  const nativeFetch = (typeof window.fetch === "function")
+    ? window.fetch.bind(window)
+    : null;
   const copyPrefix = "__CHATGPT_DESKTOP_COPY_PREFIX_PLACEHOLDER__";
+  // Empty when the app was built against a Qt without streaming scheme bodies
+  const copyChannelUrl = "__CHATGPT_DESKTOP_COPY_CHANNEL_PLACEHOLDER__";
+  const channelChunkBytes = 1024 * 1024;
+  // Prompt payloads are base64 strings, so that path keeps a hard cap
   const maxClipboardBytes = 8 * 1024 * 1024;
   const maxBase64Chars = Math.ceil(maxClipboardBytes / 3) * 4;
 
+  const controlSelector = "button,[role='button']";
+  // Copy controls map to their code block, filled as turns arrive so clicks never search the page
+  const codeBlocksByControl = new WeakMap();
+  // Controls already judged at click time that do not look like copy buttons at all
+  const ignoredControls = new WeakSet();
+  const pendingRoots = [];
+  let registrationScheduled = false;
+  let registeredControlCount = 0;
+  let clickResolveCount = 0;
+  let failedCopyCount = 0;
+
   const hasNearbyCodeBlock = (control) => {
     // Stay close to the clicked control so unrelated code blocks are ignored
     const container = control.closest("article,[data-testid*='conversation-turn'],li[data-message-author-role],div[data-message-author-role],div")
@@ -27,45 +45,17 @@
     return !!container.querySelector("pre code, pre");
   };
 
-  const isProbablyCopyControl = (control) => {
-    if (!(control instanceof Element)) {
-      return false;
-    }
-
+  const looksLikeCopyControl = (control) => {
     const testId = (control.getAttribute("data-testid") || "").toLowerCase();
     const ariaLabel = (control.getAttribute("aria-label") || "").toLowerCase();
-    const text = (control.textContent || "").toLowerCase();
-    const looksLikeCopy = testId.includes("copy")
-      || ariaLabel.includes("copy")
-      || text.includes("copy");
-    return looksLikeCopy && hasNearbyCodeBlock(control);
-  };
-
-  const findControlFromEvent = (event) => {
-    if (typeof event.composedPath === "function") {
-      // Walk the real event path first so nested icons still resolve to the button
-      const path = event.composedPath();
-      for (const node of path) {
-        if (!(node instanceof Element)) {
-          continue;
-        }
-        const isControl = node.tagName === "BUTTON"
-          || (node.getAttribute("role") || "").toLowerCase() === "button";
-        if (isControl && isProbablyCopyControl(node)) {
-          return node;
-        }
-      }
+    if (testId.includes("copy") || ariaLabel.includes("copy")) {
+      return true;
     }
-
-    if (event.target instanceof Element) {
-      // Fallback for browsers or events without a composed path
-      const candidate = event.target.closest("button,[role='button']");
-      if (candidate instanceof Element && isProbablyCopyControl(candidate)) {
-        return candidate;
-      }
+    // Copy labels are a word next to an icon, large role=button containers are never one
+    if (control.tagName !== "BUTTON" && control.childElementCount > 8) {
+      return false;
     }
-
-    return null;
+    return (control.textContent || "").toLowerCase().includes("copy");
   };
 
   const findTurnContainer = (control) => {
@@ -85,45 +75,137 @@
     return null;
   };
 
-  const findNearestVisiblePre = (control) => {
-    const root = findTurnContainer(control);
-    const pres = Array.from(root.querySelectorAll("pre"));
-    if (pres.length === 0) {
+  const findPreInDocumentOrder = (control) => {
+    // Code block headers sit above or inside their pre, so take the last pre before the control
+    // Document order needs no layout, unlike comparing on-screen distances
+    const beforeOrAround = Node.DOCUMENT_POSITION_FOLLOWING | Node.DOCUMENT_POSITION_CONTAINED_BY;
+    let best = null;
+    for (const pre of findTurnContainer(control).querySelectorAll("pre")) {
+      if (best && !(pre.compareDocumentPosition(control) & beforeOrAround)) {
+        break;
+      }
+      best = pre;
+    }
+    return best;
+  };
+
+  const resolveCodeBlock = (control) => {
+    if (!looksLikeCopyControl(control) || !hasNearbyCodeBlock(control)) {
       return null;
     }
+    return findPreByAncestor(control) || findPreInDocumentOrder(control);
+  };
 
-    const controlRect = control.getBoundingClientRect();
-    const controlCenterX = controlRect.left + controlRect.width / 2;
-    const controlCenterY = controlRect.top + controlRect.height / 2;
+  const registerControl = (control) => {
+    if (codeBlocksByControl.has(control)) {
+      return;
+    }
+    const codeBlock = resolveCodeBlock(control);
+    if (codeBlock) {
+      codeBlocksByControl.set(control, codeBlock);
+      ++registeredControlCount;
+    }
+  };
 
-    let best = null;
-    let bestDistance = Number.POSITIVE_INFINITY;
-    for (const pre of pres) {
-      const rect = pre.getBoundingClientRect();
-      if (rect.width === 0 || rect.height === 0) {
+  const registerPendingControls = () => {
+    registrationScheduled = false;
+    // Subtrees can leave again before idle time, those are skipped
+    for (const root of pendingRoots.splice(0)) {
+      if (!root.isConnected) {
         continue;
       }
+      if (root.matches(controlSelector)) {
+        registerControl(root);
+      }
+      for (const control of root.querySelectorAll(controlSelector)) {
+        registerControl(control);
+      }
+    }
+  };
+
+  const scheduleRegistration = () => {
+    if (registrationScheduled) {
+      return;
+    }
+    registrationScheduled = true;
+    if (typeof window.requestIdleCallback === "function") {
+      window.requestIdleCallback(registerPendingControls, { timeout: 1000 });
+      return;
+    }
+    window.setTimeout(registerPendingControls, 50);
+  };
 
-      // Pick the closest visible pre to the clicked control
-      const preCenterX = rect.left + rect.width / 2;
-      const preCenterY = rect.top + rect.height / 2;
-      const dx = controlCenterX - preCenterX;
-      const dy = controlCenterY - preCenterY;
-      const distance = dx * dx + dy * dy;
-      if (distance < bestDistance) {
-        bestDistance = distance;
-        best = pre;
+  const handleMutationRecords = (records) => {
+    for (const record of records) {
+      for (const node of record.addedNodes) {
+        // Streamed tokens arrive as leaf text and spans, those never hold a control
+        if (node instanceof Element && (node.firstElementChild || node.matches(controlSelector))) {
+          pendingRoots.push(node);
+        }
       }
     }
-    return best;
+    if (pendingRoots.length > 0) {
+      scheduleRegistration();
+    }
   };
 
-  const extractCodeText = (control) => {
-    // Use the nearest pre block and normalize newlines before native copy
-    const pre = findPreByAncestor(control) || findNearestVisiblePre(control);
-    if (!pre) {
-      return "";
+  // The document node exists at creation time, before any turn is parsed
+  new MutationObserver(handleMutationRecords).observe(document, { childList: true, subtree: true });
+
+  const codeBlockForControl = (control) => {
+    const cached = codeBlocksByControl.get(control);
+    // Highlighting can swap the pre under a mounted button, a detached answer is looked up again
+    if (cached?.isConnected) {
+      return cached;
+    }
+    if (cached === undefined && ignoredControls.has(control)) {
+      return null;
+    }
+    // Clicks that beat idle registration resolve here once, still without layout
+    ++clickResolveCount;
+    if (!looksLikeCopyControl(control)) {
+      ignoredControls.add(control);
+      return null;
+    }
+    codeBlocksByControl.delete(control);
+    const codeBlock = resolveCodeBlock(control);
+    if (codeBlock) {
+      codeBlocksByControl.set(control, codeBlock);
     }
+    return codeBlock;
+  };
+
+  const isControlElement = (node) => node.tagName === "BUTTON"
+    || (node.getAttribute("role") || "").toLowerCase() === "button";
+
+  const findCodeBlockFromEvent = (event) => {
+    if (typeof event.composedPath === "function") {
+      // Walk the real event path first so nested icons still resolve to the button
+      for (const node of event.composedPath()) {
+        if (!(node instanceof Element) || !isControlElement(node)) {
+          continue;
+        }
+        const codeBlock = codeBlockForControl(node);
+        if (codeBlock) {
+          return codeBlock;
+        }
+      }
+      return null;
+    }
+
+    if (event.target instanceof Element) {
+      // Fallback for browsers or events without a composed path
+      const candidate = event.target.closest(controlSelector);
+      if (candidate instanceof Element) {
+        return codeBlockForControl(candidate);
+      }
+    }
+
+    return null;
+  };
+
+  const extractCodeText = (pre) => {
+    // Normalize newlines before native copy
     const code = pre.querySelector("code");
     const text = code ? (code.textContent || "") : (pre.textContent || "");
     return text.replace(/\r\n/g, "\n");
@@ -172,17 +254,51 @@
     }
   };
 
+  const sendStreamedCopy = async (utf8) => {
+    const transferId = `${Date.now().toString(36)}-${Math.random().toString(36).slice(2)}`;
+    const chunkCount = Math.max(1, Math.ceil(utf8.length / channelChunkBytes));
+    for (let index = 0; index < chunkCount; ++index) {
+      // subarray is a view on the encoded bytes, so chunking copies nothing
+      const chunk = utf8.subarray(index * channelChunkBytes, (index + 1) * channelChunkBytes);
+      const last = index === chunkCount - 1 ? "1" : "0";
+      // The native side rejects anything it did not accept, which makes fetch throw
+      await nativeFetch(`${copyChannelUrl}/${transferId}/${index}?last=${last}&total=${utf8.length}`, {
+        method: "POST",
+        mode: "no-cors",
+        cache: "no-store",
+        credentials: "omit",
+        body: chunk,
+      });
+    }
+  };
+
   document.addEventListener("pointerdown", (event) => {
-    const control = findControlFromEvent(event);
-    if (!control) {
+    const codeBlock = findCodeBlockFromEvent(event);
+    if (!codeBlock) {
       return;
     }
 
-    const codeText = extractCodeText(control);
+    const codeText = extractCodeText(codeBlock);
     if (!codeText || !codeText.trim()) {
       return;
     }
 
+    if (copyChannelUrl && nativeFetch) {
+      const utf8 = new TextEncoder().encode(codeText);
+      // The prompt fallback stops at its cap, so bigger copies keep the page's own handler as the backup
+      if (utf8.length <= maxClipboardBytes) {
+        event.preventDefault();
+        event.stopImmediatePropagation();
+      }
+      // Uploads finish after the page click, the native commit retry keeps ours on top
+      sendStreamedCopy(utf8).catch(() => {
+        if (!sendNativeCopy(codeText)) {
+          ++failedCopyCount;
+        }
+      });
+      return;
+    }
+
     // Stop page copy logic only when native copy worked
     const wasCopied = sendNativeCopy(codeText);
     if (!wasCopied) {
@@ -197,4 +313,14 @@
       sendNativeCopy(codeText);
     }, 150);
   }, true);
+
+  // Benchmarks read how many controls were mapped ahead of time and how many clicks had to resolve
+  globalThis.__chatgptDesktopCodeCopyStats = () => ({
+    registeredControls: registeredControlCount,
+    clickResolves: clickResolveCount,
+    failedCopies: failedCopyCount
+  });
+
+  // Startup traces read this mark back from the page timeline
+  performance.mark?.("chatgpt-desktop:code-copy-installed");
 })();
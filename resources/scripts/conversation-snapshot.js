@@ -0,0 +1,263 @@
+(() => {
+  // Keep a compact copy of conversations for the native snapshot view and search index
+  const trustedOrigins = globalThis.__chatgptDesktopTrustedOrigins;
+  if (!trustedOrigins?.isTrustedLocation(window.location)) {
+    return;
+  }
+
+  if (window.__chatgptDesktopConversationSnapshotInstalled) {
+    return;
+  }
+  window.__chatgptDesktopConversationSnapshotInstalled = true;
+
+  const turnSelector = "article[data-testid*='conversation-turn'],li[data-message-author-role],div[data-message-author-role]";
+  const roleSelector = "[data-message-author-role]";
+  // Capture once streaming and scrolling have been quiet this long
+  const settleDelayMs = 1500;
+  // The live page counts as ready once its turns stopped changing for this long
+  const readyQuietMs = 300;
+  const blockTags = new Set([
+    "P", "DIV", "LI", "UL", "OL", "TABLE", "TR", "BLOCKQUOTE", "HR", "BR",
+    "H1", "H2", "H3", "H4", "H5", "H6"
+  ]);
+  const skippedTags = new Set(["BUTTON", "svg", "STYLE", "SCRIPT", "TEMPLATE"]);
+  // Turn -> role and blocks from the last capture, dropped when a mutation touches the turn
+  const capturedTurns = new WeakMap();
+  // Conversation path -> snapshot JSON waiting for the native side
+  const pendingSnapshots = new Map();
+  // Conversation path -> first turn on screen, scrolling alone never serializes the turns again
+  const pendingScrollTurns = new Map();
+  let routePath = window.location.pathname;
+  let routeChangedAt = performance.now();
+  let lastTurnMutationAt = 0;
+  let settleTimerId = 0;
+  let dirty = true;
+  let scrolled = false;
+
+  const isConversationPath = (path) => /\/c\/[^/]+\/?$/.test(path);
+
+  const collectTurns = () => {
+    // Nested matches belong to the outer turn
+    const turns = [];
+    for (const node of document.querySelectorAll(turnSelector)) {
+      if (!node.parentElement?.closest(turnSelector)) {
+        turns.push(node);
+      }
+    }
+    return turns;
+  };
+
+  const readBlocks = (root) => {
+    // Blocks are [isCode, language, text], paragraphs of plain text merge into one block
+    const blocks = [];
+    let text = "";
+    const flushText = () => {
+      const trimmed = text.replace(/\n{3,}/g, "\n\n").trim();
+      if (trimmed) {
+        blocks.push([0, "", trimmed]);
+      }
+      text = "";
+    };
+    const breakLine = () => {
+      if (text && !text.endsWith("\n")) {
+        text += "\n";
+      }
+    };
+    const walk = (node) => {
+      for (let child = node.firstChild; child; child = child.nextSibling) {
+        if (child.nodeType === Node.TEXT_NODE) {
+          text += child.data;
+          continue;
+        }
+        if (child.nodeType !== Node.ELEMENT_NODE || skippedTags.has(child.tagName)
+          || child.classList.contains("sr-only")) {
+          continue;
+        }
+        if (child.tagName === "PRE") {
+          // The code element skips the language header and copy button around it
+          flushText();
+          const code = child.querySelector("code");
+          const language = /language-([\w+#.-]+)/.exec(code?.className || "")?.[1] || "";
+          blocks.push([1, language, (code || child).textContent]);
+          continue;
+        }
+        const isBlock = blockTags.has(child.tagName);
+        if (isBlock) {
+          breakLine();
+        }
+        walk(child);
+        if (isBlock) {
+          breakLine();
+        }
+      }
+    };
+    walk(root);
+    flushText();
+    return blocks;
+  };
+
+  const readTurn = (turn) => {
+    let captured = capturedTurns.get(turn);
+    if (captured) {
+      return captured;
+    }
+    const role = turn.getAttribute("data-message-author-role")
+      || turn.querySelector(roleSelector)?.getAttribute("data-message-author-role")
+      || "";
+    captured = { role, blocks: readBlocks(turn) };
+    capturedTurns.set(turn, captured);
+    return captured;
+  };
+
+  const firstVisibleTurn = (turns) => {
+    // Turns are in document order, so a binary search finds the first one still below the top edge
+    let low = 0;
+    let high = turns.length - 1;
+    let found = turns.length - 1;
+    while (low <= high) {
+      const middle = (low + high) >> 1;
+      if (turns[middle].getBoundingClientRect().bottom > 0) {
+        found = middle;
+        high = middle - 1;
+      } else {
+        low = middle + 1;
+      }
+    }
+    return Math.max(0, found);
+  };
+
+  const capture = () => {
+    window.clearTimeout(settleTimerId);
+    settleTimerId = 0;
+    if ((!dirty && !scrolled) || !isConversationPath(routePath)) {
+      return;
+    }
+    const contentChanged = dirty;
+    dirty = false;
+    scrolled = false;
+
+    const turns = collectTurns();
+    if (turns.length === 0) {
+      return;
+    }
+    if (!contentChanged) {
+      pendingScrollTurns.set(routePath, firstVisibleTurn(turns));
+      return;
+    }
+    pendingScrollTurns.delete(routePath);
+    const startedAt = performance.now();
+    pendingSnapshots.set(routePath, JSON.stringify({
+      url: window.location.origin + routePath,
+      title: document.title,
+      scrollTurn: firstVisibleTurn(turns),
+      turns: turns.map(readTurn)
+    }));
+    performance.measure?.("chatgpt-desktop:conversation-snapshot", { start: startedAt });
+  };
+
+  const scheduleCapture = (contentChanged) => {
+    if (contentChanged) {
+      dirty = true;
+    } else {
+      scrolled = true;
+    }
+    window.clearTimeout(settleTimerId);
+    settleTimerId = window.setTimeout(capture, settleDelayMs);
+  };
+
+  const checkRoute = () => {
+    if (window.location.pathname === routePath) {
+      return;
+    }
+    // Whatever settled on the old route is already pending, the new one starts clean
+    window.clearTimeout(settleTimerId);
+    settleTimerId = 0;
+    routePath = window.location.pathname;
+    routeChangedAt = performance.now();
+    dirty = true;
+  };
+
+  const touchesTurns = (node) => node.nodeType === Node.ELEMENT_NODE
+    && (node.matches(turnSelector) || node.querySelector(turnSelector) !== null);
+
+  const mutationObserver = new MutationObserver((records) => {
+    checkRoute();
+    let turnsChanged = false;
+    for (const record of records) {
+      const target = record.target.nodeType === Node.ELEMENT_NODE ? record.target : record.target.parentElement;
+      let turn = target?.closest(turnSelector);
+      if (turn) {
+        // Captures are keyed by the outermost turn
+        while (turn.parentElement?.closest(turnSelector)) {
+          turn = turn.parentElement.closest(turnSelector);
+        }
+        capturedTurns.delete(turn);
+        turnsChanged = true;
+      } else if (!turnsChanged && record.type === "childList") {
+        turnsChanged = Array.prototype.some.call(record.addedNodes, touchesTurns)
+          || Array.prototype.some.call(record.removedNodes, touchesTurns);
+      }
+    }
+    if (turnsChanged) {
+      lastTurnMutationAt = performance.now();
+      scheduleCapture(true);
+    }
+  });
+  mutationObserver.observe(document.documentElement, { childList: true, subtree: true, characterData: true });
+
+  if (collectTurns().length > 0) {
+    // Turns rendered before this script ran count as the first change on this route
+    lastTurnMutationAt = routeChangedAt;
+  }
+
+  // A quiet scroll only hands over the new position, the native side keeps it apart from the turns
+  document.addEventListener("scroll", () => {
+    if (isConversationPath(routePath)) {
+      scheduleCapture(false);
+    }
+  }, { passive: true, capture: true });
+  window.addEventListener("popstate", checkRoute, { passive: true });
+
+  // The native view drains finished snapshots on its own schedule, a flush captures pending changes first
+  globalThis.__chatgptDesktopTakeConversationSnapshots = (flush) => {
+    if (flush && settleTimerId !== 0) {
+      capture();
+    }
+    if (pendingSnapshots.size === 0 && pendingScrollTurns.size === 0) {
+      return "";
+    }
+    // Entries without turns only move the saved scroll position
+    const entries = Array.from(pendingSnapshots.values());
+    for (const [path, scrollTurn] of pendingScrollTurns) {
+      entries.push(JSON.stringify({ url: window.location.origin + path, scrollTurn }));
+    }
+    pendingSnapshots.clear();
+    pendingScrollTurns.clear();
+    return `[${entries.join(",")}]`;
+  };
+
+  // The native snapshot view hands over once the live turns for its path stopped changing
+  globalThis.__chatgptDesktopConversationReady = (path) => {
+    checkRoute();
+    return routePath === path
+      && lastTurnMutationAt >= routeChangedAt
+      && performance.now() - lastTurnMutationAt >= readyQuietMs
+      && collectTurns().length > 0;
+  };
+
+  // The session file keeps the first turn on screen so a restored window opens where the reader left off
+  globalThis.__chatgptDesktopTopTurn = () => {
+    checkRoute();
+    if (!isConversationPath(routePath)) {
+      return -1;
+    }
+    const turns = collectTurns();
+    return turns.length > 0 ? firstVisibleTurn(turns) : -1;
+  };
+
+  globalThis.__chatgptDesktopScrollToTurn = (index) => {
+    const turn = collectTurns()[index];
+    turn?.scrollIntoView({ block: "start" });
+    return Boolean(turn);
+  };
+})();
@@ -14,21 +14,43 @@
   const styleId = "chatgpt-desktop-long-chat-perf-style";
   const optimizedClass = "__chatgptDesktopPerfOptimized";
   const recentClass = "__chatgptDesktopPerfRecent";
+  const reducedBudgetClass = "__chatgptDesktopReducedBudget";
+  const turnSelector = "article[data-testid*='conversation-turn'],li[data-message-author-role],div[data-message-author-role]";
   const minMessageCount = 24;
   const keepRecentCount = 18;
   const viewportMargin = 1600;
-  const maxNodes = 1000;
   const minMutationUpdateMs = 450;
   const minIntersectionUpdateMs = 90;
   const minResizeUpdateMs = 120;
+  // Unfocused windows stretch every update gap by this much
+  const reducedBudgetGapScale = 4;
   const managedNodes = new Set();
   const nearViewportNodes = new Set();
+  // Outermost turns in document order, patched from MutationRecords between full scans
+  const turnIndex = [];
+  const indexedTurns = new Set();
+  // Index changes since the last pass, so streaming passes only touch what moved
+  const addedTurns = new Set();
+  const removedTurns = new Set();
+  let indexSelector = turnSelector;
+  let indexNeedsRescan = true;
+  let indexedPath = window.location.pathname;
+  let indexRescanCount = 0;
+  // Pass timings for the offline benchmark
+  let updatePassCount = 0;
+  let updatePassTotalMs = 0;
+  let updatePassMaxMs = 0;
+  let observedRoot = null;
+  // Created once the chat scroller is known, see createViewportObservers
+  let intersectionObserver = null;
+  let viewportRoot = null;
   let updateScheduled = false;
   let observersConnected = false;
   let scheduledReason = "initial";
   let lastUpdateAt = 0;
   let updateTimerId = 0;
   let scheduledRunAt = 0;
+  let updateGapScale = 1;
 
   const reasonPriority = {
     // Lower cost reasons can be replaced by stronger layout changes
@@ -59,11 +81,18 @@
       .${optimizedClass} {
         content-visibility: auto !important;
         contain: layout style paint !important;
-        contain-intrinsic-size: 1px 900px !important;
+        contain-intrinsic-size: auto 1px auto 900px !important;
       }
       .${recentClass} {
         content-visibility: visible !important;
         contain: none !important;
+        contain-intrinsic-size: auto 1px auto 900px !important;
+      }
+      html.${reducedBudgetClass} *,
+      html.${reducedBudgetClass} *::before,
+      html.${reducedBudgetClass} *::after {
+        animation-play-state: paused !important;
+        transition: none !important;
       }
     `;
     document.head.appendChild(style);
@@ -74,47 +103,140 @@
     || document.body
     || document.documentElement;
 
-  const collectMessageNodes = (root) => {
-    // Prefer the real chat turn markers before falling back to generic articles
-    const selectors = [
-      "article[data-testid*='conversation-turn']",
-      "li[data-message-author-role]",
-      "div[data-message-author-role]"
-    ];
-    const seen = new Set();
-    const nodes = [];
-
-    for (const selector of selectors) {
-      const results = root.querySelectorAll(selector);
-      for (const node of results) {
-        if (!(node instanceof HTMLElement) || seen.has(node)) {
-          continue;
+  const findScrollRoot = (turn) => {
+    // The chat usually scrolls inside its own container, null means the document scrolls
+    for (let node = turn?.parentElement; node && node !== document.body; node = node.parentElement) {
+      const overflowY = getComputedStyle(node).overflowY;
+      if (overflowY === "auto" || overflowY === "scroll") {
+        return node;
+      }
+    }
+    return null;
+  };
+
+  const rebuildTurnIndex = (root) => {
+    // Full scans only happen on route changes or when the index stops matching the page
+    indexSelector = root.querySelector(turnSelector) ? turnSelector : "article";
+    turnIndex.length = 0;
+    indexedTurns.clear();
+    let outerTurn = null;
+    // querySelectorAll is in document order, so a nested marker always follows its outer turn
+    for (const node of root.querySelectorAll(indexSelector)) {
+      if (!(node instanceof HTMLElement) || outerTurn?.contains(node)) {
+        continue;
+      }
+      outerTurn = node;
+      turnIndex.push(node);
+      indexedTurns.add(node);
+    }
+    addedTurns.clear();
+    removedTurns.clear();
+    indexNeedsRescan = false;
+    indexedPath = window.location.pathname;
+    ++indexRescanCount;
+  };
+
+  const indexLooksInconsistent = () => {
+    // Both ends are checked each pass, a removal the records missed almost always shows up there
+    if (turnIndex.length === 0) {
+      return false;
+    }
+    return !turnIndex[0].isConnected || !turnIndex[turnIndex.length - 1].isConnected;
+  };
+
+  const insertTurn = (turn) => {
+    if (indexedTurns.has(turn) || !turn.isConnected || turn.parentElement?.closest(indexSelector)) {
+      return;
+    }
+
+    // New turns almost always land at the end, anything else finds its slot by binary search
+    let low = turnIndex.length;
+    const last = turnIndex[turnIndex.length - 1];
+    if (last && !(last.compareDocumentPosition(turn) & Node.DOCUMENT_POSITION_FOLLOWING)) {
+      low = 0;
+      let high = turnIndex.length;
+      while (low < high) {
+        const middle = (low + high) >> 1;
+        if (turnIndex[middle].compareDocumentPosition(turn) & Node.DOCUMENT_POSITION_FOLLOWING) {
+          low = middle + 1;
+        } else {
+          high = middle;
         }
-        seen.add(node);
-        nodes.push(node);
       }
     }
+    turnIndex.splice(low, 0, turn);
+    indexedTurns.add(turn);
+    addedTurns.add(turn);
+    removedTurns.delete(turn);
+  };
 
-    // Fallback selector only when structured selectors fail
-    if (nodes.length === 0) {
-      const results = root.querySelectorAll("article");
-      for (const node of results) {
-        if (!(node instanceof HTMLElement) || seen.has(node)) {
+  const removeTurn = (turn) => {
+    if (!indexedTurns.delete(turn)) {
+      return;
+    }
+    // Removals cluster near the end while streaming, so search from there
+    const position = turnIndex.lastIndexOf(turn);
+    if (position >= 0) {
+      turnIndex.splice(position, 1);
+    }
+    addedTurns.delete(turn);
+    removedTurns.add(turn);
+  };
+
+  const applyMutationRecords = (records) => {
+    if (window.location.pathname !== indexedPath) {
+      // A new conversation replaces most of the tree, patching would cost more than a scan
+      indexNeedsRescan = true;
+    }
+    if (indexNeedsRescan) {
+      return true;
+    }
+
+    const indexSizeBefore = indexedTurns.size;
+    let changed = false;
+    // Records are replayed in order, so a node moved within one batch ends up indexed once
+    for (const record of records) {
+      for (const node of record.removedNodes) {
+        if (!(node instanceof Element)) {
           continue;
         }
-        seen.add(node);
-        nodes.push(node);
+        if (indexedTurns.has(node)) {
+          removeTurn(node);
+          changed = true;
+          continue;
+        }
+        // Only the removed subtree is searched, never the whole chat
+        if (indexedTurns.size > 0 && node.firstElementChild) {
+          for (const turn of node.querySelectorAll(indexSelector)) {
+            if (indexedTurns.has(turn)) {
+              removeTurn(turn);
+              changed = true;
+            }
+          }
+        }
       }
-    }
 
-    if (nodes.length <= maxNodes) {
-      return nodes;
+      for (const node of record.addedNodes) {
+        // Streamed tokens arrive as text and inline nodes that hold no turn markers
+        if (!(node instanceof HTMLElement)) {
+          continue;
+        }
+        if (node.matches(indexSelector)) {
+          insertTurn(node);
+        } else if (node.firstElementChild) {
+          for (const turn of node.querySelectorAll(indexSelector)) {
+            insertTurn(turn);
+          }
+        }
+      }
     }
+    return changed || indexedTurns.size !== indexSizeBefore || addedTurns.size > 0;
+  };
 
-    // Keep some old and new turns so both ends of the chat still get covered
-    const tailCount = Math.floor(maxNodes * 0.35);
-    const headCount = maxNodes - tailCount;
-    return nodes.slice(0, headCount).concat(nodes.slice(nodes.length - tailCount));
+  const handleMutationRecords = (records) => {
+    if (applyMutationRecords(records)) {
+      scheduleUpdate("mutation");
+    }
   };
 
   const clearManagedNodes = () => {
@@ -123,12 +245,14 @@
       if (!(node instanceof HTMLElement)) {
         continue;
       }
-      intersectionObserver.unobserve(node);
+      intersectionObserver?.unobserve(node);
       node.classList.remove(optimizedClass);
       node.classList.remove(recentClass);
     }
     managedNodes.clear();
     nearViewportNodes.clear();
+    addedTurns.clear();
+    removedTurns.clear();
   };
 
   const cancelPendingUpdate = () => {
@@ -142,82 +266,117 @@
     scheduledReason = "mutation";
   };
 
-  const isNearViewportEntry = (entry) => entry.isIntersecting
-    || (entry.boundingClientRect.bottom >= -viewportMargin
-      && entry.boundingClientRect.top <= (window.innerHeight + viewportMargin));
+  const isNearViewportEntry = (entry) => {
+    if (entry.isIntersecting) {
+      return true;
+    }
+    // rootBounds already include the margin, it is null only in odd cross-frame cases
+    const bounds = entry.rootBounds;
+    const top = bounds ? bounds.top : -viewportMargin;
+    const bottom = bounds ? bounds.bottom : window.innerHeight + viewportMargin;
+    return entry.boundingClientRect.bottom >= top && entry.boundingClientRect.top <= bottom;
+  };
 
-  const syncManagedNodes = (messages) => {
-    // Keep observers only on the nodes that still matter for this chat
-    const selectedNodes = new Set(messages);
+  const startManaging = (node) => {
+    if (managedNodes.has(node)) {
+      return;
+    }
+    // New nodes start as near viewport until the observer says otherwise
+    managedNodes.add(node);
+    nearViewportNodes.add(node);
+    intersectionObserver.observe(node);
+  };
+
+  const stopManaging = (node) => {
+    node.classList.remove(optimizedClass);
+    node.classList.remove(recentClass);
+    intersectionObserver?.unobserve(node);
+    nearViewportNodes.delete(node);
+    managedNodes.delete(node);
+  };
 
+  const syncManagedNodes = () => {
+    // Keep observers only on the nodes that still matter for this chat
     for (const node of Array.from(managedNodes)) {
-      if (!(node instanceof HTMLElement) || !selectedNodes.has(node)) {
-        if (node instanceof HTMLElement) {
-          node.classList.remove(optimizedClass);
-          node.classList.remove(recentClass);
-          intersectionObserver.unobserve(node);
-        }
-        nearViewportNodes.delete(node);
-        managedNodes.delete(node);
+      if (!indexedTurns.has(node)) {
+        stopManaging(node);
       }
     }
-
-    for (const node of messages) {
-      if (managedNodes.has(node)) {
-        continue;
-      }
-      // New nodes start as near viewport until the observer says otherwise
-      managedNodes.add(node);
-      nearViewportNodes.add(node);
-      intersectionObserver.observe(node);
+    for (const node of turnIndex) {
+      startManaging(node);
     }
   };
 
+  const applyTurnClasses = (turn, isRecent, reason) => {
+    // The first pass keeps everything visible until the viewport map settles
+    const nearViewport = reason === "initial"
+      ? true
+      : nearViewportNodes.has(turn);
+    const shouldOptimize = !isRecent && !nearViewport;
+    turn.classList.toggle(optimizedClass, shouldOptimize);
+    turn.classList.toggle(recentClass, !shouldOptimize);
+  };
+
   const updateOptimization = (reason) => {
     if (document.visibilityState === "hidden") {
       // Hidden pages should not keep observer state or layout classes around
+      indexNeedsRescan = true;
       clearManagedNodes();
       return;
     }
 
-    // Drop nodes that vanished before touching layout classes again
-    for (const node of Array.from(managedNodes)) {
-      if (!(node instanceof HTMLElement) || !node.isConnected) {
-        intersectionObserver.unobserve(node);
-        nearViewportNodes.delete(node);
-        managedNodes.delete(node);
-      }
+    const chatRoot = getChatRoot();
+    if (chatRoot !== observedRoot) {
+      // The app swapped its main element, follow it and start the index over
+      clearManagedNodes();
+      disconnectObservers();
+      connectObservers();
+      indexNeedsRescan = true;
     }
 
-    const chatRoot = getChatRoot();
-    const hasChatTurns = !!chatRoot.querySelector(
-      "article[data-testid*='conversation-turn'],li[data-message-author-role],div[data-message-author-role]"
-    );
-    if (!hasChatTurns) {
+    let fullPass = reason !== "mutation" || managedNodes.size === 0;
+    if (indexNeedsRescan || indexLooksInconsistent()) {
+      rebuildTurnIndex(chatRoot);
+      fullPass = true;
+    }
+
+    const scrollRoot = fullPass ? findScrollRoot(turnIndex[0]) : viewportRoot;
+    if (!intersectionObserver || scrollRoot !== viewportRoot) {
+      // Observers cannot change root, so a new scroller means new observers and fresh viewport state
       clearManagedNodes();
-      return;
+      intersectionObserver?.disconnect();
+      createViewportObservers(scrollRoot);
+      fullPass = true;
     }
 
-    const messages = collectMessageNodes(chatRoot);
-    if (messages.length < minMessageCount) {
+    if (turnIndex.length < minMessageCount) {
       // Small chats do not need extra containment rules
       clearManagedNodes();
       return;
     }
 
-    syncManagedNodes(messages);
-    const recentStart = Math.max(0, messages.length - keepRecentCount);
-    for (let index = 0; index < messages.length; ++index) {
-      const message = messages[index];
-      const isRecent = index >= recentStart;
-      // The first pass keeps everything visible until the viewport map settles
-      const nearViewport = reason === "initial"
-        ? true
-        : nearViewportNodes.has(message);
-      const shouldOptimize = !isRecent && !nearViewport;
-      message.classList.toggle(optimizedClass, shouldOptimize);
-      message.classList.toggle(recentClass, !shouldOptimize);
+    const recentStart = Math.max(0, turnIndex.length - keepRecentCount);
+    if (fullPass) {
+      syncManagedNodes();
+      for (let index = 0; index < turnIndex.length; ++index) {
+        applyTurnClasses(turnIndex[index], index >= recentStart, reason);
+      }
+    } else {
+      // Streaming passes only touch changed turns and the ones crossing the recent boundary
+      for (const node of removedTurns) {
+        stopManaging(node);
+      }
+      for (const node of addedTurns) {
+        startManaging(node);
+        applyTurnClasses(node, turnIndex.indexOf(node, recentStart) >= 0, reason);
+      }
+      const boundaryStart = Math.max(0, recentStart - addedTurns.size - removedTurns.size - 1);
+      for (let index = boundaryStart; index < turnIndex.length; ++index) {
+        applyTurnClasses(turnIndex[index], index >= recentStart, reason);
+      }
     }
+    addedTurns.clear();
+    removedTurns.clear();
   };
 
   const scheduleUpdate = (reason = "mutation") => {
@@ -240,6 +399,13 @@
       lastUpdateAt = performance.now();
       // Use the strongest queued reason for the final run
       updateOptimization(reasonForRun);
+      const passMs = performance.now() - lastUpdateAt;
+      ++updatePassCount;
+      updatePassTotalMs += passMs;
+      updatePassMaxMs = Math.max(updatePassMaxMs, passMs);
+      if (reasonForRun === "initial") {
+        performance.measure?.("chatgpt-desktop:long-chat-initial-update", { start: lastUpdateAt });
+      }
     };
 
     const scheduleTimer = (delayMs) => {
@@ -260,6 +426,7 @@
     } else if (scheduledReason === "resize" || scheduledReason === "initial") {
       minGap = minResizeUpdateMs;
     }
+    minGap *= updateGapScale;
     const delay = Math.max(0, minGap - (now - lastUpdateAt));
     const nextRunAt = now + delay;
 
@@ -280,7 +447,7 @@
 
   ensureStyle();
 
-  const intersectionObserver = new IntersectionObserver((entries) => {
+  const handleNearViewportEntries = (entries) => {
     // Near viewport turns stay fully visible so scrolling feels normal
     let changed = false;
     for (const entry of entries) {
@@ -305,15 +472,19 @@
     if (changed) {
       scheduleUpdate("intersection");
     }
-  }, {
-    root: null,
-    rootMargin: `${viewportMargin}px 0px ${viewportMargin}px 0px`,
-    threshold: 0
-  });
+  };
 
-  const observer = new MutationObserver(() => {
-    scheduleUpdate("mutation");
-  });
+  const createViewportObservers = (root) => {
+    // Margins only stretch the observer root, so it has to be the element that scrolls the chat
+    viewportRoot = root;
+    intersectionObserver = new IntersectionObserver(handleNearViewportEntries, {
+      root,
+      rootMargin: `${viewportMargin}px 0px ${viewportMargin}px 0px`,
+      threshold: 0
+    });
+  };
+
+  const mutationObserver = new MutationObserver(handleMutationRecords);
 
   const connectObservers = () => {
     if (observersConnected) {
@@ -321,8 +492,8 @@
     }
 
     // Watch only the chat root instead of the whole document tree
-    const observerRoot = getChatRoot();
-    observer.observe(observerRoot, { childList: true, subtree: true });
+    observedRoot = getChatRoot();
+    mutationObserver.observe(observedRoot, { childList: true, subtree: true });
     observersConnected = true;
   };
 
@@ -331,15 +502,18 @@
       return;
     }
 
-    // Disconnect both observers so hidden pages stop doing work
-    observer.disconnect();
-    intersectionObserver.disconnect();
+    // Disconnect every observer so hidden pages stop doing work
+    mutationObserver.disconnect();
+    intersectionObserver?.disconnect();
+    observedRoot = null;
     observersConnected = false;
   };
 
   const handleVisibilityChange = () => {
     if (document.visibilityState === "hidden") {
       // A hidden page should drop timers and observer work right away
+      // Records stop while disconnected, so the index is rebuilt on return
+      indexNeedsRescan = true;
       cancelPendingUpdate();
       clearManagedNodes();
       disconnectObservers();
@@ -353,6 +527,29 @@
 
   connectObservers();
   scheduleUpdate("initial");
+  performance.mark?.("chatgpt-desktop:long-chat-installed");
+
+  // Benchmarks read DOM and heap size back through the application world
+  globalThis.__chatgptDesktopLongChatStats = () => ({
+    managedTurns: managedNodes.size,
+    indexedTurns: turnIndex.length,
+    indexRescans: indexRescanCount,
+    updatePasses: updatePassCount,
+    updatePassTotalMs,
+    updatePassMaxMs,
+    documentElements: document.getElementsByTagName("*").length,
+    usedJsHeapBytes: performance.memory?.usedJSHeapSize ?? 0
+  });
+
+  // The native view calls this when its window gains or loses focus
+  globalThis.__chatgptDesktopSetRenderBudget = (budget) => {
+    const reduced = budget === "reduced";
+    updateGapScale = reduced ? reducedBudgetGapScale : 1;
+    if (document.head) {
+      ensureStyle();
+    }
+    document.documentElement.classList.toggle(reducedBudgetClass, reduced);
+  };
 
   window.addEventListener("resize", () => {
     scheduleUpdate("resize");
@@ -360,6 +557,7 @@
   document.addEventListener("visibilitychange", handleVisibilityChange, { passive: true });
   window.addEventListener("pagehide", () => {
     // Tear down work before the page leaves the history stack
+    indexNeedsRescan = true;
     cancelPendingUpdate();
     clearManagedNodes();
     disconnectObservers();
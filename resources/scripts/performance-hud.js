@@ -0,0 +1,83 @@
+(() => {
+  // Page numbers for the native performance HUD, nothing runs until the HUD asks for a sample
+  const trustedOrigins = globalThis.__chatgptDesktopTrustedOrigins;
+  if (!trustedOrigins?.isTrustedLocation(window.location)) {
+    return;
+  }
+  if (globalThis.__chatgptDesktopHudSample) {
+    return;
+  }
+
+  const sampleWindowMs = 5000;
+  // The HUD polls every second, a few missed polls mean it was hidden or moved to another tab
+  const idleStopMs = 3000;
+  // Rates over shorter spans are mostly noise
+  const minimumSpanMs = 500;
+
+  let observer = null;
+  let frameHandle = 0;
+  let startedAt = 0;
+  let lastSampleAt = 0;
+  let frameTimes = [];
+  let longTasks = [];
+
+  const stop = () => {
+    observer?.disconnect();
+    observer = null;
+    if (frameHandle) {
+      cancelAnimationFrame(frameHandle);
+    }
+    frameHandle = 0;
+    frameTimes = [];
+    longTasks = [];
+  };
+
+  const countFrame = (now) => {
+    if (now - lastSampleAt > idleStopMs) {
+      stop();
+      return;
+    }
+    frameTimes.push(now);
+    frameHandle = requestAnimationFrame(countFrame);
+  };
+
+  const start = () => {
+    startedAt = performance.now();
+    try {
+      observer = new PerformanceObserver((list) => {
+        for (const entry of list.getEntries()) {
+          longTasks.push({ at: entry.startTime, duration: entry.duration });
+        }
+      });
+      observer.observe({ type: "longtask" });
+    } catch {
+      // Long task timing is missing on some builds, frames and heap still work
+      observer = null;
+    }
+    frameHandle = requestAnimationFrame(countFrame);
+  };
+
+  // The native HUD calls this once per second through the application world
+  globalThis.__chatgptDesktopHudSample = () => {
+    const now = performance.now();
+    lastSampleAt = now;
+    if (!frameHandle) {
+      start();
+    }
+
+    const cutoff = now - sampleWindowMs;
+    frameTimes = frameTimes.filter((time) => time >= cutoff);
+    longTasks = longTasks.filter((task) => task.at >= cutoff);
+    const spanMs = Math.min(sampleWindowMs, now - startedAt);
+    const hasSpan = spanMs >= minimumSpanMs;
+    const longChat = globalThis.__chatgptDesktopLongChatStats?.() ?? null;
+    return {
+      fps: hasSpan ? (frameTimes.length * 1000) / spanMs : null,
+      longTasksPerMinute: hasSpan ? (longTasks.length * 60000) / spanMs : null,
+      longTaskMs: longTasks.reduce((total, task) => total + task.duration, 0),
+      usedJsHeapBytes: performance.memory?.usedJSHeapSize ?? null,
+      managedTurns: longChat?.managedTurns ?? null,
+      documentElements: longChat?.documentElements ?? document.getElementsByTagName("*").length
+    };
+  };
+})();
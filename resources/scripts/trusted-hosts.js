@@ -1,12 +1,32 @@
 (() => {
   // Keep the browser-side allowlist in one injected helper
-  const trustedHostPattern = /(^|\.)chatgpt\.com$|(^|\.)openai\.com$|(^|\.)oaistatic\.com$/i;
+  // The list comes from resources/policy/trusted-origins.txt at build time
+  const trustedDomains = __CHATGPT_DESKTOP_TRUSTED_DOMAINS__;
+
+  // Same walk as OriginPolicy::MatchesTrustedDomain: ASCII case folding only,
+  // and a domain matches itself or a host ending in "." plus the domain
+  const matchesTrustedDomain = (host, domain) => {
+    const offset = host.length - domain.length;
+    if (offset < 0 || (offset > 0 && host.charCodeAt(offset - 1) !== 46)) {
+      return false;
+    }
+    for (let index = 0; index < domain.length; index += 1) {
+      let unit = host.charCodeAt(offset + index);
+      if (unit >= 65 && unit <= 90) {
+        unit += 32;
+      }
+      if (unit !== domain.charCodeAt(index)) {
+        return false;
+      }
+    }
+    return true;
+  };
 
   const isTrustedHost = (host) => {
     if (typeof host !== "string" || host.length === 0) {
       return false;
     }
-    return trustedHostPattern.test(host);
+    return trustedDomains.some((domain) => matchesTrustedDomain(host, domain));
   };
 
   const isTrustedLocation = (locationLike) => {
@@ -23,4 +43,6 @@
     isTrustedHost,
     isTrustedLocation
   };
+  // Startup traces read these marks back from the page timeline
+  performance.mark?.("chatgpt-desktop:trusted-hosts-ready");
 })();
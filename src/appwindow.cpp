@@ -1,29 +1,351 @@
 #include "appwindow.h"
 #include "chatview.h"
+#include "chatviewpool.h"
+#include "conversationsnapshots.h"
+#include "downloadmanager.h"
+#include "perflog.h"
+#include "performancehud.h"
+#include "processstats.h"
+#include "searchindex.h"
+#include "searchoverlay.h"
+#include "sessionstore.h"
+#include "trustedorigins.h"
+#include <QCloseEvent>
+#include <QDateTime>
+#include <QEvent>
+#include <QHash>
+#include <QIcon>
+#include <QKeySequence>
+#include <QList>
+#include <QMoveEvent>
+#include <QResizeEvent>
+#include <QShortcut>
 #include <QString>
+#include <QTabBar>
+#include <QTabWidget>
+#include <QTimer>
+#include <QWebEnginePage>
+#include <algorithm>
+#include <utility>
 
 namespace {
 // Keep the fallback title short and stable
 const QString kDefaultWindowTitle = QStringLiteral("ChatGPT Desktop");
 // Add a small suffix so branch windows still look native
 const QString kWindowTitleSuffix = QStringLiteral(" - ChatGPT Desktop");
+// Long conversation titles should not push other tabs off the bar
+constexpr int kMaxTabTitleChars = 32;
+// Renderer memory moves slowly, a few seconds between checks is plenty
+constexpr int kTabBudgetCheckIntervalMs = 5000;
+constexpr qint64 kDefaultTabMemoryBudgetMb = 2048;
+
+bool IsPerformanceHudShownAtStart() {
+  const QString value = qEnvironmentVariable("CHATGPT_DESKTOP_PERFORMANCE_HUD").trimmed().toLower();
+  return value == QStringLiteral("1") || value == QStringLiteral("true") || value == QStringLiteral("on");
+}
+
+qint64 ResolveTabMemoryBudgetBytes() {
+  bool parsed = false;
+  const qint64 budgetMb = qEnvironmentVariableIntValue("CHATGPT_DESKTOP_TAB_MEMORY_BUDGET_MB", &parsed);
+  // Zero or a bad value turns the budget off instead of discarding everything
+  const qint64 effectiveMb = parsed ? budgetMb : kDefaultTabMemoryBudgetMb;
+  return effectiveMb > 0 ? effectiveMb * 1024 * 1024 : 0;
+}
+
+QString ElideTabTitle(const QString &pageTitle) {
+  const QString trimmedTitle = pageTitle.trimmed();
+  if (trimmedTitle.isEmpty()) {
+    return kDefaultWindowTitle;
+  }
+  if (trimmedTitle.size() <= kMaxTabTitleChars) {
+    return trimmedTitle;
+  }
+  return trimmedTitle.left(kMaxTabTitleChars - 1) + QChar(0x2026);
+}
 } // namespace
 
-AppWindow::AppWindow(const QUrl &initialUrl, QWidget *parent) : QMainWindow(parent) {
-  // Every top level window owns one web view
-  chatView = new ChatView(initialUrl, this);
-  setCentralWidget(chatView);
+AppWindow::AppWindow(const QUrl &initialUrl, QWidget *parent) : AppWindow(new ChatView(initialUrl), parent) {}
 
-  // Follow the active page title so each branch is easy to spot
-  connect(chatView, &QWebEngineView::titleChanged, this, [this](const QString &pageTitle) {
-    UpdateWindowTitle(pageTitle);
-  });
+AppWindow::AppWindow(const SessionWindow &savedWindow, QWidget *parent)
+    : AppWindow(new ChatView(savedWindow.tabs.value(IsTabbedModeEnabled() ? 0 : savedWindow.currentTab)), parent) {
+  if (tabWidget != nullptr) {
+    for (qsizetype index = 1; index < savedWindow.tabs.size(); ++index) {
+      AddTab(new ChatView(savedWindow.tabs.at(index)));
+    }
+    tabWidget->setCurrentIndex(std::clamp(savedWindow.currentTab, 0, tabWidget->count() - 1));
+  }
+  if (!savedWindow.geometry.isEmpty()) {
+    restoreGeometry(savedWindow.geometry);
+  }
+}
 
-  UpdateWindowTitle(QString());
+AppWindow::AppWindow(ChatView *adoptedView, QWidget *parent) : QMainWindow(parent) {
+  if (IsTabbedModeEnabled()) {
+    // Tabbed windows keep many conversations on one window and one profile
+    tabWidget = new QTabWidget(this);
+    tabWidget->setDocumentMode(true);
+    tabWidget->setMovable(true);
+    tabWidget->setTabsClosable(true);
+    // One tab looks like a normal window until a second one shows up
+    tabWidget->setTabBarAutoHide(true);
+    setCentralWidget(tabWidget);
+
+    connect(tabWidget, &QTabWidget::tabCloseRequested, this, [this](int index) { CloseTab(index); });
+    connect(tabWidget, &QTabWidget::currentChanged, this, [this]([[maybe_unused]] int index) {
+      ChatView *currentView = GetChatView();
+      UpdateWindowTitle(currentView != nullptr ? currentView->DisplayTitle() : QString());
+      SessionStore::Instance().ScheduleSave();
+    });
+    connect(tabWidget->tabBar(), &QTabBar::tabMoved, this,
+            []([[maybe_unused]] int from, [[maybe_unused]] int to) { SessionStore::Instance().ScheduleSave(); });
+
+    QShortcut *newTabShortcut = new QShortcut(QKeySequence::AddTab, this);
+    connect(newTabShortcut, &QShortcut::activated, this, [this]() { AddTab(ChatViewPool::Instance().Open(QUrl())); });
+    QShortcut *closeTabShortcut = new QShortcut(QKeySequence::Close, this);
+    connect(closeTabShortcut, &QShortcut::activated, this,
+            [this]() { CloseTab(tabWidget->currentIndex()); });
+
+    tabMemoryBudgetBytes = ResolveTabMemoryBudgetBytes();
+    if (tabMemoryBudgetBytes > 0) {
+      tabBudgetTimer = new QTimer(this);
+      tabBudgetTimer->setInterval(kTabBudgetCheckIntervalMs);
+      connect(tabBudgetTimer, &QTimer::timeout, this, [this]() { EnforceTabMemoryBudget(); });
+      tabBudgetTimer->start();
+    }
+
+    AddTab(adoptedView);
+  } else {
+    // Every top level window owns one web view
+    // setCentralWidget reparents views that were built without a window
+    chatView = adoptedView;
+    setCentralWidget(chatView);
+
+    // Follow the active page title so each branch is easy to spot
+    connect(chatView, &QWebEngineView::titleChanged, this, [this](const QString &pageTitle) {
+      UpdateWindowTitle(pageTitle);
+    });
+  }
+
+  // Search reads what the snapshot capture saved, so it shares that opt out
+  if (ConversationSnapshots::IsEnabled()) {
+    QShortcut *searchShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_F), this);
+    connect(searchShortcut, &QShortcut::activated, this, [this]() { OpenSearchOverlay(); });
+  }
+
+  // Ctrl+Alt+P shows renderer, heap and frame numbers for whatever this window is showing
+  QShortcut *performanceHudShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::ALT | Qt::Key_P), this);
+  connect(performanceHudShortcut, &QShortcut::activated, this, [this]() { TogglePerformanceHud(); });
+
+  // Ctrl+Shift+Y shows the download panel shared by every window
+  QShortcut *downloadPanelShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_Y), this);
+  connect(downloadPanelShortcut, &QShortcut::activated, this, []() { DownloadManager::Instance().TogglePanel(); });
+
+  // Restored views have no page yet, the saved title stands in
+  UpdateWindowTitle(GetChatView() != nullptr ? GetChatView()->DisplayTitle() : QString());
   resize(1000, 700);
+
+  if (IsPerformanceHudShownAtStart()) {
+    TogglePerformanceHud();
+  }
+}
+
+bool AppWindow::IsTabbedModeEnabled() {
+  const QString value = qEnvironmentVariable("CHATGPT_DESKTOP_TABS").trimmed().toLower();
+  return value == QStringLiteral("1") || value == QStringLiteral("true") || value == QStringLiteral("on");
+}
+
+ChatView *AppWindow::GetChatView() const {
+  if (tabWidget != nullptr) {
+    // Tabs only ever hold chat views
+    return static_cast<ChatView *>(tabWidget->currentWidget());
+  }
+  return chatView;
 }
 
-ChatView *AppWindow::GetChatView() const { return chatView; }
+bool AppWindow::IsTabbed() const { return tabWidget != nullptr; }
+
+void AppWindow::AddTab(ChatView *view) {
+  if (tabWidget == nullptr || view == nullptr) {
+    return;
+  }
+
+  const int index = tabWidget->addTab(view, ElideTabTitle(view->DisplayTitle()));
+  connect(view, &QWebEngineView::titleChanged, this, [this, view](const QString &pageTitle) {
+    const int tabIndex = tabWidget->indexOf(view);
+    if (tabIndex < 0) {
+      return;
+    }
+    tabWidget->setTabText(tabIndex, ElideTabTitle(pageTitle));
+    tabWidget->setTabToolTip(tabIndex, pageTitle);
+    if (tabIndex == tabWidget->currentIndex()) {
+      UpdateWindowTitle(pageTitle);
+    }
+  });
+  connect(view, &QWebEngineView::iconChanged, this, [this, view](const QIcon &icon) {
+    const int tabIndex = tabWidget->indexOf(view);
+    if (tabIndex >= 0) {
+      tabWidget->setTabIcon(tabIndex, icon);
+    }
+  });
+
+  view->SetWindowFocused(isActiveWindow());
+  tabWidget->setCurrentIndex(index);
+}
+
+QList<ChatView *> AppWindow::ChatViews() const {
+  if (tabWidget == nullptr) {
+    return chatView != nullptr ? QList<ChatView *>{chatView} : QList<ChatView *>();
+  }
+  QList<ChatView *> views;
+  views.reserve(tabWidget->count());
+  for (int index = 0; index < tabWidget->count(); ++index) {
+    views.append(static_cast<ChatView *>(tabWidget->widget(index)));
+  }
+  return views;
+}
+
+SessionWindow AppWindow::SessionState() const {
+  SessionWindow state;
+  state.geometry = saveGeometry();
+  const ChatView *currentView = GetChatView();
+  for (const ChatView *view : ChatViews()) {
+    SessionTab tab = view->SessionState();
+    // Blank branch pages and pages of other sites do not come back
+    if (!TrustedOrigins::IsTrustedHttpsUrl(tab.url)) {
+      continue;
+    }
+    if (view == currentView) {
+      state.currentTab = static_cast<int>(state.tabs.size());
+    }
+    state.tabs.append(std::move(tab));
+  }
+  return state;
+}
+
+void AppWindow::changeEvent(QEvent *event) {
+  QMainWindow::changeEvent(event);
+  if (event->type() == QEvent::WindowStateChange) {
+    SessionStore::Instance().ScheduleSave();
+  }
+  if (event->type() != QEvent::ActivationChange) {
+    return;
+  }
+
+  const bool focused = isActiveWindow();
+  if (focused) {
+    SessionStore::Instance().NoteActiveWindow(this);
+  }
+  if (tabWidget == nullptr) {
+    if (chatView != nullptr) {
+      chatView->SetWindowFocused(focused);
+    }
+    return;
+  }
+  for (int index = 0; index < tabWidget->count(); ++index) {
+    static_cast<ChatView *>(tabWidget->widget(index))->SetWindowFocused(focused);
+  }
+}
+
+void AppWindow::moveEvent(QMoveEvent *event) {
+  QMainWindow::moveEvent(event);
+  SessionStore::Instance().ScheduleSave();
+}
+
+void AppWindow::resizeEvent(QResizeEvent *event) {
+  QMainWindow::resizeEvent(event);
+  SessionStore::Instance().ScheduleSave();
+}
+
+void AppWindow::closeEvent(QCloseEvent *event) {
+  SessionStore::Instance().NoteWindowClosing(this);
+  QMainWindow::closeEvent(event);
+}
+
+void AppWindow::CloseTab(int index) {
+  if (tabWidget == nullptr || index < 0 || index >= tabWidget->count()) {
+    return;
+  }
+
+  // Closing the last tab closes the window like a normal browser
+  if (tabWidget->count() == 1) {
+    close();
+    return;
+  }
+
+  QWidget *closedView = tabWidget->widget(index);
+  tabWidget->removeTab(index);
+  closedView->deleteLater();
+  SessionStore::Instance().ScheduleSave();
+}
+
+void AppWindow::EnforceTabMemoryBudget() {
+  if (tabWidget == nullptr || tabMemoryBudgetBytes <= 0) {
+    return;
+  }
+
+  // Several tabs can share one renderer, so count each process once
+  QHash<qint64, qint64> residentBytesByPid;
+  QList<ChatView *> backgroundViews;
+  for (int index = 0; index < tabWidget->count(); ++index) {
+    ChatView *view = static_cast<ChatView *>(tabWidget->widget(index));
+    // Restored tabs nobody opened yet hold no renderer
+    if (view->IsLoadDeferred()) {
+      continue;
+    }
+    QWebEnginePage *viewPage = view->page();
+    if (viewPage == nullptr) {
+      continue;
+    }
+
+    const qint64 renderProcessPid = viewPage->renderProcessPid();
+    if (renderProcessPid > 0 && !residentBytesByPid.contains(renderProcessPid)) {
+      residentBytesByPid.insert(renderProcessPid, ProcessStats::ResidentBytes(renderProcessPid));
+    }
+    if (index != tabWidget->currentIndex() &&
+        viewPage->lifecycleState() != QWebEnginePage::LifecycleState::Discarded) {
+      backgroundViews.append(view);
+    }
+  }
+
+  qint64 totalResidentBytes = 0;
+  for (const qint64 residentBytes : std::as_const(residentBytesByPid)) {
+    totalResidentBytes += residentBytes;
+  }
+  if (totalResidentBytes <= tabMemoryBudgetBytes) {
+    return;
+  }
+
+  // Oldest shown tabs go first, the user is least likely to come back to them soon
+  std::sort(backgroundViews.begin(), backgroundViews.end(), [](const ChatView *left, const ChatView *right) {
+    return left->LastShownAtMs() < right->LastShownAtMs();
+  });
+
+  for (ChatView *view : std::as_const(backgroundViews)) {
+    if (totalResidentBytes <= tabMemoryBudgetBytes) {
+      break;
+    }
+
+    const qint64 renderProcessPid = view->page()->renderProcessPid();
+    if (!view->DiscardPage()) {
+      continue;
+    }
+
+    // Memory only comes back once no live tab still uses that renderer
+    bool rendererStillShared = false;
+    for (int index = 0; index < tabWidget->count() && !rendererStillShared; ++index) {
+      const ChatView *otherView = static_cast<ChatView *>(tabWidget->widget(index));
+      const QWebEnginePage *otherPage = otherView->IsLoadDeferred() ? nullptr : otherView->page();
+      rendererStillShared = otherPage != nullptr && otherPage->renderProcessPid() == renderProcessPid &&
+                            otherPage->lifecycleState() != QWebEnginePage::LifecycleState::Discarded;
+    }
+    const qint64 reclaimedBytes = rendererStillShared ? 0 : residentBytesByPid.value(renderProcessPid);
+    totalResidentBytes -= reclaimedBytes;
+
+    qCInfo(lcPerformance) << "Discarded background tab" << view->url() << "idle for"
+                          << (QDateTime::currentMSecsSinceEpoch() - view->LastShownAtMs()) << "ms, reclaimed"
+                          << (reclaimedBytes / 1024) << "KiB";
+  }
+}
 
 void AppWindow::UpdateWindowTitle(const QString &pageTitle) {
   // Empty titles show up during early page load
@@ -34,3 +356,25 @@ void AppWindow::UpdateWindowTitle(const QString &pageTitle) {
 
   setWindowTitle(pageTitle + kWindowTitleSuffix);
 }
+
+void AppWindow::OpenSearchOverlay() {
+  if (searchOverlay == nullptr) {
+    searchOverlay = new SearchOverlay(
+        [this](const SearchHit &hit) {
+          ChatView *currentView = GetChatView();
+          if (currentView != nullptr) {
+            // Keys are host plus path of a trusted conversation page
+            currentView->OpenConversation(QUrl(QStringLiteral("https://") + hit.conversationKey), hit.turnIndex);
+          }
+        },
+        this);
+  }
+  searchOverlay->Open();
+}
+
+void AppWindow::TogglePerformanceHud() {
+  if (performanceHud == nullptr) {
+    performanceHud = new PerformanceHud([this]() { return GetChatView(); }, this);
+  }
+  performanceHud->Toggle();
+}
@@ -1,19 +1,65 @@
 #pragma once
+#include "sessionstore.h"
+
+#include <QList>
 #include <QMainWindow>
 #include <QUrl>
 
 class ChatView;
+class QCloseEvent;
+class QEvent;
+class QMoveEvent;
+class PerformanceHud;
+class SearchOverlay;
+class QResizeEvent;
 class QString;
+class QTabWidget;
+class QTimer;
 
 class AppWindow : public QMainWindow {
 public:
   explicit AppWindow(const QUrl &initialUrl = QUrl(), QWidget *parent = nullptr);
+  // Take over a view that was built ahead of time, such as one from the warm pool
+  explicit AppWindow(ChatView *adoptedView, QWidget *parent = nullptr);
+  // Bring a saved window back with its tabs and geometry, every page waits until it is seen
+  explicit AppWindow(const SessionWindow &savedWindow, QWidget *parent = nullptr);
+  // CHATGPT_DESKTOP_TABS=1 puts branches and new conversations in tabs
+  static bool IsTabbedModeEnabled();
+  // Current tab in tabbed mode, otherwise the only view
   ChatView *GetChatView() const;
+  // Tabbed windows host several views on the shared profile
+  bool IsTabbed() const;
+  // Show a view as the new foreground tab, only valid in tabbed mode
+  void AddTab(ChatView *view);
+  // Tabs in bar order, or the only view
+  QList<ChatView *> ChatViews() const;
+  // Geometry and the trusted pages on display, for the session file
+  SessionWindow SessionState() const;
+
+protected:
+  // Pass focus changes down so unfocused windows render at a lower budget
+  void changeEvent(QEvent *event) override;
+  // Geometry and closes feed the session file
+  void moveEvent(QMoveEvent *event) override;
+  void resizeEvent(QResizeEvent *event) override;
+  void closeEvent(QCloseEvent *event) override;
 
 private:
   // Keep the window title close to the active page title
   void UpdateWindowTitle(const QString &pageTitle);
+  void CloseTab(int index);
+  // Discard least recently shown background tabs while renderers exceed the budget
+  void EnforceTabMemoryBudget();
+  // Built on first use, the index is only opened once somebody searches
+  void OpenSearchOverlay();
+  // Also built on first use, nothing samples the page before that
+  void TogglePerformanceHud();
 
-  // Qt owns this child after setCentralWidget
-  ChatView *chatView;
+  // Qt owns this child after setCentralWidget, unused in tabbed mode
+  ChatView *chatView = nullptr;
+  QTabWidget *tabWidget = nullptr;
+  QTimer *tabBudgetTimer = nullptr;
+  qint64 tabMemoryBudgetBytes = 0;
+  SearchOverlay *searchOverlay = nullptr;
+  PerformanceHud *performanceHud = nullptr;
 };
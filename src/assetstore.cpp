@@ -0,0 +1,446 @@
+#include "assetstore.h"
+#include "perflog.h"
+#include "trustedorigins.h"
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileDevice>
+#include <QFileInfo>
+#include <QHash>
+#include <QIODevice>
+#include <QList>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QPointer>
+#include <QSaveFile>
+#include <QStringView>
+#include <QWebEngineProfile>
+#include <QWebEngineUrlRequestJob>
+#include <QWebEngineUrlScheme>
+#include <QWebEngineUrlSchemeHandler>
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace {
+constexpr auto kSchemeName = "chatgpt-desktop-asset";
+constexpr qint64 kDefaultMaxStoreMb = 256;
+// Bigger responses still reach the page, they are just not kept
+constexpr qint64 kMaxAssetBytes = 32 * 1024 * 1024;
+// Eviction frees a little extra so the next few inserts do not evict again
+constexpr qint64 kEvictToPercent = 80;
+// The page waits on a missed asset's fetch, a stalled one fails that load instead of hanging it
+constexpr int kFetchTimeoutMs = 30 * 1000;
+// Shortest run in a file name that counts as a content hash
+constexpr qsizetype kMinHashChars = 8;
+class AssetSchemeHandler;
+// The installed handler owns the store, this only lets the static helpers find it
+AssetSchemeHandler *installedHandler = nullptr;
+
+qint64 ResolveMaxStoreBytes() {
+  bool parsed = false;
+  const qint64 maxMb = qEnvironmentVariableIntValue("CHATGPT_DESKTOP_ASSET_STORE_MB", &parsed);
+  const qint64 effectiveMb = parsed ? maxMb : kDefaultMaxStoreMb;
+  return effectiveMb > 0 ? effectiveMb * 1024 * 1024 : 0;
+}
+
+bool IsStaticAssetHost(QStringView host) {
+  return host.compare(u"oaistatic.com", Qt::CaseInsensitive) == 0 ||
+         host.endsWith(u".oaistatic.com", Qt::CaseInsensitive);
+}
+
+QByteArray HexDigest(const QByteArray &bytes, QCryptographicHash::Algorithm algorithm) {
+  return QCryptographicHash::hash(bytes, algorithm).toHex();
+}
+
+void WritePrivateFile(const QString &path, const QByteArray &bytes) {
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly) || file.write(bytes) != bytes.size() || !file.commit()) {
+    qWarning() << "Failed to write asset store file:" << path << file.errorString();
+    return;
+  }
+  QFile::setPermissions(path, QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+QUrl AssetUrlFor(const QUrl &storeUrl) {
+  QUrl assetUrl(storeUrl);
+  assetUrl.setScheme(QStringLiteral("https"));
+  return assetUrl;
+}
+
+void ReplyWithAsset(QWebEngineUrlRequestJob *job, const AssetStore::Asset &asset) {
+  // Scripts load in CORS mode from the page origin, and the copy itself never changes
+  job->setAdditionalResponseHeaders({{QByteArrayLiteral("Access-Control-Allow-Origin"), QByteArrayLiteral("*")},
+                                     {QByteArrayLiteral("Cache-Control"),
+                                      QByteArrayLiteral("public, max-age=31536000, immutable")}});
+  // The job owns the reply buffer and frees it once Chromium has read it
+  auto *replyBody = new QBuffer(job);
+  replyBody->setData(asset.bytes);
+  replyBody->open(QIODevice::ReadOnly);
+  // Chromium sniffs the charset itself, the job only takes the bare MIME type
+  job->reply(asset.contentType.split(';').constFirst().trimmed(), replyBody);
+}
+
+class AssetSchemeHandler final : public QWebEngineUrlSchemeHandler {
+public:
+  AssetSchemeHandler(std::unique_ptr<AssetStore> store, QObject *parent)
+      : QWebEngineUrlSchemeHandler(parent), m_store(std::move(store)), m_network(new QNetworkAccessManager(this)) {
+    m_network->setTransferTimeout(kFetchTimeoutMs);
+  }
+
+  AssetStore *Store() const { return m_store.get(); }
+
+  void requestStarted(QWebEngineUrlRequestJob *job) override {
+    const QUrl assetUrl = AssetUrlFor(job->requestUrl());
+    const QUrl initiator = job->initiator();
+    // Only trusted pages, or assets they already loaded through the store, may read from it
+    const bool trustedInitiator =
+        TrustedOrigins::IsTrustedHttpsUrl(initiator) || initiator.scheme() == QLatin1String(kSchemeName);
+    if (job->requestMethod() != QByteArrayLiteral("GET") || !trustedInitiator ||
+        !AssetStore::IsImmutableAssetUrl(assetUrl)) {
+      job->fail(QWebEngineUrlRequestJob::RequestDenied);
+      return;
+    }
+
+    const std::optional<AssetStore::Asset> asset = m_store->Lookup(assetUrl);
+    if (asset.has_value()) {
+      ReplyWithAsset(job, *asset);
+      return;
+    }
+    Fetch(assetUrl, job);
+  }
+
+private:
+  // A miss is downloaded once and the same bytes answer the page and fill the store
+  void Fetch(const QUrl &assetUrl, QWebEngineUrlRequestJob *job) {
+    QList<QPointer<QWebEngineUrlRequestJob>> &waitingJobs = m_waitingJobs[assetUrl];
+    waitingJobs.append(job);
+    if (waitingJobs.size() > 1) {
+      return;
+    }
+    m_store->NoteMiss();
+    // The manager keeps the default proxy, which follows the same Qt Network settings WebEngine hands to Chromium
+    QNetworkReply *reply = m_network->get(QNetworkRequest(assetUrl));
+    connect(reply, &QNetworkReply::finished, this, [this, reply, assetUrl]() {
+      reply->deleteLater();
+      const QList<QPointer<QWebEngineUrlRequestJob>> jobs = m_waitingJobs.take(assetUrl);
+      const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+      if (reply->error() != QNetworkReply::NoError || status != 200) {
+        // Redirecting back to https would only come through the interceptor again
+        for (const QPointer<QWebEngineUrlRequestJob> &waitingJob : jobs) {
+          if (!waitingJob.isNull()) {
+            waitingJob->fail(QWebEngineUrlRequestJob::RequestFailed);
+          }
+        }
+        return;
+      }
+      QByteArray contentType = reply->header(QNetworkRequest::ContentTypeHeader).toString().toUtf8();
+      if (contentType.isEmpty()) {
+        contentType = QByteArrayLiteral("application/octet-stream");
+      }
+      const AssetStore::Asset asset{contentType, reply->readAll()};
+      m_store->Insert(assetUrl, asset.contentType, asset.bytes);
+      // Pages that closed while the fetch ran have had their jobs deleted by Chromium
+      for (const QPointer<QWebEngineUrlRequestJob> &waitingJob : jobs) {
+        if (!waitingJob.isNull()) {
+          ReplyWithAsset(waitingJob, asset);
+        }
+      }
+    });
+  }
+
+  std::unique_ptr<AssetStore> m_store;
+  QNetworkAccessManager *m_network = nullptr;
+  // Pages ask for the same chunk from several places at once, one fetch answers all of them
+  QHash<QUrl, QList<QPointer<QWebEngineUrlRequestJob>>> m_waitingJobs;
+};
+#endif
+} // namespace
+
+void AssetStore::RegisterUrlScheme() {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+  QWebEngineUrlScheme scheme(kSchemeName);
+  scheme.setSyntax(QWebEngineUrlScheme::Syntax::Host);
+  // Stand in for HTTPS subresources: secure and CORS aware, the site's own script policy still applies
+  scheme.setFlags(QWebEngineUrlScheme::SecureScheme | QWebEngineUrlScheme::CorsEnabled |
+                  QWebEngineUrlScheme::FetchApiAllowed);
+  QWebEngineUrlScheme::registerScheme(scheme);
+#endif
+}
+
+bool AssetStore::IsEnabled() {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+  const QString value = qEnvironmentVariable("CHATGPT_DESKTOP_ASSET_STORE").trimmed().toLower();
+  const bool requested =
+      value == QStringLiteral("1") || value == QStringLiteral("true") || value == QStringLiteral("on");
+  return requested && ResolveMaxStoreBytes() > 0;
+#else
+  return false;
+#endif
+}
+
+bool AssetStore::IsImmutableAssetUrl(const QUrl &url) {
+  if (!TrustedOrigins::IsTrustedHttpsUrl(url) || !IsStaticAssetHost(url.host()) || url.hasQuery()) {
+    return false;
+  }
+
+  static const QStringList kAssetSuffixes = {
+      QStringLiteral("js"),   QStringLiteral("mjs"),  QStringLiteral("css"), QStringLiteral("woff2"),
+      QStringLiteral("woff"), QStringLiteral("ttf"),  QStringLiteral("wasm"), QStringLiteral("svg"),
+      QStringLiteral("png"),  QStringLiteral("webp"), QStringLiteral("avif")};
+  const QString fileName = url.fileName();
+  const qsizetype suffixStart = fileName.lastIndexOf(QLatin1Char('.'));
+  if (suffixStart <= 0 || !kAssetSuffixes.contains(fileName.mid(suffixStart + 1).toLower())) {
+    return false;
+  }
+
+  // Bundlers append the hash after a dot, dash or underscore, or use it as the whole name
+  const QString stem = fileName.left(suffixStart);
+  const qsizetype hashStart =
+      std::max({stem.lastIndexOf(QLatin1Char('.')), stem.lastIndexOf(QLatin1Char('-')),
+                stem.lastIndexOf(QLatin1Char('_'))}) + 1;
+  const QStringView hash = QStringView(stem).mid(hashStart);
+  if (hash.size() < kMinHashChars) {
+    return false;
+  }
+  // Plain words like "vendors" are not hashes, real hashes mix letters and digits
+  const bool hasDigit = std::any_of(hash.begin(), hash.end(), [](QChar character) { return character.isDigit(); });
+  const bool hasLetter =
+      std::any_of(hash.begin(), hash.end(), [](QChar character) { return character.isLetter(); });
+  const bool isAlphanumeric =
+      std::all_of(hash.begin(), hash.end(), [](QChar character) { return character.isLetterOrNumber(); });
+  return hasDigit && hasLetter && isAlphanumeric;
+}
+
+QUrl AssetStore::StoreUrlFor(const QUrl &assetUrl) {
+  QUrl storeUrl(assetUrl);
+  storeUrl.setScheme(QString::fromLatin1(kSchemeName));
+  return storeUrl;
+}
+
+bool AssetStore::InstallHandler(QWebEngineProfile *profile, const QString &directoryPath) {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+  if (profile == nullptr || !IsEnabled() || !QDir().mkpath(directoryPath)) {
+    return false;
+  }
+  auto *handler =
+      new AssetSchemeHandler(std::make_unique<AssetStore>(directoryPath, ResolveMaxStoreBytes()), profile);
+  AssetStore *store = handler->Store();
+  installedHandler = handler;
+  profile->installUrlSchemeHandler(kSchemeName, handler);
+
+  QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, handler, [store]() {
+    const Stats &stats = store->Counters();
+    qCInfo(lcPerformance).noquote() << "Asset store:" << stats.hits << "hits," << stats.hitBytes / 1024
+                                    << "KiB served locally," << stats.misses << "misses," << stats.missBytes / 1024
+                                    << "KiB fetched," << stats.evictedBytes / 1024 << "KiB evicted";
+  });
+  QObject::connect(handler, &QObject::destroyed, [handler]() {
+    if (installedHandler == handler) {
+      installedHandler = nullptr;
+    }
+  });
+  return true;
+#else
+  Q_UNUSED(profile);
+  Q_UNUSED(directoryPath);
+  return false;
+#endif
+}
+
+AssetStore::Stats AssetStore::CurrentStats() {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+  return installedHandler != nullptr ? installedHandler->Store()->Counters() : Stats();
+#else
+  return Stats();
+#endif
+}
+
+AssetStore::AssetStore(const QString &directoryPath, qint64 maxBytes)
+    : m_directoryPath(directoryPath), m_maxBytes(maxBytes) {}
+
+std::optional<AssetStore::Asset> AssetStore::Lookup(const QUrl &assetUrl) {
+  std::optional<Asset> asset = ReadAsset(assetUrl);
+  if (asset.has_value()) {
+    ++m_stats.hits;
+    m_stats.hitBytes += asset->bytes.size();
+  }
+  return asset;
+}
+
+void AssetStore::NoteMiss() { ++m_stats.misses; }
+
+std::optional<AssetStore::Asset> AssetStore::ReadAsset(const QUrl &assetUrl) {
+  const QString refPath = RefPath(assetUrl);
+  QFile refFile(refPath);
+  if (!refFile.open(QIODevice::ReadOnly)) {
+    return std::nullopt;
+  }
+  // Refs hold the content hash, the content type and the object size, one per line
+  const QList<QByteArray> refLines = refFile.readAll().split('\n');
+  refFile.close();
+  bool sizeParsed = false;
+  const qint64 expectedBytes = refLines.size() >= 3 ? refLines.at(2).toLongLong(&sizeParsed) : -1;
+  if (!sizeParsed || refLines.at(0).isEmpty()) {
+    QFile::remove(refPath);
+    return std::nullopt;
+  }
+
+  const QByteArray &contentHash = refLines.at(0);
+  const QString objectPath = ObjectPath(contentHash);
+  QFile objectFile(objectPath);
+  if (!objectFile.open(QIODevice::ReadWrite)) {
+    // Evicted by this or another process, the ref is all that is left
+    QFile::remove(refPath);
+    return std::nullopt;
+  }
+  Asset asset{refLines.at(1), objectFile.readAll()};
+  // Objects are hashed on insert and land whole through QSaveFile, so a hit only checks for truncation
+  if (asset.bytes.size() != expectedBytes) {
+    qWarning() << "Dropping damaged asset store object:" << objectPath;
+    objectFile.close();
+    QFile::remove(objectPath);
+    QFile::remove(refPath);
+    ForgetObject(contentHash);
+    return std::nullopt;
+  }
+  // Modification time doubles as the LRU clock, on disk for other processes and in the index for this one
+  const QDateTime now = QDateTime::currentDateTimeUtc();
+  objectFile.setFileTime(now, QFileDevice::FileModificationTime);
+  if (m_indexed) {
+    StoredObject &object = m_objects[contentHash];
+    if (object.bytes == 0) {
+      // Written by another process after the index was built
+      object.bytes = expectedBytes;
+      m_storedBytes += expectedBytes;
+    }
+    object.lastUsed = now;
+  }
+  return asset;
+}
+
+void AssetStore::Insert(const QUrl &assetUrl, const QByteArray &contentType, const QByteArray &bytes) {
+  m_stats.missBytes += bytes.size();
+  if (bytes.isEmpty() || bytes.size() > kMaxAssetBytes || bytes.size() > m_maxBytes / 4) {
+    return;
+  }
+  if (!m_indexed) {
+    BuildIndex();
+  }
+
+  // Identical files published under several names share one object, the hash is taken once here
+  const QByteArray contentHash = HexDigest(bytes, QCryptographicHash::Sha256);
+  const QString objectPath = ObjectPath(contentHash);
+  if (!m_objects.contains(contentHash) && !QFileInfo::exists(objectPath)) {
+    QDir().mkpath(QFileInfo(objectPath).path());
+    WritePrivateFile(objectPath, bytes);
+  }
+  StoredObject &object = m_objects[contentHash];
+  if (object.bytes == 0) {
+    object.bytes = bytes.size();
+    m_storedBytes += bytes.size();
+  }
+  object.lastUsed = QDateTime::currentDateTimeUtc();
+  // The object lands before the ref, so a reader never finds a ref without its object
+  QDir().mkpath(QFileInfo(RefPath(assetUrl)).path());
+  WritePrivateFile(RefPath(assetUrl), contentHash + '\n' + contentType + '\n' + QByteArray::number(bytes.size()));
+
+  if (m_storedBytes > m_maxBytes) {
+    EvictIfNeeded();
+  }
+}
+
+const AssetStore::Stats &AssetStore::Counters() const { return m_stats; }
+
+QString AssetStore::RefPath(const QUrl &assetUrl) const {
+  const QByteArray urlHash = HexDigest(assetUrl.toEncoded(), QCryptographicHash::Sha1);
+  return QDir(m_directoryPath).filePath(QStringLiteral("refs/") + QString::fromLatin1(urlHash));
+}
+
+QString AssetStore::ObjectPath(const QByteArray &contentHash) const {
+  // Two character fan out keeps directories small
+  return QDir(m_directoryPath)
+      .filePath(QStringLiteral("objects/%1/%2")
+                    .arg(QString::fromLatin1(contentHash.left(2)), QString::fromLatin1(contentHash)));
+}
+
+void AssetStore::BuildIndex() {
+  m_indexed = true;
+  m_objects.clear();
+  m_storedBytes = 0;
+  QDirIterator objectIterator(QDir(m_directoryPath).filePath(QStringLiteral("objects")), QDir::Files,
+                              QDirIterator::Subdirectories);
+  while (objectIterator.hasNext()) {
+    objectIterator.next();
+    const QFileInfo objectInfo = objectIterator.fileInfo();
+    if (objectInfo.size() <= 0) {
+      continue;
+    }
+    m_objects.insert(objectInfo.fileName().toLatin1(), StoredObject{objectInfo.size(), objectInfo.lastModified()});
+    m_storedBytes += objectInfo.size();
+  }
+
+  // Refs to objects evicted in earlier runs would only turn into misses later, drop them once here
+  QDirIterator refIterator(QDir(m_directoryPath).filePath(QStringLiteral("refs")), QDir::Files);
+  while (refIterator.hasNext()) {
+    const QString refPath = refIterator.next();
+    QFile refFile(refPath);
+    if (refFile.open(QIODevice::ReadOnly) && !m_objects.contains(refFile.readLine().trimmed())) {
+      refFile.close();
+      QFile::remove(refPath);
+    }
+  }
+  EvictIfNeeded();
+}
+
+void AssetStore::ForgetObject(const QByteArray &contentHash) {
+  const auto object = m_objects.constFind(contentHash);
+  if (object != m_objects.constEnd()) {
+    m_storedBytes -= object->bytes;
+    m_objects.erase(object);
+  }
+}
+
+void AssetStore::EvictIfNeeded() {
+  if (m_storedBytes <= m_maxBytes) {
+    return;
+  }
+  std::vector<std::pair<QDateTime, QByteArray>> candidates;
+  candidates.reserve(m_objects.size());
+  for (auto object = m_objects.cbegin(); object != m_objects.cend(); ++object) {
+    candidates.emplace_back(object->lastUsed, object.key());
+  }
+  std::sort(candidates.begin(), candidates.end());
+
+  const qint64 targetBytes = m_maxBytes * kEvictToPercent / 100;
+  qint64 evictedBytes = 0;
+  for (const auto &[lastUsed, contentHash] : candidates) {
+    if (m_storedBytes <= targetBytes) {
+      break;
+    }
+    const QString objectPath = ObjectPath(contentHash);
+    // Another process may have used the object since, only its file time tells
+    const QFileInfo objectInfo(objectPath);
+    if (objectInfo.exists() && objectInfo.lastModified() > lastUsed) {
+      m_objects[contentHash].lastUsed = objectInfo.lastModified();
+      continue;
+    }
+    // Refs left behind are dropped by the next read that finds their object gone
+    if (QFile::remove(objectPath) || !objectInfo.exists()) {
+      evictedBytes += m_objects.value(contentHash).bytes;
+      ForgetObject(contentHash);
+    }
+  }
+  m_stats.evictedBytes += evictedBytes;
+  qCInfo(lcPerformance).noquote() << "Asset store evicted" << evictedBytes / 1024 << "KiB, now"
+                                  << m_storedBytes / 1024 << "KiB";
+}
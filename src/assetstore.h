@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QString>
+#include <QUrl>
+#include <QtGlobal>
+#include <optional>
+
+class QWebEngineProfile;
+
+// Content addressed copies of hash named static assets, shared by the main and isolated profiles
+class AssetStore final {
+public:
+  struct Asset {
+    QByteArray contentType;
+    QByteArray bytes;
+  };
+
+  struct Stats {
+    quint64 hits = 0;
+    quint64 misses = 0;
+    quint64 hitBytes = 0;
+    quint64 missBytes = 0;
+    quint64 evictedBytes = 0;
+  };
+
+  // Chromium reads custom scheme registrations once, before QApplication exists
+  static void RegisterUrlScheme();
+  // CHATGPT_DESKTOP_ASSET_STORE=1 turns it on, and it needs response headers on scheme replies
+  static bool IsEnabled();
+  // Hash named files on the trusted static hosts never change once published
+  static bool IsImmutableAssetUrl(const QUrl &url);
+  // Store scheme URL that stands in for an asset, relative imports keep resolving on the same scheme
+  static QUrl StoreUrlFor(const QUrl &assetUrl);
+  // Serve the store scheme for pages on this profile from a store kept in directoryPath, false when off
+  static bool InstallHandler(QWebEngineProfile *profile, const QString &directoryPath);
+  // Counters of the installed store, all zero when there is none
+  static Stats CurrentStats();
+
+  AssetStore(const QString &directoryPath, qint64 maxBytes);
+
+  // Checks the size recorded at insert, a damaged copy is dropped and reads as a miss
+  std::optional<Asset> Lookup(const QUrl &assetUrl);
+  void NoteMiss();
+  // Hashes the bytes once to name the object
+  void Insert(const QUrl &assetUrl, const QByteArray &contentType, const QByteArray &bytes);
+  const Stats &Counters() const;
+
+private:
+  struct StoredObject {
+    qint64 bytes = 0;
+    QDateTime lastUsed;
+  };
+
+  std::optional<Asset> ReadAsset(const QUrl &assetUrl);
+  QString RefPath(const QUrl &assetUrl) const;
+  QString ObjectPath(const QByteArray &contentHash) const;
+  // One directory scan on the first insert, later inserts and hits keep the index and total current
+  void BuildIndex();
+  void ForgetObject(const QByteArray &contentHash);
+  void EvictIfNeeded();
+
+  QString m_directoryPath;
+  qint64 m_maxBytes = 0;
+  bool m_indexed = false;
+  // Objects by content hash, other processes' writes join when this one reads them
+  QHash<QByteArray, StoredObject> m_objects;
+  qint64 m_storedBytes = 0;
+  Stats m_stats;
+};
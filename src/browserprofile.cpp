@@ -1,27 +1,61 @@
 #include "browserprofile.h"
-
+#include "assetstore.h"
+#include "chatinjections.h"
+#include "chatview.h"
+#include "clipboardchannel.h"
+#include "conversationsnapshots.h"
+#include "metrics.h"
+#include "perflog.h"
+#include "requestinterceptor.h"
+#include "startuptrace.h"
+
+#include <QApplication>
 #include <QCoreApplication>
 #include <QDateTime>
 #include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileDevice>
+#include <QFileInfo>
+#include <QList>
 #include <QLockFile>
 #include <QNetworkCookie>
+#include <QRegularExpression>
 #include <QStandardPaths>
+#include <QStringList>
 #include <QSysInfo>
 #include <QThread>
+#include <QTimer>
 #include <QWebEngineCookieStore>
+#include <QWebEnginePage>
 #include <QWebEngineProfile>
+#include <QWebEngineScript>
+#include <QWebEngineScriptCollection>
+#include <QWebEngineView>
+#include <QWidget>
 #include <QUuid>
 #include <algorithm>
 #include <cerrno>
 #include <csignal>
 #include <limits>
 #include <memory>
+#include <optional>
+#include <utility>
+#include <sqlite3.h>
 
 namespace {
 constexpr auto kProfileName = "chatgpt-desktop-unix";
-constexpr int kCookieDrainWindowMs = 350;
-constexpr int kMinimumQuitDelayMs = 120;
+// Unload handlers' cookie writes reach the store within a few event loop turns after their renderer is gone
+constexpr int kShutdownQuietWindowMs = 60;
+// A renderer that will not exit or a page that keeps writing cookies must not hold the quit hostage
+constexpr int kShutdownDeadlineMs = 1000;
+// Old isolated profiles are collected once startup I/O has settled
+constexpr int kIsolatedCollectDelayMs = 10 * 1000;
+// Deleting a big Chromium profile takes a while, the rest waits for the next launch
+constexpr qint64 kIsolatedCollectBudgetMs = 5 * 1000;
+// Login state lives in the cookie database, newer Chromium keeps it under Network
+const QStringList kSeededCookieDatabases = {QStringLiteral("Network/Cookies"), QStringLiteral("Cookies")};
 
 // Random bridge text makes the prompt channel hard to guess from page code
 QString BuildClipboardBridgePrefix() {
@@ -39,6 +73,102 @@ bool IsProcessAlive(qint64 processId) {
   // EPERM still means the process exists but cannot be signaled
   return ::kill(nativePid, 0) == 0 || errno == EPERM;
 }
+
+// Copies through SQLite's backup API, one step reads every page under a single lock so the copy is consistent
+bool BackupSqliteDatabase(const QString &sourcePath, const QString &targetPath) {
+  sqlite3 *source = nullptr;
+  sqlite3 *target = nullptr;
+  bool copied = false;
+  QString error;
+  if (sqlite3_open_v2(QFile::encodeName(sourcePath).constData(), &source, SQLITE_OPEN_READONLY, nullptr) !=
+      SQLITE_OK) {
+    error = QString::fromUtf8(sqlite3_errmsg(source));
+  } else if (sqlite3_open_v2(QFile::encodeName(targetPath).constData(), &target,
+                             SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+    error = QString::fromUtf8(sqlite3_errmsg(target));
+  } else if (sqlite3_backup *backup = sqlite3_backup_init(target, "main", source, "main"); backup == nullptr) {
+    error = QString::fromUtf8(sqlite3_errmsg(target));
+  } else {
+    // A busy or locked source means the owner holds it, retrying would only stall startup
+    const int stepResult = sqlite3_backup_step(backup, -1);
+    const int finishResult = sqlite3_backup_finish(backup);
+    copied = stepResult == SQLITE_DONE && finishResult == SQLITE_OK;
+    if (!copied) {
+      error = QString::fromUtf8(sqlite3_errstr(stepResult != SQLITE_DONE ? stepResult : finishResult));
+    }
+  }
+  // Both accept a connection that failed to open
+  sqlite3_close(source);
+  sqlite3_close(target);
+
+  if (!copied) {
+    qWarning().noquote() << "Failed to seed" << sourcePath << "into the isolated profile:" << error;
+    QFile::remove(targetPath);
+    return false;
+  }
+  QFile::setPermissions(targetPath, QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+  return true;
+}
+
+// Copy login cookies from the main profile so a second instance does not start logged out
+void SeedIsolatedStorage(const QString &mainStoragePath, const QString &isolatedStoragePath) {
+  QElapsedTimer seedTimer;
+  seedTimer.start();
+  const QDir mainDirectory(mainStoragePath);
+  const QDir isolatedDirectory(isolatedStoragePath);
+  // Local Storage is LevelDB, which has no safe reader while its owner writes, and an isolated profile only
+  // exists because the owner is alive, so it is never copied
+  for (const QString &entry : kSeededCookieDatabases) {
+    const QString sourcePath = mainDirectory.filePath(entry);
+    if (!QFileInfo(sourcePath).isFile()) {
+      continue;
+    }
+    const QString targetPath = isolatedDirectory.filePath(entry);
+    QDir().mkpath(QFileInfo(targetPath).path());
+    if (BackupSqliteDatabase(sourcePath, targetPath)) {
+      qCInfo(lcPerformance).noquote() << "Seeded isolated profile cookies from" << entry + QLatin1Char(',')
+                                      << QFileInfo(targetPath).size() / 1024 << "KiB in" << seedTimer.elapsed() << "ms";
+    }
+    return;
+  }
+}
+
+// Isolated directories are named isolated-<pid>-<ms>, a dead owner means nobody will use them again
+void CollectStaleIsolatedProfiles(const QStringList &roots) {
+  static const QRegularExpression isolatedName(QStringLiteral("^isolated-(\\d+)-\\d+$"));
+  QElapsedTimer collectTimer;
+  collectTimer.start();
+  int removedDirectories = 0;
+  for (const QString &root : roots) {
+    const QDir rootDirectory(root);
+    const QStringList candidates =
+        rootDirectory.entryList({QStringLiteral("isolated-*")}, QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &candidate : candidates) {
+      // A quit stops the cleanup between directories
+      if (QThread::currentThread()->isInterruptionRequested()) {
+        return;
+      }
+      if (collectTimer.elapsed() > kIsolatedCollectBudgetMs) {
+        qCInfo(lcPerformance).noquote() << "Isolated profile cleanup ran out of time after" << removedDirectories
+                                        << "directories, the rest waits for the next launch";
+        return;
+      }
+      const QRegularExpressionMatch match = isolatedName.match(candidate);
+      if (!match.hasMatch() || IsProcessAlive(match.captured(1).toLongLong())) {
+        continue;
+      }
+      if (QDir(rootDirectory.filePath(candidate)).removeRecursively()) {
+        ++removedDirectories;
+      } else {
+        qWarning() << "Failed to remove stale isolated profile:" << rootDirectory.filePath(candidate);
+      }
+    }
+  }
+  if (removedDirectories > 0) {
+    qCInfo(lcPerformance).noquote() << "Removed" << removedDirectories << "stale isolated profile directories in"
+                                    << collectTimer.elapsed() << "ms";
+  }
+}
 } // namespace
 
 BrowserProfile &BrowserProfile::Instance() {
@@ -53,27 +183,35 @@ QWebEngineProfile *BrowserProfile::Profile() const { return m_profile; }
 
 const QString &BrowserProfile::ClipboardBridgePrefix() const { return m_clipboardBridgePrefix; }
 
+bool BrowserProfile::OwnsMainProfile() const { return m_profileLock != nullptr; }
+
+const QString &BrowserProfile::StoragePath() const { return m_storagePath; }
+
 void BrowserProfile::InitializeProfile() {
   if (m_profile != nullptr) {
     // The shared profile should only be built once
     return;
   }
+  StartupTrace::Scope traceScope("BrowserProfile::InitializeProfile");
 
   // Stable disk paths let login state survive restarts
   const QString storageRoot = ResolveStorageRoot();
   const QString cacheRoot = ResolveCacheRoot();
 
+  StartupTrace::Begin("profile mkpath");
   if (!QDir().mkpath(storageRoot)) {
     qWarning() << "Failed to create profile storage path:" << storageRoot;
   }
   if (!QDir().mkpath(cacheRoot)) {
     qWarning() << "Failed to create profile cache path:" << cacheRoot;
   }
+  StartupTrace::End("profile mkpath");
 
   QString activeStoragePath = storageRoot;
   QString activeCachePath = cacheRoot;
 
   // One lock decides which process owns the main Chromium files
+  StartupTrace::Begin("profile lock probe");
   const QString lockPath = QDir(storageRoot).filePath(QStringLiteral("profile.lock"));
   std::unique_ptr<QLockFile> profileLock = std::make_unique<QLockFile>(lockPath);
   profileLock->setStaleLockTime(0);
@@ -96,6 +234,8 @@ void BrowserProfile::InitializeProfile() {
     }
   }
 
+  StartupTrace::End("profile lock probe");
+
   // Fall back to isolated paths only when another live process owns the main profile
   if (!hasProfileLock) {
     // This keeps a second app process usable without corrupting shared Chromium state
@@ -107,12 +247,16 @@ void BrowserProfile::InitializeProfile() {
 
     if (!QDir().mkpath(activeStoragePath) || !QDir().mkpath(activeCachePath)) {
       qWarning() << "Failed to create isolated profile paths:" << activeStoragePath << activeCachePath;
+    } else {
+      StartupTrace::Scope seedScope("seed isolated profile");
+      SeedIsolatedStorage(storageRoot, activeStoragePath);
     }
 
     qWarning() << "Profile storage lock is held by another process, using isolated profile paths";
   }
 
   m_clipboardBridgePrefix = BuildClipboardBridgePrefix();
+  m_storagePath = activeStoragePath;
   // The profile object is parented to QCoreApplication for normal app lifetime ownership
   m_profile = new QWebEngineProfile(QString::fromLatin1(kProfileName), QCoreApplication::instance());
   m_profile->setPersistentStoragePath(activeStoragePath);
@@ -121,6 +265,24 @@ void BrowserProfile::InitializeProfile() {
   m_profile->setHttpCacheType(QWebEngineProfile::DiskHttpCache);
   // Force persistent cookies so login state survives a restart
   m_profile->setPersistentCookiesPolicy(QWebEngineProfile::ForcePersistentCookies);
+  // Large code copies stream through the bridge scheme instead of prompt()
+  ClipboardChannel::InstallHandler(m_profile, m_clipboardBridgePrefix);
+  // Hash named bundles come from a store under the main cache root, so isolated profiles start warm too,
+  // and bundle loads are only redirected there once its handler is in place
+  const bool serveStoredAssets =
+      AssetStore::InstallHandler(m_profile, QDir(cacheRoot).filePath(QStringLiteral("assets")));
+  const bool blockRequests = RequestInterceptor::IsBlockingEnabled();
+  if (serveStoredAssets || blockRequests) {
+    // Interceptors run for every request, so only install one when it has work to do
+    std::optional<RequestRuleSet> blockRules;
+    if (blockRequests) {
+      blockRules = RequestInterceptor::LoadBlockRules(storageRoot);
+    }
+    // The profile owns the interceptor
+    m_profile->setUrlRequestInterceptor(
+        new RequestInterceptor(serveStoredAssets, std::move(blockRules), m_profile));
+  }
+  InstallInjectedScripts();
 
   // Keep the lock object alive for as long as this process owns the profile
   if (hasProfileLock) {
@@ -130,21 +292,91 @@ void BrowserProfile::InitializeProfile() {
   QWebEngineCookieStore *cookieStore = m_profile->cookieStore();
   if (cookieStore != nullptr) {
     // Pull saved cookies in before the first page tries to use them
+    StartupTrace::Begin("loadAllCookies");
     cookieStore->loadAllCookies();
+    StartupTrace::End("loadAllCookies");
 
     auto markCookieMutation = [this](const QNetworkCookie &) {
-      // Qt does not expose a real sync flush call here
-      // Track the last write time so shutdown can wait a short drain window
-      m_lastCookieMutationAtMs = QDateTime::currentMSecsSinceEpoch();
+      // Qt does not expose a real sync flush call, so shutdown waits for the store to go quiet instead
+      Metrics::Increment(Metrics::Counter::CookieChanges);
+      // Every write during a shutdown drain pushes the quiet point out again
+      if (m_drainQuietTimer != nullptr && m_drainQuietTimer->isActive()) {
+        m_drainQuietTimer->start();
+      }
     };
 
     QObject::connect(cookieStore, &QWebEngineCookieStore::cookieAdded, m_profile, markCookieMutation);
     QObject::connect(cookieStore, &QWebEngineCookieStore::cookieRemoved, m_profile, markCookieMutation);
   }
 
-  // Only normal app shutdown waits for cookie writes
-  QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, m_profile,
-                   [this]() { FlushPersistentStateSync(); });
+  // Crashed or killed instances leave whole Chromium profiles behind, delete them off the UI thread
+  const QStringList isolatedRoots = {storageRoot, cacheRoot};
+  QTimer::singleShot(kIsolatedCollectDelayMs, m_profile, [isolatedRoots]() {
+    QThread *collectThread = QThread::create([isolatedRoots]() { CollectStaleIsolatedProfiles(isolatedRoots); });
+    QObject::connect(collectThread, &QThread::finished, collectThread, &QObject::deleteLater);
+    // Join before the app tears down, at most the directory being removed is still finished
+    QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, collectThread, [collectThread]() {
+      collectThread->requestInterruption();
+      collectThread->wait();
+    });
+    collectThread->start(QThread::LowestPriority);
+  });
+}
+
+void BrowserProfile::InstallInjectedScripts() {
+  QWebEngineScriptCollection *profileScripts = m_profile->scripts();
+  if (profileScripts == nullptr) {
+    return;
+  }
+
+  QWebEngineScript trustedOriginsScript;
+  trustedOriginsScript.setName(QStringLiteral("chatgpt-desktop-trusted-origins"));
+  trustedOriginsScript.setInjectionPoint(QWebEngineScript::DocumentCreation);
+  trustedOriginsScript.setRunsOnSubFrames(false);
+  trustedOriginsScript.setWorldId(QWebEngineScript::ApplicationWorld);
+  // Load the trust helper first so later scripts can ask one shared source
+  trustedOriginsScript.setSourceCode(ChatInjections::BuildTrustedOriginsScriptSource());
+  profileScripts->insert(trustedOriginsScript);
+
+  QWebEngineScript codeCopyBridgeScript;
+  codeCopyBridgeScript.setName(QStringLiteral("chatgpt-desktop-code-copy-bridge"));
+  codeCopyBridgeScript.setInjectionPoint(QWebEngineScript::DocumentCreation);
+  codeCopyBridgeScript.setRunsOnSubFrames(false);
+  codeCopyBridgeScript.setWorldId(QWebEngineScript::ApplicationWorld);
+  // The bridge prefix is fixed for the process, so the script text is too
+  codeCopyBridgeScript.setSourceCode(ChatInjections::BuildCodeCopyBridgeScriptSource(
+      m_clipboardBridgePrefix, ClipboardChannel::ChannelBaseUrl(m_clipboardBridgePrefix)));
+  profileScripts->insert(codeCopyBridgeScript);
+
+  QWebEngineScript longChatPerfScript;
+  longChatPerfScript.setName(QStringLiteral("chatgpt-desktop-long-chat-perf"));
+  longChatPerfScript.setInjectionPoint(QWebEngineScript::DocumentReady);
+  longChatPerfScript.setRunsOnSubFrames(false);
+  longChatPerfScript.setWorldId(QWebEngineScript::ApplicationWorld);
+  // Wait for the page tree before touching long chat nodes
+  longChatPerfScript.setSourceCode(ChatInjections::BuildLongChatPerformanceScriptSource());
+  profileScripts->insert(longChatPerfScript);
+
+  QWebEngineScript performanceHudScript;
+  performanceHudScript.setName(QStringLiteral("chatgpt-desktop-performance-hud"));
+  performanceHudScript.setInjectionPoint(QWebEngineScript::DocumentCreation);
+  performanceHudScript.setRunsOnSubFrames(false);
+  performanceHudScript.setWorldId(QWebEngineScript::ApplicationWorld);
+  // Early enough to count frames during load, and free until the HUD is shown
+  performanceHudScript.setSourceCode(ChatInjections::BuildPerformanceHudScriptSource());
+  profileScripts->insert(performanceHudScript);
+
+  if (!ConversationSnapshots::IsEnabled()) {
+    return;
+  }
+  QWebEngineScript conversationSnapshotScript;
+  conversationSnapshotScript.setName(QStringLiteral("chatgpt-desktop-conversation-snapshot"));
+  conversationSnapshotScript.setInjectionPoint(QWebEngineScript::DocumentReady);
+  conversationSnapshotScript.setRunsOnSubFrames(false);
+  conversationSnapshotScript.setWorldId(QWebEngineScript::ApplicationWorld);
+  // Captures only run once a long chat settles, the native view drains them later
+  conversationSnapshotScript.setSourceCode(ChatInjections::BuildConversationSnapshotScriptSource());
+  profileScripts->insert(conversationSnapshotScript);
 }
 
 QString BrowserProfile::ResolveStorageRoot() const {
@@ -188,23 +420,112 @@ QString BrowserProfile::ResolveCacheRoot() const {
   return cacheRoot;
 }
 
-void BrowserProfile::FlushPersistentStateSync() {
-  if (m_profile == nullptr) {
+void BrowserProfile::DrainForShutdown(std::function<void()> onDrained) {
+  if (m_profile == nullptr || m_drainFinished) {
+    onDrained();
     return;
   }
+  if (m_drainQuietTimer != nullptr) {
+    // Asking again while a drain runs means quit now
+    FinishShutdownDrain(true);
+    return;
+  }
+  m_onDrained = std::move(onDrained);
+  m_drainStartedAtMs = QDateTime::currentMSecsSinceEpoch();
+
+  // Windows vanish right away, the user should not watch the drain
+  const QWidgetList topLevelWidgets = QApplication::topLevelWidgets();
+  for (QWidget *widget : topLevelWidgets) {
+    widget->hide();
+  }
+  // Hidden pages can be discarded, which stops their renderers and runs unload handlers now
+  for (QWidget *widget : topLevelWidgets) {
+    QList<QWebEngineView *> views = widget->findChildren<QWebEngineView *>();
+    if (auto *topLevelView = qobject_cast<QWebEngineView *>(widget)) {
+      views.append(topLevelView);
+    }
+    for (QWebEngineView *view : std::as_const(views)) {
+      // Restored views that were never seen have no page, asking for one would build it now
+      const ChatView *chatView = dynamic_cast<const ChatView *>(view);
+      if (chatView != nullptr && chatView->IsLoadDeferred()) {
+        continue;
+      }
+      QWebEnginePage *page = view->page();
+      if (page == nullptr || page->lifecycleState() == QWebEnginePage::LifecycleState::Discarded) {
+        continue;
+      }
+      if (page->renderProcessPid() > 0) {
+        // Local and session storage are written by the renderer's teardown, so the drain waits for it to exit
+        ++m_drainPendingRenderers;
+        auto stopped = std::make_shared<bool>(false);
+        auto noteStopped = [this, stopped]() {
+          if (!*stopped) {
+            *stopped = true;
+            NoteDrainRendererStopped();
+          }
+        };
+        QObject::connect(page, &QWebEnginePage::renderProcessPidChanged, m_profile, [noteStopped](qint64 pid) {
+          if (pid == 0) {
+            noteStopped();
+          }
+        });
+        QObject::connect(page, &QWebEnginePage::renderProcessTerminated, m_profile, noteStopped);
+        QObject::connect(page, &QObject::destroyed, m_profile, noteStopped);
+      }
+      page->setLifecycleState(QWebEnginePage::LifecycleState::Discarded);
+      ++m_drainDiscardedPages;
+    }
+  }
 
-  // Chromium writes profile data in the background
-  // Wait a short grace window after the last cookie change instead of faking a flush
-  qint64 waitMs = kMinimumQuitDelayMs;
-  if (m_lastCookieMutationAtMs > 0) {
-    const qint64 elapsedMs = QDateTime::currentMSecsSinceEpoch() - m_lastCookieMutationAtMs;
-    waitMs = std::max<qint64>(waitMs, kCookieDrainWindowMs - elapsedMs);
+  // The cookie quiet window only starts once every renderer is gone, both share one deadline
+  m_drainQuietTimer = new QTimer(m_profile);
+  m_drainQuietTimer->setSingleShot(true);
+  m_drainQuietTimer->setInterval(kShutdownQuietWindowMs);
+  QObject::connect(m_drainQuietTimer, &QTimer::timeout, m_profile, [this]() { FinishShutdownDrain(false); });
+  m_drainDeadlineTimer = new QTimer(m_profile);
+  m_drainDeadlineTimer->setSingleShot(true);
+  m_drainDeadlineTimer->setInterval(kShutdownDeadlineMs);
+  QObject::connect(m_drainDeadlineTimer, &QTimer::timeout, m_profile, [this]() { FinishShutdownDrain(true); });
+  m_drainDeadlineTimer->start();
+  if (m_drainPendingRenderers == 0) {
+    m_drainRenderersStoppedAtMs = QDateTime::currentMSecsSinceEpoch();
+    m_drainQuietTimer->start();
   }
+}
 
-  if (waitMs <= 0) {
+void BrowserProfile::NoteDrainRendererStopped() {
+  if (m_drainFinished || --m_drainPendingRenderers > 0) {
     return;
   }
+  m_drainRenderersStoppedAtMs = QDateTime::currentMSecsSinceEpoch();
+  m_drainQuietTimer->start();
+}
 
-  // Sleep here instead of spinning a nested event loop during shutdown
-  QThread::msleep(static_cast<unsigned long>(waitMs));
+void BrowserProfile::FinishShutdownDrain(bool deadlineHit) {
+  if (m_drainFinished) {
+    return;
+  }
+  m_drainFinished = true;
+  m_drainQuietTimer->stop();
+  m_drainDeadlineTimer->stop();
+  const qint64 finishedAtMs = QDateTime::currentMSecsSinceEpoch();
+  qCInfo(lcPerformance).noquote() << "Shutdown drain took" << finishedAtMs - m_drainStartedAtMs << "ms for"
+                                  << m_drainDiscardedPages << "pages";
+  // Storage is flushed by the renderers, cookies by the browser process, so each wait is reported on its own
+  if (m_drainPendingRenderers > 0) {
+    qCInfo(lcPerformance).noquote() << "  storage:" << m_drainPendingRenderers
+                                    << "renderers still running at the deadline, cookies not waited for";
+  } else {
+    qCInfo(lcPerformance).noquote() << "  storage: renderers stopped after"
+                                    << m_drainRenderersStoppedAtMs - m_drainStartedAtMs << "ms";
+    qCInfo(lcPerformance).noquote() << "  cookies:"
+                                    << (deadlineHit ? QStringLiteral("still changing at the deadline")
+                                                    : QStringLiteral("quiet after %1 ms")
+                                                          .arg(finishedAtMs - m_drainRenderersStoppedAtMs));
+  }
+  const std::function<void()> onDrained = std::move(m_onDrained);
+  m_onDrained = nullptr;
+  if (onDrained) {
+    onDrained();
+  }
 }
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <QString>
+#include <functional>
 #include <memory>
 
 class QLockFile;
+class QTimer;
 class QWebEngineProfile;
 
 class BrowserProfile final {
@@ -13,8 +15,15 @@ public:
 
   QWebEngineProfile *Profile() const;
   const QString &ClipboardBridgePrefix() const;
-  // Give Chromium a short quiet window during app shutdown
-  void FlushPersistentStateSync();
+  // True when this process holds the main profile lock instead of an isolated copy
+  bool OwnsMainProfile() const;
+  // Active storage path, an isolated copy when another process owns the main profile
+  const QString &StoragePath() const;
+  // Every quit goes through here: hide the windows, discard the pages, wait for their renderers to exit and the
+  // cookie store to go quiet, then call back, or sooner once the deadline passes
+  void DrainForShutdown(std::function<void()> onDrained);
+  // Keep cache away from volatile paths when possible, native caches live under it too
+  QString ResolveCacheRoot() const;
 
 private:
   BrowserProfile();
@@ -22,15 +31,27 @@ private:
 
   // Build the shared profile only once per process
   void InitializeProfile();
+  // Every page on the profile gets the same scripts, so register them one time
+  void InstallInjectedScripts();
   // Keep profile storage on disk across restarts
   QString ResolveStorageRoot() const;
-  // Keep cache away from volatile paths when possible
-  QString ResolveCacheRoot() const;
+  // Counts down the discarded pages' renderers, the last one starts the cookie quiet window
+  void NoteDrainRendererStopped();
+  void FinishShutdownDrain(bool deadlineHit);
 
   // QCoreApplication owns the profile through QObject parenting
   QWebEngineProfile *m_profile = nullptr;
   // Lock object must stay alive while this process owns the profile files
   std::unique_ptr<QLockFile> m_profileLock;
   QString m_clipboardBridgePrefix;
-  qint64 m_lastCookieMutationAtMs = 0;
+  QString m_storagePath;
+  // Shutdown drain state, the timers only exist once a drain started
+  QTimer *m_drainQuietTimer = nullptr;
+  QTimer *m_drainDeadlineTimer = nullptr;
+  std::function<void()> m_onDrained;
+  qint64 m_drainStartedAtMs = 0;
+  int m_drainDiscardedPages = 0;
+  int m_drainPendingRenderers = 0;
+  qint64 m_drainRenderersStoppedAtMs = 0;
+  bool m_drainFinished = false;
 };
@@ -4,8 +4,13 @@
 
 namespace ChatInjections {
 
+// Sources come from scripts embedded at build time, so these never touch the disk
 QString BuildTrustedOriginsScriptSource();
-QString BuildCodeCopyBridgeScriptSource(const QString &clipboardBridgePrefix);
+// An empty channel URL leaves the bridge on the prompt path
+QString BuildCodeCopyBridgeScriptSource(const QString &clipboardBridgePrefix, const QString &clipboardChannelUrl);
 QString BuildLongChatPerformanceScriptSource();
+QString BuildConversationSnapshotScriptSource();
+// Idle until the native HUD asks for its first sample
+QString BuildPerformanceHudScriptSource();
 
 } // namespace ChatInjections
@@ -1,31 +1,91 @@
 #include "chatview.h"
 #include "appwindow.h"
 #include "browserprofile.h"
-#include "chatinjections.h"
 #include "chatwebpage.h"
+#include "conversationsnapshots.h"
+#include "conversationsnapshotview.h"
+#include "downloadmanager.h"
+#include "memorygovernor.h"
+#include "metrics.h"
+#include "perflog.h"
+#include "processstats.h"
+#include "sessionstore.h"
+#include "startuptrace.h"
 #include "trustedorigins.h"
+#include <QChildEvent>
+#include <QDateTime>
 #include <QDebug>
-#include <QDir>
-#include <QFileDialog>
-#include <QFileInfo>
+#include <QElapsedTimer>
 #include <QHideEvent>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QResizeEvent>
 #include <QShowEvent>
-#include <QStandardPaths>
 #include <QTimer>
 #include <QUrl>
-#include <QWebEngineDownloadRequest>
+#include <QVariant>
 #include <QWebEnginePage>
 #include <QWebEngineScript>
-#include <QWebEngineScriptCollection>
 #include <QWebEngineSettings>
 #include <QtGlobal>
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <utility>
 
 namespace {
 // Fresh windows start at the normal ChatGPT home page
 QUrl DefaultStartupUrl() { return QUrl(QStringLiteral("https://chatgpt.com")); }
+
+// Paint timing lives in the page timeline, so read it back as wall clock time
+const QString kFirstPaintQuery = QStringLiteral(
+    "(() => {"
+    "  const entry = performance.getEntriesByName('first-paint')[0]"
+    "    || performance.getEntriesByName('first-contentful-paint')[0];"
+    "  return entry ? performance.timeOrigin + entry.startTime : 0;"
+    "})()");
+
+// The long chat script owns the page side of the budget, pages without it just ignore the call
+const QString kRenderBudgetCall = QStringLiteral("globalThis.__chatgptDesktopSetRenderBudget?.('%1')");
+
+// Handover polls the page until its turns stop changing
+constexpr int kSnapshotHandoverPollMs = 100;
+// A live page that never settles still takes over after this long
+constexpr qint64 kSnapshotHandoverTimeoutMs = 20 * 1000;
+// Settled captures wait in the page until the next drain
+constexpr int kSnapshotDrainIntervalMs = 5000;
+// Pages without the snapshot script answer with an empty string or false
+const QString kTakeSnapshotsCall = QStringLiteral("globalThis.__chatgptDesktopTakeConversationSnapshots?.(%1) ?? ''");
+const QString kConversationReadyCall = QStringLiteral("globalThis.__chatgptDesktopConversationReady?.(%1[0]) === true");
+const QString kScrollToTurnCall = QStringLiteral("globalThis.__chatgptDesktopScrollToTurn?.(%1)");
+const QString kTopTurnCall = QStringLiteral("globalThis.__chatgptDesktopTopTurn?.() ?? -1");
+
+QString RenderBudgetName(ChatView::RenderBudget budget) {
+  return budget == ChatView::RenderBudget::Reduced ? QStringLiteral("reduced") : QStringLiteral("full");
+}
 } // namespace
 
-ChatView::ChatView(const QUrl &initialUrl, QWidget *parent) : QWebEngineView(parent) {
+ChatView::ChatView(const QUrl &initialUrl, QWidget *parent)
+    : QWebEngineView(parent), m_lastShownAtMs(QDateTime::currentMSecsSinceEpoch()) {
+  StartupTrace::Scope traceScope("ChatView construction");
+  CreatePage();
+
+  const QUrl startupUrl = initialUrl.isValid() ? initialUrl : DefaultStartupUrl();
+  load(startupUrl);
+  // The saved copy goes up while the network fetch is still in flight
+  ShowConversationSnapshot(startupUrl);
+
+  // Start with one lifecycle pass so hidden startup cases do the right thing
+  SchedulePageLifecycleStateUpdate();
+}
+
+ChatView::ChatView(const SessionTab &restoredTab, QWidget *parent)
+    : QWebEngineView(parent), m_lastShownAtMs(QDateTime::currentMSecsSinceEpoch()), m_windowFocused(false),
+      m_deferredUrl(restoredTab.url.isValid() ? restoredTab.url : DefaultStartupUrl()),
+      m_deferredTitle(restoredTab.title), m_deferredSinceMs(QDateTime::currentMSecsSinceEpoch()),
+      m_scrollAnchorKey(ConversationSnapshots::KeyForUrl(m_deferredUrl)), m_scrollAnchorTurn(restoredTab.scrollTurn) {}
+
+void ChatView::CreatePage() {
   // One shared profile keeps every native window on the same login state
   BrowserProfile &browserProfile = BrowserProfile::Instance();
   m_profile = browserProfile.Profile();
@@ -33,35 +93,24 @@ ChatView::ChatView(const QUrl &initialUrl, QWidget *parent) : QWebEngineView(par
 
   // Each window still owns its own page object
   // That keeps window state separate while storage stays shared
+  // Injected scripts come from the shared profile, so the page needs no script setup
   ChatWebPage *webPage = new ChatWebPage(m_profile, clipboardBridgePrefix, this);
   setPage(webPage);
-
-  QWebEngineScript trustedOriginsScript;
-  trustedOriginsScript.setName(QStringLiteral("chatgpt-desktop-trusted-origins"));
-  trustedOriginsScript.setInjectionPoint(QWebEngineScript::DocumentCreation);
-  trustedOriginsScript.setRunsOnSubFrames(false);
-  trustedOriginsScript.setWorldId(QWebEngineScript::ApplicationWorld);
-  // Load the trust helper first so later scripts can ask one shared source
-  trustedOriginsScript.setSourceCode(ChatInjections::BuildTrustedOriginsScriptSource());
-  webPage->scripts().insert(trustedOriginsScript);
-
-  QWebEngineScript codeCopyBridgeScript;
-  codeCopyBridgeScript.setName(QStringLiteral("chatgpt-desktop-code-copy-bridge"));
-  codeCopyBridgeScript.setInjectionPoint(QWebEngineScript::DocumentCreation);
-  codeCopyBridgeScript.setRunsOnSubFrames(false);
-  codeCopyBridgeScript.setWorldId(QWebEngineScript::ApplicationWorld);
-  // Keep the injected bridge logic in JS files instead of hard coding it here
-  codeCopyBridgeScript.setSourceCode(ChatInjections::BuildCodeCopyBridgeScriptSource(clipboardBridgePrefix));
-  webPage->scripts().insert(codeCopyBridgeScript);
-
-  QWebEngineScript longChatPerfScript;
-  longChatPerfScript.setName(QStringLiteral("chatgpt-desktop-long-chat-perf"));
-  longChatPerfScript.setInjectionPoint(QWebEngineScript::DocumentReady);
-  longChatPerfScript.setRunsOnSubFrames(false);
-  longChatPerfScript.setWorldId(QWebEngineScript::ApplicationWorld);
-  // Wait for the page tree before touching long chat nodes
-  longChatPerfScript.setSourceCode(ChatInjections::BuildLongChatPerformanceScriptSource());
-  webPage->scripts().insert(longChatPerfScript);
+  // Freezes come from here and the memory governor, discards also from the tab budget, so count them once here
+  QObject::connect(webPage, &QWebEnginePage::lifecycleStateChanged, this,
+                   [](QWebEnginePage::LifecycleState state) {
+                     switch (state) {
+                     case QWebEnginePage::LifecycleState::Frozen:
+                       Metrics::Increment(Metrics::Counter::PagesFrozen);
+                       break;
+                     case QWebEnginePage::LifecycleState::Discarded:
+                       Metrics::Increment(Metrics::Counter::PagesDiscarded);
+                       break;
+                     case QWebEnginePage::LifecycleState::Active:
+                       Metrics::Increment(Metrics::Counter::PagesResumed);
+                       break;
+                     }
+                   });
 
   QWebEngineSettings *webSettings = settings();
   auto updateClipboardPermissions = [webSettings](const QUrl &url) {
@@ -90,83 +139,99 @@ ChatView::ChatView(const QUrl &initialUrl, QWidget *parent) : QWebEngineView(par
 #endif
   }
 
-  // Route browser downloads through one native save path
-  QObject::connect(m_profile, &QWebEngineProfile::downloadRequested, this,
-                   [this](QWebEngineDownloadRequest *download) {
-                     // The shared profile reports downloads for every window
-                     // Only the page that started the download should own the dialog
-                     if (download == nullptr || download->page() != page()) {
-                       return;
-                     }
-                     HandleDownloadRequest(download);
-                   });
-
-  load(initialUrl.isValid() ? initialUrl : DefaultStartupUrl());
+  // Downloads from every window share one queue and panel
+  DownloadManager::Instance().Attach(m_profile);
 
-  // Start with one lifecycle pass so hidden startup cases do the right thing
-  SchedulePageLifecycleStateUpdate();
-}
+  QObject::connect(this, &QWebEngineView::loadFinished, this, [this](bool ok) {
+    if (!ok && !m_snapshotKey.isEmpty()) {
+      FinishSnapshotHandover(QStringLiteral("load failed"));
+    }
+    // Reloads and discards can move the page to a new renderer
+    if (page() != nullptr && page()->renderProcessPid() != m_renderBudgetPid) {
+      RestartRenderBudgetSample();
+    }
+    // A new document starts at full budget, so carry a reduced one over
+    if (m_renderBudget == RenderBudget::Reduced) {
+      ApplyRenderBudgetToPage();
+    }
+  });
 
-QString ChatView::DownloadDirectoryPath() const {
-  QString downloadDirectory = QStandardPaths::writableLocation(QStandardPaths::DownloadLocation);
-  if (downloadDirectory.isEmpty()) {
-    // Some setups do not report a download folder through XDG paths
-    downloadDirectory = QDir::homePath() + QDir::separator() + QStringLiteral("Downloads");
+  if (ConversationSnapshots::IsEnabled()) {
+    m_snapshotHandoverTimer = new QTimer(this);
+    m_snapshotHandoverTimer->setInterval(kSnapshotHandoverPollMs);
+    QObject::connect(m_snapshotHandoverTimer, &QTimer::timeout, this, [this]() { PollSnapshotHandover(); });
+    m_snapshotDrainTimer = new QTimer(this);
+    m_snapshotDrainTimer->setInterval(kSnapshotDrainIntervalMs);
+    QObject::connect(m_snapshotDrainTimer, &QTimer::timeout, this, [this]() { DrainConversationSnapshots(false); });
+    m_snapshotDrainTimer->start();
+    // Full loads and in-page route changes both report the new conversation here
+    QObject::connect(this, &QWebEngineView::urlChanged, this,
+                     [this](const QUrl &url) { ShowConversationSnapshot(url); });
   }
-  if (!QDir().mkpath(downloadDirectory)) {
-    qWarning() << "Failed to create download directory:" << downloadDirectory;
-  }
-  return downloadDirectory;
-}
 
-void ChatView::HandleDownloadRequest(QWebEngineDownloadRequest *download) {
-  // Qt can still fire this while a page is shutting down
-  if (download == nullptr) {
-    return;
-  }
+  // The session file follows the conversation this view shows
+  QObject::connect(this, &QWebEngineView::urlChanged, this, [this](const QUrl &url) {
+    // A turn index from the previous conversation means nothing in the next one
+    const QString key = ConversationSnapshots::KeyForUrl(url);
+    if (key != m_scrollAnchorKey) {
+      m_scrollAnchorKey = key;
+      m_scrollAnchorTurn = -1;
+    }
+    SessionStore::Instance().ScheduleSave();
+  });
+  QObject::connect(this, &QWebEngineView::titleChanged, this, []() { SessionStore::Instance().ScheduleSave(); });
 
-  const QString suggestedName =
-      download->downloadFileName().isEmpty() ? QStringLiteral("download") : download->downloadFileName();
-  // Build the first file path from the browser suggestion and native download dir
-  const QString suggestedPath = QDir(DownloadDirectoryPath()).filePath(suggestedName);
+  // Let the process wide governor reclaim this page under memory pressure
+  MemoryGovernor::Instance().Track(this);
+}
 
-  const QString selectedPath = QFileDialog::getSaveFileName(this, tr("Save File"), suggestedPath);
-  if (selectedPath.isEmpty()) {
-    // A closed dialog means the download should stop
-    download->cancel();
-    return;
-  }
+void ChatView::ReportFirstPaint(qint64 requestedAtMs, const QString &label) {
+  // Branch documents arrive after createWindow returns and pooled views start on about:blank
+  // Skip blank loads and time the first real document
+  auto connection = std::make_shared<QMetaObject::Connection>();
+  *connection = QObject::connect(this, &QWebEngineView::loadFinished, this,
+                                 [this, connection, requestedAtMs, label]([[maybe_unused]] bool ok) {
+    if (url().scheme() == QStringLiteral("about")) {
+      return;
+    }
+    QObject::disconnect(*connection);
 
-  QObject::connect(download, &QWebEngineDownloadRequest::stateChanged, this,
-                   [download](QWebEngineDownloadRequest::DownloadState state) {
-                     if (state == QWebEngineDownloadRequest::DownloadInterrupted ||
-                         state == QWebEngineDownloadRequest::DownloadCancelled) {
-                       // Keep a clear log line when the browser stops a download
-                       qWarning() << "Download failed:" << download->url() << "state:" << state
-                                  << "reason:" << download->interruptReasonString();
-                     }
-                   });
+    const qint64 loadFinishedAtMs = QDateTime::currentMSecsSinceEpoch();
+    page()->runJavaScript(kFirstPaintQuery, QWebEngineScript::ApplicationWorld,
+                          [requestedAtMs, label, loadFinishedAtMs](const QVariant &result) {
+                            // Pages without paint timing fall back to the load finish time
+                            const qint64 paintedAtMs = static_cast<qint64>(result.toDouble());
+                            const qint64 reachedAtMs = paintedAtMs > 0 ? paintedAtMs : loadFinishedAtMs;
+                            qCInfo(lcPerformance).noquote() << label << "first paint after"
+                                                            << std::max<qint64>(0, reachedAtMs - requestedAtMs)
+                                                            << "ms";
+                          });
+  });
+}
 
-  const QFileInfo selectedInfo(selectedPath);
-  if (!QDir().mkpath(selectedInfo.absolutePath())) {
-    qWarning() << "Failed to create target directory:" << selectedInfo.absolutePath();
-    download->cancel();
-    return;
-  }
-  if (selectedInfo.fileName().isEmpty()) {
-    qWarning() << "Invalid target filename for download path:" << selectedPath;
-    download->cancel();
-    return;
-  }
-  // Split the chosen path back into the pieces Qt expects
-  download->setDownloadDirectory(selectedInfo.absolutePath());
-  download->setDownloadFileName(selectedInfo.fileName());
-  download->accept();
+void ChatView::OpenPooledUrl(const QUrl &url) {
+  page()->setLifecycleState(QWebEnginePage::LifecycleState::Active);
+  const QUrl targetUrl = url.isValid() ? url : DefaultStartupUrl();
+  load(targetUrl);
+  ShowConversationSnapshot(targetUrl);
+  SchedulePageLifecycleStateUpdate();
 }
 
 QWebEngineView *ChatView::createWindow(QWebEnginePage::WebWindowType type) {
   Q_UNUSED(type);
 
+  const qint64 requestedAtMs = QDateTime::currentMSecsSinceEpoch();
+  // No pooled view here, Chromium adopts the new window's own page and renderer into whatever view is returned
+
+  // Tabbed windows keep branches as new tabs next to the conversation they came from
+  AppWindow *hostWindow = dynamic_cast<AppWindow *>(window());
+  if (hostWindow != nullptr && hostWindow->IsTabbed()) {
+    ChatView *branchView = new ChatView(QUrl(QStringLiteral("about:blank")));
+    hostWindow->AddTab(branchView);
+    branchView->ReportFirstPaint(requestedAtMs, QStringLiteral("Branch tab"));
+    return branchView;
+  }
+
   // Some page actions ask Chromium for a new top level window
   // Keep that inside the app instead of handing it off to the desktop browser
   AppWindow *branchWindow = new AppWindow(QUrl(QStringLiteral("about:blank")));
@@ -177,16 +242,47 @@ QWebEngineView *ChatView::createWindow(QWebEnginePage::WebWindowType type) {
   branchWindow->show();
   branchWindow->raise();
   branchWindow->activateWindow();
+
+  branchWindow->GetChatView()->ReportFirstPaint(requestedAtMs, QStringLiteral("Branch window"));
   return branchWindow->GetChatView();
 }
 
+qint64 ChatView::LastShownAtMs() const { return m_lastShownAtMs; }
+
+bool ChatView::DiscardPage() {
+  if (IsLoadDeferred()) {
+    return false;
+  }
+  // Chromium only discards pages that are out of view
+  QWebEnginePage *currentPage = page();
+  if (currentPage == nullptr || !IsOutOfView()) {
+    return false;
+  }
+  if (currentPage->lifecycleState() == QWebEnginePage::LifecycleState::Discarded) {
+    return false;
+  }
+
+  currentPage->setLifecycleState(QWebEnginePage::LifecycleState::Discarded);
+  return true;
+}
+
 void ChatView::showEvent(QShowEvent *event) {
-  QWebEngineView::showEvent(event);
+  // The base class tells the page it is visible, which would build a default one for a deferred view
+  if (IsLoadDeferred()) {
+    QWidget::showEvent(event);
+  } else {
+    QWebEngineView::showEvent(event);
+  }
+  m_lastShownAtMs = QDateTime::currentMSecsSinceEpoch();
   SchedulePageLifecycleStateUpdate();
 }
 
 void ChatView::hideEvent(QHideEvent *event) {
-  QWebEngineView::hideEvent(event);
+  if (IsLoadDeferred()) {
+    QWidget::hideEvent(event);
+  } else {
+    QWebEngineView::hideEvent(event);
+  }
   SchedulePageLifecycleStateUpdate();
 }
 
@@ -197,6 +293,20 @@ void ChatView::changeEvent(QEvent *event) {
   }
 }
 
+void ChatView::resizeEvent(QResizeEvent *event) {
+  QWebEngineView::resizeEvent(event);
+  if (m_snapshotView != nullptr) {
+    m_snapshotView->setGeometry(rect());
+  }
+}
+
+void ChatView::childEvent(QChildEvent *event) {
+  QWebEngineView::childEvent(event);
+  if (m_snapshotView != nullptr && event->added() && event->child() != m_snapshotView) {
+    m_snapshotView->raise();
+  }
+}
+
 void ChatView::SchedulePageLifecycleStateUpdate() {
   if (m_lifecycleUpdateScheduled) {
     return;
@@ -211,22 +321,92 @@ void ChatView::SchedulePageLifecycleStateUpdate() {
   });
 }
 
+bool ChatView::IsOutOfView() const {
+  if (!isVisible()) {
+    return true;
+  }
+
+  // Minimized windows are also out of view
+  const QWidget *topLevelWindow = window();
+  return topLevelWindow != nullptr && topLevelWindow->isMinimized();
+}
+
+qint64 ChatView::OutOfViewSinceMs() const { return m_outOfViewSinceMs; }
+
+void ChatView::SetWindowFocused(bool focused) {
+  if (m_windowFocused == focused) {
+    return;
+  }
+  m_windowFocused = focused;
+  if (IsLoadDeferred()) {
+    LoadDeferredPageIfSeen();
+    return;
+  }
+  UpdateRenderBudget();
+}
+
+void ChatView::UpdateRenderBudget() {
+  const RenderBudget budget = m_windowFocused ? RenderBudget::Full : RenderBudget::Reduced;
+  if (budget == m_renderBudget) {
+    return;
+  }
+
+  // Log what the state we are leaving cost, the renderer may be shared with other views
+  const qint64 renderProcessPid = page() != nullptr ? page()->renderProcessPid() : 0;
+  const qint64 cpuNowMs = ProcessStats::CpuTimeMs(renderProcessPid);
+  const qint64 elapsedMs = QDateTime::currentMSecsSinceEpoch() - m_renderBudgetSinceMs;
+  if (renderProcessPid == m_renderBudgetPid && m_renderBudgetCpuStartMs >= 0 && cpuNowMs >= 0 && elapsedMs > 0) {
+    const double cpuPercent = 100.0 * static_cast<double>(cpuNowMs - m_renderBudgetCpuStartMs) / elapsedMs;
+    qCInfo(lcPerformance).noquote() << "Render budget" << RenderBudgetName(m_renderBudget) << "->"
+                                    << RenderBudgetName(budget) << "for" << url().toString() << "after"
+                                    << QString::number(elapsedMs / 1000.0, 'f', 1) << "s, renderer"
+                                    << renderProcessPid << "CPU" << QString::number(cpuPercent, 'f', 1) + "%";
+  }
+  m_renderBudget = budget;
+  RestartRenderBudgetSample();
+
+  ApplyRenderBudgetToPage();
+}
+
+void ChatView::RestartRenderBudgetSample() {
+  m_renderBudgetSinceMs = QDateTime::currentMSecsSinceEpoch();
+  m_renderBudgetPid = page() != nullptr ? page()->renderProcessPid() : 0;
+  m_renderBudgetCpuStartMs = ProcessStats::CpuTimeMs(m_renderBudgetPid);
+}
+
+void ChatView::ApplyRenderBudgetToPage() {
+  QWebEnginePage *currentPage = page();
+  // Frozen and discarded pages pick the budget up again on their next load
+  if (currentPage == nullptr || currentPage->lifecycleState() != QWebEnginePage::LifecycleState::Active) {
+    return;
+  }
+  currentPage->runJavaScript(kRenderBudgetCall.arg(RenderBudgetName(m_renderBudget)),
+                             QWebEngineScript::ApplicationWorld);
+}
+
 void ChatView::UpdatePageLifecycleState() {
+  if (IsLoadDeferred()) {
+    LoadDeferredPageIfSeen();
+    return;
+  }
   // Hidden pages do not need to keep repainting and running full speed
   QWebEnginePage *currentPage = page();
   if (currentPage == nullptr) {
     return;
   }
 
-  bool shouldFreeze = !isVisible();
-  QWidget *topLevelWindow = window();
-  if (topLevelWindow != nullptr && topLevelWindow->isMinimized()) {
-    // Minimized windows are also out of view, so freeze them too
-    shouldFreeze = true;
+  const bool shouldFreeze = IsOutOfView();
+  // Remember when the page left view so idle aging can push it further later
+  if (!shouldFreeze) {
+    m_outOfViewSinceMs = 0;
+  } else if (m_outOfViewSinceMs == 0) {
+    m_outOfViewSinceMs = QDateTime::currentMSecsSinceEpoch();
   }
 
   const QWebEnginePage::LifecycleState currentState = currentPage->lifecycleState();
   if (shouldFreeze && currentState == QWebEnginePage::LifecycleState::Active) {
+    // Frozen pages run no script, so take the last captures first
+    DrainConversationSnapshots(true);
     // Move to Frozen only when the page is still active
     currentPage->setLifecycleState(QWebEnginePage::LifecycleState::Frozen);
     return;
@@ -234,6 +414,214 @@ void ChatView::UpdatePageLifecycleState() {
 
   if (!shouldFreeze && currentState != QWebEnginePage::LifecycleState::Active) {
     // Wake the page back up when the window is visible again
+    // Discarded pages reload their last URL on the way back to Active
     currentPage->setLifecycleState(QWebEnginePage::LifecycleState::Active);
+    // A page frozen at one budget may come back in a window with a different focus state
+    ApplyRenderBudgetToPage();
+  }
+}
+
+void ChatView::OpenConversation(const QUrl &url, int turnIndex) {
+  if (IsLoadDeferred()) {
+    // The saved tab is replaced before anything of it was loaded
+    m_deferredUrl = url;
+    m_scrollAnchorKey = ConversationSnapshots::KeyForUrl(url);
+    m_scrollAnchorTurn = turnIndex;
+    LoadDeferredPage();
+    return;
+  }
+  const QString key = ConversationSnapshots::KeyForUrl(url);
+  if (m_snapshotHandoverTimer == nullptr || key.isEmpty()) {
+    load(url);
+    return;
+  }
+  if (!m_snapshotKey.isEmpty() && key != m_snapshotKey) {
+    FinishSnapshotHandover(QStringLiteral("navigated away"));
+  }
+
+  m_pendingScrollTurn = turnIndex;
+  const bool alreadyOpen = key == m_snapshotKey || key == ConversationSnapshots::KeyForUrl(this->url());
+  if (m_snapshotView != nullptr) {
+    m_snapshotView->ScrollToTurn(turnIndex);
+  } else if (!alreadyOpen) {
+    ShowConversationSnapshot(url);
+  }
+  if (m_snapshotKey.isEmpty()) {
+    // No saved copy to show, still wait for the live turns so the page can scroll to the hit
+    m_snapshotKey = key;
+    m_snapshotPath = url.path(QUrl::FullyEncoded);
+    m_snapshotShownAtMs = QDateTime::currentMSecsSinceEpoch();
+    m_snapshotHandoverTimer->start();
+  }
+  if (!alreadyOpen) {
+    load(url);
+  }
+}
+
+bool ChatView::IsLoadDeferred() const { return !m_deferredUrl.isEmpty(); }
+
+void ChatView::LoadDeferredPage() {
+  if (!IsLoadDeferred()) {
+    return;
+  }
+  const QUrl url = std::exchange(m_deferredUrl, QUrl());
+  m_deferredTitle.clear();
+  // The first finished load hands a reduced budget to the page
+  m_renderBudget = m_windowFocused ? RenderBudget::Full : RenderBudget::Reduced;
+  CreatePage();
+  // The view may have been on screen for a while, the new page starts hidden
+  page()->setVisible(isVisible());
+  if (m_scrollAnchorTurn >= 0) {
+    // Same path as a search hit: snapshot first, then the live page scrolled to the turn
+    OpenConversation(url, m_scrollAnchorTurn);
+  } else {
+    load(url);
+    ShowConversationSnapshot(url);
+  }
+  SchedulePageLifecycleStateUpdate();
+  qCInfo(lcPerformance).noquote() << "Restored view for" << url.toString() << "loaded after being deferred for"
+                                  << QDateTime::currentMSecsSinceEpoch() - m_deferredSinceMs << "ms";
+}
+
+void ChatView::LoadDeferredPageIfSeen() {
+  if (IsLoadDeferred() && m_windowFocused && !IsOutOfView()) {
+    LoadDeferredPage();
+  }
+}
+
+QUrl ChatView::DisplayUrl() const { return IsLoadDeferred() ? m_deferredUrl : url(); }
+
+QString ChatView::DisplayTitle() const { return IsLoadDeferred() ? m_deferredTitle : title(); }
+
+SessionTab ChatView::SessionState() const {
+  SessionTab tab;
+  tab.url = DisplayUrl();
+  tab.title = DisplayTitle();
+  tab.scrollTurn = m_scrollAnchorTurn;
+  return tab;
+}
+
+void ChatView::RefreshScrollAnchor() {
+  if (IsLoadDeferred()) {
+    return;
+  }
+  // The saved copy is what the reader sees until the handover
+  if (m_snapshotView != nullptr) {
+    m_scrollAnchorTurn = m_snapshotView->TopTurn();
+    return;
+  }
+  QWebEnginePage *currentPage = page();
+  if (currentPage == nullptr || currentPage->lifecycleState() != QWebEnginePage::LifecycleState::Active) {
+    return;
+  }
+  const QString key = m_scrollAnchorKey;
+  currentPage->runJavaScript(kTopTurnCall, QWebEngineScript::ApplicationWorld, [this, key](const QVariant &result) {
+    const int topTurn = result.isValid() ? result.toInt() : -1;
+    // The answer may arrive after a route change to another conversation
+    if (key == m_scrollAnchorKey && topTurn != m_scrollAnchorTurn) {
+      m_scrollAnchorTurn = topTurn;
+      SessionStore::Instance().ScheduleSave();
+    }
+  });
+}
+
+void ChatView::ShowConversationSnapshot(const QUrl &url) {
+  if (m_snapshotHandoverTimer == nullptr) {
+    return;
+  }
+  const QString key = ConversationSnapshots::KeyForUrl(url);
+  if (!m_snapshotKey.isEmpty()) {
+    if (key == m_snapshotKey) {
+      return;
+    }
+    FinishSnapshotHandover(QStringLiteral("navigated away"));
+  }
+  if (key.isEmpty()) {
+    return;
+  }
+
+  QElapsedTimer readableTimer;
+  readableTimer.start();
+  const std::optional<ConversationSnapshot> snapshot = ConversationSnapshots::Instance().Load(key);
+  if (!snapshot.has_value()) {
+    return;
+  }
+  m_snapshotView = new ConversationSnapshotView(*snapshot, this);
+  if (m_pendingScrollTurn >= 0) {
+    m_snapshotView->ScrollToTurn(m_pendingScrollTurn);
+  }
+  m_snapshotView->setGeometry(rect());
+  m_snapshotView->show();
+  m_snapshotView->raise();
+  m_snapshotKey = key;
+  m_snapshotPath = url.path(QUrl::FullyEncoded);
+  m_snapshotShownAtMs = QDateTime::currentMSecsSinceEpoch();
+  m_snapshotHandoverTimer->start();
+  qCInfo(lcPerformance).noquote() << "Conversation snapshot for" << key << "with" << snapshot->turns.size()
+                                  << "turns readable in" << readableTimer.elapsed() << "ms";
+}
+
+void ChatView::PollSnapshotHandover() {
+  if (m_snapshotKey.isEmpty()) {
+    m_snapshotHandoverTimer->stop();
+    return;
+  }
+  if (QDateTime::currentMSecsSinceEpoch() - m_snapshotShownAtMs > kSnapshotHandoverTimeoutMs) {
+    FinishSnapshotHandover(QStringLiteral("timed out"));
+    return;
+  }
+
+  QWebEnginePage *currentPage = page();
+  if (currentPage == nullptr || currentPage->lifecycleState() != QWebEnginePage::LifecycleState::Active) {
+    return;
+  }
+  // A one element JSON array quotes the path safely for the script call
+  const QString pathArgument =
+      QString::fromUtf8(QJsonDocument(QJsonArray{m_snapshotPath}).toJson(QJsonDocument::Compact));
+  const QString key = m_snapshotKey;
+  currentPage->runJavaScript(kConversationReadyCall.arg(pathArgument), QWebEngineScript::ApplicationWorld,
+                             [this, key](const QVariant &result) {
+                               // Several polls can be in flight, only the first ready answer hands over
+                               if (key != m_snapshotKey || !result.toBool()) {
+                                 return;
+                               }
+                               // Open the live page on the turn the reader was looking at
+                               const int scrollTurn =
+                                   m_snapshotView != nullptr ? m_snapshotView->TopTurn() : m_pendingScrollTurn;
+                               if (scrollTurn >= 0) {
+                                 page()->runJavaScript(kScrollToTurnCall.arg(scrollTurn),
+                                                       QWebEngineScript::ApplicationWorld);
+                               }
+                               FinishSnapshotHandover(QStringLiteral("live page ready"));
+                             });
+}
+
+void ChatView::FinishSnapshotHandover(const QString &outcome) {
+  m_snapshotHandoverTimer->stop();
+  m_pendingScrollTurn = -1;
+  if (m_snapshotView != nullptr) {
+    const bool snapshotHadFocus = m_snapshotView->hasFocus();
+    m_snapshotView->hide();
+    m_snapshotView->deleteLater();
+    m_snapshotView = nullptr;
+    if (snapshotHadFocus) {
+      setFocus();
+    }
+    qCInfo(lcPerformance).noquote() << "Conversation snapshot for" << m_snapshotKey << "handed over after"
+                                    << QDateTime::currentMSecsSinceEpoch() - m_snapshotShownAtMs << "ms:" << outcome;
+  }
+  m_snapshotKey.clear();
+  m_snapshotPath.clear();
+}
+
+void ChatView::DrainConversationSnapshots(bool flush) {
+  QWebEnginePage *currentPage = page();
+  if (m_snapshotDrainTimer == nullptr || currentPage == nullptr ||
+      currentPage->lifecycleState() != QWebEnginePage::LifecycleState::Active) {
+    return;
   }
+  currentPage->runJavaScript(kTakeSnapshotsCall.arg(flush ? QStringLiteral("true") : QStringLiteral("false")),
+                             QWebEngineScript::ApplicationWorld, [](const QVariant &result) {
+                               ConversationSnapshots::Instance().StoreFromPage(result.toString());
+                             });
 }
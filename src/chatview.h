@@ -4,34 +4,106 @@
 #include <QWebEngineView>
 #include <QWebEngineProfile>
 
-class QWebEngineDownloadRequest;
+class ConversationSnapshotView;
+class QChildEvent;
 class QEvent;
 class QHideEvent;
+class QResizeEvent;
 class QShowEvent;
+class QTimer;
+struct SessionTab;
 
 class ChatView : public QWebEngineView {
 public:
+  // Visible windows without focus still paint, but at a lower budget
+  enum class RenderBudget { Full, Reduced };
+
   explicit ChatView(const QUrl &initialUrl = QUrl(), QWidget *parent = nullptr);
+  // Restored views hold only the saved tab until they are seen in a focused window, no page or renderer before that
+  explicit ChatView(const SessionTab &restoredTab, QWidget *parent = nullptr);
   ~ChatView() override = default;
 
+  // Log how long a new view took from request to its first painted frame
+  void ReportFirstPaint(qint64 requestedAtMs, const QString &label);
+  // A pooled view sits frozen on about:blank, this wakes it and loads the URL in the renderer it already has
+  void OpenPooledUrl(const QUrl &url);
+  // Least recently shown views are the first to give up their renderer
+  qint64 LastShownAtMs() const;
+  // Drop the renderer of a hidden page, the next show reloads it transparently
+  bool DiscardPage();
+  // Hidden views and views in minimized windows cannot be seen by the user
+  bool IsOutOfView() const;
+  // Zero while the view is on screen
+  qint64 OutOfViewSinceMs() const;
+  // Windows pass activation changes down so unfocused pages can slow down
+  void SetWindowFocused(bool focused);
+  // Open a conversation at one turn, used by search hits
+  void OpenConversation(const QUrl &url, int turnIndex);
+  // QWebEngineView::page() would build a page on the default profile, callers check this first
+  bool IsLoadDeferred() const;
+  // Build the page and open the saved tab at its saved turn, nothing happens once loaded
+  void LoadDeferredPage();
+  // Saved values while the load is deferred, the page's own afterwards
+  QUrl DisplayUrl() const;
+  QString DisplayTitle() const;
+  SessionTab SessionState() const;
+  // Read the first turn on screen back from the page, a change schedules a session save
+  void RefreshScrollAnchor();
+
 protected:
   // Open site requested windows inside another native app window
   QWebEngineView *createWindow(QWebEnginePage::WebWindowType type) override;
   void showEvent(QShowEvent *event) override;
   void hideEvent(QHideEvent *event) override;
   void changeEvent(QEvent *event) override;
+  void resizeEvent(QResizeEvent *event) override;
+  // The page's render widget arrives after the snapshot view, keep the snapshot on top
+  void childEvent(QChildEvent *event) override;
 
 private:
+  // Page, settings and page driven timers, built in the constructor or on the first deferred load
+  void CreatePage();
+  // Deferred views load once they are on screen in a focused window
+  void LoadDeferredPageIfSeen();
   // Coalesce repeated window events into one lifecycle update
   void SchedulePageLifecycleStateUpdate();
   // Freeze the page only when the window is hidden or minimized
   void UpdatePageLifecycleState();
-  // Keep downloads in a native save dialog
-  void HandleDownloadRequest(QWebEngineDownloadRequest *download);
-  // Pick a stable download folder before the save dialog opens
-  QString DownloadDirectoryPath() const;
+  // Pick the budget for the current focus state and hand it to the page scripts
+  void UpdateRenderBudget();
+  void ApplyRenderBudgetToPage();
+  void RestartRenderBudgetSample();
+  // Cover the page with its saved copy until the live conversation has rendered
+  void ShowConversationSnapshot(const QUrl &url);
+  void PollSnapshotHandover();
+  void FinishSnapshotHandover(const QString &outcome);
+  // Move settled page captures into the snapshot log, a flush also takes unsettled changes
+  void DrainConversationSnapshots(bool flush);
 
   // Shared profile is owned by the app level profile manager
   QWebEngineProfile *m_profile = nullptr;
   bool m_lifecycleUpdateScheduled = false;
+  qint64 m_lastShownAtMs = 0;
+  qint64 m_outOfViewSinceMs = 0;
+  bool m_windowFocused = true;
+  RenderBudget m_renderBudget = RenderBudget::Full;
+  // Renderer CPU is sampled at each budget change to report cost per state
+  qint64 m_renderBudgetSinceMs = 0;
+  qint64 m_renderBudgetPid = 0;
+  qint64 m_renderBudgetCpuStartMs = -1;
+  ConversationSnapshotView *m_snapshotView = nullptr;
+  QString m_snapshotKey;
+  QString m_snapshotPath;
+  qint64 m_snapshotShownAtMs = 0;
+  // Turn a search hit asked for, applied to the snapshot and then to the live page
+  int m_pendingScrollTurn = -1;
+  QTimer *m_snapshotHandoverTimer = nullptr;
+  QTimer *m_snapshotDrainTimer = nullptr;
+  // Set only while the load is deferred
+  QUrl m_deferredUrl;
+  QString m_deferredTitle;
+  qint64 m_deferredSinceMs = 0;
+  // Saved scroll position and the conversation it belongs to
+  QString m_scrollAnchorKey;
+  int m_scrollAnchorTurn = -1;
 };
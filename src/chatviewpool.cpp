@@ -0,0 +1,99 @@
+#include "chatviewpool.h"
+#include "chatview.h"
+#include "perflog.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QTimer>
+#include <QUrl>
+#include <algorithm>
+#include <utility>
+
+namespace {
+// One warm view covers the usual single new tab or window without holding much memory
+constexpr int kDefaultPoolSize = 1;
+constexpr int kMaxPoolSize = 4;
+// Wait for the app to settle so pool setup does not compete with real page work
+constexpr int kRefillDelayMs = 2000;
+
+int ResolvePoolSize() {
+  bool parsed = false;
+  const int configuredSize = qEnvironmentVariableIntValue("CHATGPT_DESKTOP_VIEW_POOL_SIZE", &parsed);
+  if (!parsed) {
+    return kDefaultPoolSize;
+  }
+  // Zero turns the pool off for memory tight machines
+  return std::clamp(configuredSize, 0, kMaxPoolSize);
+}
+} // namespace
+
+ChatViewPool &ChatViewPool::Instance() {
+  // Function static keeps one pool for the whole process
+  static ChatViewPool instance;
+  return instance;
+}
+
+ChatViewPool::ChatViewPool() : m_targetSize(ResolvePoolSize()) {
+  m_refillTimer = new QTimer(QCoreApplication::instance());
+  m_refillTimer->setSingleShot(true);
+  m_refillTimer->setInterval(kRefillDelayMs);
+  QObject::connect(m_refillTimer, &QTimer::timeout, m_refillTimer, [this]() { RefillOne(); });
+
+  // Pooled views have no parent window, so shutdown has to delete them by hand
+  QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, m_refillTimer, [this]() {
+    m_refillTimer->stop();
+    Clear();
+    qCInfo(lcPerformance) << "View pool totals: hits" << m_hits << "misses" << m_misses;
+  });
+}
+
+ChatView *ChatViewPool::Open(const QUrl &url) {
+  const qint64 requestedAtMs = QDateTime::currentMSecsSinceEpoch();
+  ChatView *view = nullptr;
+  while (view == nullptr && !m_views.isEmpty()) {
+    view = m_views.takeLast().data();
+  }
+
+  const bool poolHit = view != nullptr;
+  if (poolHit) {
+    ++m_hits;
+    view->OpenPooledUrl(url);
+  } else {
+    ++m_misses;
+    view = new ChatView(url);
+  }
+  view->ReportFirstPaint(requestedAtMs, poolHit ? QStringLiteral("Pooled view") : QStringLiteral("New view"));
+  qCInfo(lcPerformance) << "View pool" << (poolHit ? "hit" : "miss") << ", hits" << m_hits << "misses" << m_misses;
+  ScheduleRefill();
+  return view;
+}
+
+void ChatViewPool::ScheduleRefill() {
+  if (m_views.size() >= m_targetSize) {
+    return;
+  }
+  // Restart the delay so bursts of window opens refill once things calm down
+  m_refillTimer->start();
+}
+
+void ChatViewPool::RefillOne() {
+  if (m_views.size() >= m_targetSize) {
+    return;
+  }
+
+  // about:blank keeps the renderer and injected scripts ready without real page work
+  // Hidden views drop to Frozen through the normal lifecycle pass
+  ChatView *view = new ChatView(QUrl(QStringLiteral("about:blank")));
+  m_views.append(view);
+
+  if (m_views.size() < m_targetSize) {
+    m_refillTimer->start();
+  }
+}
+
+void ChatViewPool::Clear() {
+  for (const QPointer<ChatView> &view : std::as_const(m_views)) {
+    delete view.data();
+  }
+  m_views.clear();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QList>
+#include <QPointer>
+#include <QtGlobal>
+
+class ChatView;
+class QTimer;
+class QUrl;
+
+class ChatViewPool final {
+public:
+  // Share one small pool of warm views across every window
+  static ChatViewPool &Instance();
+
+  // Views the app opens on a URL of its own, a warm one keeps its renderer for that load
+  // Site opened windows do not come here, Chromium swaps its own page and renderer into those
+  ChatView *Open(const QUrl &url);
+  // Top the pool back up after a quiet delay instead of during a window open
+  void ScheduleRefill();
+
+private:
+  ChatViewPool();
+  ~ChatViewPool() = default;
+
+  // Build one view per idle tick so refills never stall input
+  void RefillOne();
+  // Pages must go before the shared profile during app shutdown
+  void Clear();
+
+  QList<QPointer<ChatView>> m_views;
+  QTimer *m_refillTimer = nullptr;
+  int m_targetSize = 0;
+  int m_hits = 0;
+  int m_misses = 0;
+};
@@ -1,17 +1,15 @@
 #include "chatwebpage.h"
+#include "clipboardchannel.h"
+#include "metrics.h"
 #include "trustedorigins.h"
+#include "uploadimages.h"
 
 #include <QByteArray>
-#include <QClipboard>
-#include <QCoreApplication>
 #include <QDesktopServices>
-#include <QGuiApplication>
-#include <QMetaObject>
-#include <QTimer>
 #include <QUrl>
 
 namespace {
-// Hard cap keeps clipboard payloads at a safe size
+// Hard cap keeps prompt payloads at a safe size, large copies use the streaming channel
 constexpr qsizetype kMaxClipboardBytes = 8 * 1024 * 1024;
 constexpr qsizetype kMaxClipboardEncodedChars = ((kMaxClipboardBytes + 2) / 3) * 4;
 // Fallback prefix is used only if setup fails
@@ -63,6 +61,7 @@ bool ChatWebPage::javaScriptPrompt(const QUrl &securityOrigin, const QString &ms
     if (result != nullptr) {
       *result = QStringLiteral("rejected");
     }
+    Metrics::Increment(Metrics::Counter::ClipboardPromptRejected);
     return true;
   }
 
@@ -71,12 +70,14 @@ bool ChatWebPage::javaScriptPrompt(const QUrl &securityOrigin, const QString &ms
     if (result != nullptr) {
       *result = QStringLiteral("empty");
     }
+    Metrics::Increment(Metrics::Counter::ClipboardPromptRejected);
     return true;
   }
   if (encodedText.size() > kMaxClipboardEncodedChars) {
     if (result != nullptr) {
       *result = QStringLiteral("too-large");
     }
+    Metrics::Increment(Metrics::Counter::ClipboardPromptRejected);
     return true;
   }
 
@@ -87,6 +88,7 @@ bool ChatWebPage::javaScriptPrompt(const QUrl &securityOrigin, const QString &ms
     if (result != nullptr) {
       *result = QStringLiteral("invalid");
     }
+    Metrics::Increment(Metrics::Counter::ClipboardPromptRejected);
     return true;
   }
 
@@ -96,54 +98,32 @@ bool ChatWebPage::javaScriptPrompt(const QUrl &securityOrigin, const QString &ms
     if (result != nullptr) {
       *result = QStringLiteral("empty-text");
     }
+    Metrics::Increment(Metrics::Counter::ClipboardPromptRejected);
     return true;
   }
 
-  CommitClipboardText(text);
+  // The decoded bytes are already UTF-8, hand them over without another conversion
+  ClipboardChannel::CommitClipboardBytes(decodedPayload);
+  Metrics::Increment(Metrics::Counter::ClipboardPromptCopies);
+  Metrics::Observe(Metrics::Histogram::ClipboardPayloadBytes, static_cast<quint64>(decodedPayload.size()));
   if (result != nullptr) {
     *result = QStringLiteral("ok");
   }
   return true;
 }
 
+QStringList ChatWebPage::chooseFiles(FileSelectionMode mode, const QStringList &oldFiles,
+                                     const QStringList &acceptedMimeTypes) {
+  const QStringList files = QWebEnginePage::chooseFiles(mode, oldFiles, acceptedMimeTypes);
+  // Folder uploads and other sites get exactly what the user picked
+  if (!UploadImages::IsEnabled() || (mode != FileSelectOpen && mode != FileSelectOpenMultiple) ||
+      !TrustedOrigins::IsTrustedHttpsUrl(url())) {
+    return files;
+  }
+  return UploadImages::Prepare(files);
+}
+
 bool ChatWebPage::IsTrustedClipboardOrigin(const QUrl &origin) const {
   // Native side uses the same small trust helper the view settings use
   return TrustedOrigins::IsTrustedClipboardOrigin(origin, url());
 }
-
-void ChatWebPage::CommitClipboardText(const QString &text) {
-  if (text.trimmed().isEmpty()) {
-    return;
-  }
-
-  QCoreApplication *application = QGuiApplication::instance();
-  if (application == nullptr) {
-    return;
-  }
-
-  // Queue into the GUI loop for clipboard safety
-  QMetaObject::invokeMethod(
-      application,
-      [clipboardText = text]() {
-        QClipboard *clipboard = QGuiApplication::clipboard();
-        if (clipboard == nullptr) {
-          return;
-        }
-
-        // Standard clipboard target
-        clipboard->setText(clipboardText, QClipboard::Clipboard);
-        // Selection target for middle-click paste on Linux
-        clipboard->setText(clipboardText, QClipboard::Selection);
-
-        // Retry once in case another write races this one
-        QTimer::singleShot(150, QGuiApplication::instance(), [clipboardText]() {
-          QClipboard *retryClipboard = QGuiApplication::clipboard();
-          if (retryClipboard == nullptr) {
-            return;
-          }
-          retryClipboard->setText(clipboardText, QClipboard::Clipboard);
-          retryClipboard->setText(clipboardText, QClipboard::Selection);
-        });
-      },
-      Qt::QueuedConnection);
-}
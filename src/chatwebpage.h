@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QString>
+#include <QStringList>
 #include <QUrl>
 #include <QWebEnginePage>
 
@@ -16,12 +17,13 @@ protected:
   bool acceptNavigationRequest(const QUrl &url, NavigationType type, bool isMainFrame) override;
   bool javaScriptPrompt(const QUrl &securityOrigin, const QString &msg, const QString &defaultValue,
                         QString *result) override;
+  // Large images picked for upload are downscaled locally first when an upload edge is configured
+  QStringList chooseFiles(FileSelectionMode mode, const QStringList &oldFiles,
+                          const QStringList &acceptedMimeTypes) override;
 
 private:
   // Validate prompt sender before accepting clipboard payloads
   bool IsTrustedClipboardOrigin(const QUrl &origin) const;
-  // Commit decoded text to native clipboard targets
-  void CommitClipboardText(const QString &text);
 
   // Runtime bridge prefix blocks forged prompt payloads from arbitrary page scripts
   QString m_clipboardBridgePrefix;
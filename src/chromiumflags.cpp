@@ -0,0 +1,189 @@
+#include "chromiumflags.h"
+#include "perflog.h"
+
+#include <QByteArray>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QThread>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+constexpr auto kPresetFlagPrefix = "--performance-preset=";
+constexpr auto kSoftwareRenderingPreset = "software-rendering";
+constexpr auto kDefaultPreset = "balanced";
+
+struct Preset {
+  const char *name;
+  // 0 keeps Chromium's own limit, which grows with installed memory
+  int rendererProcessLimit;
+  // 0 keeps V8's default old space size
+  int v8HeapMb;
+  // 0 sizes the raster pool from the CPU count, CPU raster is where software rendering spends its time
+  int rasterThreads;
+  bool throttleBackgroundTimers;
+  bool lowEndDevice;
+};
+
+// "off" leaves Chromium alone so runs can be compared against its defaults
+const Preset kPresets[] = {
+    {"off", 0, 0, -1, true, false},
+    {"low-memory", 2, 512, 1, true, true},
+    {"balanced", 4, 2048, 2, true, false},
+    {"throughput", 0, 4096, 4, false, false},
+    {kSoftwareRenderingPreset, 3, 1024, 0, true, false},
+};
+
+QString g_activePreset;
+
+const Preset *FindPreset(const QString &name) {
+  for (const Preset &preset : kPresets) {
+    if (name == QLatin1String(preset.name)) {
+      return &preset;
+    }
+  }
+  return nullptr;
+}
+
+QStringList PresetNames() {
+  QStringList names;
+  for (const Preset &preset : kPresets) {
+    names.append(QString::fromLatin1(preset.name));
+  }
+  return names;
+}
+
+QString ConfigFilePath() {
+  QString configRoot = qEnvironmentVariable("XDG_CONFIG_HOME");
+  if (configRoot.isEmpty()) {
+    configRoot = QDir::home().filePath(QStringLiteral(".config"));
+  }
+  return QDir(configRoot).filePath(QStringLiteral("chatgpt-desktop-unix/performance.conf"));
+}
+
+// One key=value per line, only preset is read for now and # starts a comment
+QString ReadConfiguredPreset() {
+  QFile configFile(ConfigFilePath());
+  if (!configFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    return QString();
+  }
+  QString preset;
+  while (!configFile.atEnd()) {
+    const QString line = QString::fromUtf8(configFile.readLine()).section(QLatin1Char('#'), 0, 0).trimmed();
+    if (line.section(QLatin1Char('='), 0, 0).trimmed() == QStringLiteral("preset")) {
+      preset = line.section(QLatin1Char('='), 1).trimmed();
+    }
+  }
+  return preset;
+}
+
+QString SwitchName(const QString &flag) { return flag.section(QLatin1Char('='), 0, 0); }
+
+QStringList BuildPresetFlags(const Preset &preset, bool softwareRendering) {
+  QStringList flags;
+  if (std::strcmp(preset.name, "off") == 0) {
+    return flags;
+  }
+  if (preset.rendererProcessLimit > 0) {
+    flags.append(QStringLiteral("--renderer-process-limit=%1").arg(preset.rendererProcessLimit));
+  }
+  if (preset.v8HeapMb > 0) {
+    flags.append(QStringLiteral("--js-flags=--max-old-space-size=%1").arg(preset.v8HeapMb));
+  }
+  const int rasterThreads =
+      preset.rasterThreads > 0 ? preset.rasterThreads : std::clamp(QThread::idealThreadCount() / 2, 2, 4);
+  flags.append(QStringLiteral("--num-raster-threads=%1").arg(rasterThreads));
+  if (!preset.throttleBackgroundTimers) {
+    flags.append(QStringLiteral("--disable-background-timer-throttling"));
+    flags.append(QStringLiteral("--disable-renderer-backgrounding"));
+  }
+  if (preset.lowEndDevice) {
+    flags.append(QStringLiteral("--enable-low-end-device-mode"));
+  }
+  // Probing for a GPU that is not there costs startup time and can leave compositing on a slow fallback
+  if (softwareRendering) {
+    flags.append(QStringLiteral("--disable-gpu"));
+    flags.append(QStringLiteral("--disable-gpu-compositing"));
+  }
+  return flags;
+}
+} // namespace
+
+namespace ChromiumFlags {
+
+void Apply(int argc, char *argv[]) {
+  // The CLI flag wins over the environment, which wins over the config file
+  QString requestedPreset;
+  QString source;
+  const size_t flagLength = std::strlen(kPresetFlagPrefix);
+  for (int index = 1; index < argc; ++index) {
+    if (std::strncmp(argv[index], kPresetFlagPrefix, flagLength) == 0) {
+      requestedPreset = QString::fromLocal8Bit(argv[index] + flagLength).trimmed();
+      source = QStringLiteral("command line");
+    }
+  }
+  if (requestedPreset.isEmpty()) {
+    requestedPreset = qEnvironmentVariable("CHATGPT_DESKTOP_PERFORMANCE_PRESET").trimmed();
+    source = QStringLiteral("environment");
+  }
+  if (requestedPreset.isEmpty()) {
+    requestedPreset = ReadConfiguredPreset();
+    source = ConfigFilePath();
+  }
+
+  const bool softwareRendering = IsSoftwareRendering();
+  const Preset *preset = requestedPreset.isEmpty() ? nullptr : FindPreset(requestedPreset.toLower());
+  if (!requestedPreset.isEmpty() && preset == nullptr) {
+    qWarning().noquote() << "Unknown performance preset" << requestedPreset << "from" << source
+                         << "- expected one of" << PresetNames().join(QStringLiteral(", "));
+  }
+  if (preset == nullptr) {
+    preset = FindPreset(QString::fromLatin1(softwareRendering ? kSoftwareRenderingPreset : kDefaultPreset));
+    source = softwareRendering ? QStringLiteral("software rendering detected") : QStringLiteral("default");
+  }
+  g_activePreset = QString::fromLatin1(preset->name);
+
+  // Switches the user already passed keep their value, the preset only fills in the rest
+  const QStringList userFlags =
+      qEnvironmentVariable("QTWEBENGINE_CHROMIUM_FLAGS").split(QLatin1Char(' '), Qt::SkipEmptyParts);
+  QStringList userSwitches;
+  for (const QString &flag : userFlags) {
+    userSwitches.append(SwitchName(flag));
+  }
+  QStringList mergedFlags;
+  for (const QString &flag : BuildPresetFlags(*preset, softwareRendering)) {
+    if (!userSwitches.contains(SwitchName(flag))) {
+      mergedFlags.append(flag);
+    }
+  }
+  mergedFlags.append(userFlags);
+  qputenv("QTWEBENGINE_CHROMIUM_FLAGS", mergedFlags.join(QLatin1Char(' ')).toLocal8Bit());
+
+  qCInfo(lcPerformance).noquote() << "Performance preset" << g_activePreset << "(" + source + "):"
+                                  << mergedFlags.join(QLatin1Char(' '));
+}
+
+QString ActivePreset() { return g_activePreset; }
+
+bool IsSoftwareRendering() {
+  if (qEnvironmentVariable("LIBGL_ALWAYS_SOFTWARE") == QStringLiteral("1")) {
+    return true;
+  }
+  // Headless platforms never hand Chromium a GPU surface
+  const QString platform = qEnvironmentVariable("QT_QPA_PLATFORM").section(QLatin1Char(':'), 0, 0);
+  if (platform == QStringLiteral("offscreen") || platform == QStringLiteral("minimal") ||
+      platform == QStringLiteral("vnc")) {
+    return true;
+  }
+  const QStringList userFlags =
+      qEnvironmentVariable("QTWEBENGINE_CHROMIUM_FLAGS").split(QLatin1Char(' '), Qt::SkipEmptyParts);
+  if (userFlags.contains(QStringLiteral("--disable-gpu"))) {
+    return true;
+  }
+  // Without a DRM render node Chromium ends up on SwiftShader or plain CPU raster
+  return QDir(QStringLiteral("/dev/dri")).entryList({QStringLiteral("renderD*")}, QDir::System).isEmpty();
+}
+
+} // namespace ChromiumFlags
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <QString>
+
+namespace ChromiumFlags {
+
+// Pick a preset from --performance-preset=<name>, CHATGPT_DESKTOP_PERFORMANCE_PRESET, the config file,
+// or the rendering path, then fold its switches into QTWEBENGINE_CHROMIUM_FLAGS before QApplication exists
+void Apply(int argc, char *argv[]);
+// Name of the preset Apply chose, empty before it ran
+QString ActivePreset();
+// Chromium has no GPU to work with, because the host has no render node or the caller turned it off
+bool IsSoftwareRendering();
+
+} // namespace ChromiumFlags
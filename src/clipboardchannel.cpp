@@ -0,0 +1,258 @@
+#include "clipboardchannel.h"
+#include "metrics.h"
+#include "trustedorigins.h"
+
+#include <QBuffer>
+#include <QClipboard>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QGuiApplication>
+#include <QHash>
+#include <QIODevice>
+#include <QMetaObject>
+#include <QMimeData>
+#include <QStringList>
+#include <QTimer>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QWebEngineProfile>
+#include <QWebEngineUrlRequestJob>
+#include <QWebEngineUrlScheme>
+#include <QWebEngineUrlSchemeHandler>
+#include <algorithm>
+#include <utility>
+
+namespace {
+constexpr auto kSchemeName = "chatgpt-desktop-bridge";
+constexpr auto kClipboardHost = "clipboard";
+// Large enough for any real code block, small enough that a runaway page cannot eat all memory
+constexpr qsizetype kMaxTransferBytes = 256 * 1024 * 1024;
+// Uploads are sequential per copy, a few open ones covers quick repeat clicks
+constexpr int kMaxOpenTransfers = 4;
+// Transfers that stop half way are dropped after this long
+constexpr qint64 kStaleTransferMs = 30 * 1000;
+constexpr qint64 kBodyReadStepBytes = 64 * 1024;
+constexpr int kClipboardRetryDelayMs = 150;
+
+bool ContainsVisibleText(const QByteArray &utf8Text) {
+  // Any byte above ASCII space is visible text or part of a multibyte character
+  return std::any_of(utf8Text.cbegin(), utf8Text.cend(),
+                     [](char byte) { return static_cast<unsigned char>(byte) > 0x20; });
+}
+
+QMimeData *BuildTextMimeData(const QByteArray &utf8Text) {
+  // QByteArray is implicitly shared, so both formats point at the same bytes
+  auto *mimeData = new QMimeData();
+  mimeData->setData(QStringLiteral("text/plain;charset=utf-8"), utf8Text);
+  mimeData->setData(QStringLiteral("text/plain"), utf8Text);
+  return mimeData;
+}
+
+void ApplyClipboardBytes(const QByteArray &utf8Text) {
+  QClipboard *clipboard = QGuiApplication::clipboard();
+  if (clipboard == nullptr) {
+    return;
+  }
+
+  // Standard clipboard target
+  clipboard->setMimeData(BuildTextMimeData(utf8Text), QClipboard::Clipboard);
+  // Selection target for middle-click paste on Linux
+  if (clipboard->supportsSelection()) {
+    clipboard->setMimeData(BuildTextMimeData(utf8Text), QClipboard::Selection);
+  }
+}
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+void ReplyOk(QWebEngineUrlRequestJob *job) {
+  // The job owns the reply buffer and frees it once Chromium has read it
+  auto *replyBody = new QBuffer(job);
+  replyBody->setData(QByteArrayLiteral("ok"));
+  replyBody->open(QIODevice::ReadOnly);
+  job->reply(QByteArrayLiteral("text/plain"), replyBody);
+}
+
+// Every refused chunk counts, a burst of these points at a page misusing the channel
+void Deny(QWebEngineUrlRequestJob *job) {
+  Metrics::Increment(Metrics::Counter::ClipboardChannelRejected);
+  job->fail(QWebEngineUrlRequestJob::RequestDenied);
+}
+
+class ClipboardSchemeHandler final : public QWebEngineUrlSchemeHandler {
+public:
+  ClipboardSchemeHandler(const QString &bridgeToken, QObject *parent)
+      : QWebEngineUrlSchemeHandler(parent), m_bridgeToken(bridgeToken) {}
+
+  void requestStarted(QWebEngineUrlRequestJob *job) override {
+    const QUrl requestUrl = job->requestUrl();
+    // Only posts from trusted pages may touch the clipboard
+    if (job->requestMethod() != QByteArrayLiteral("POST") ||
+        requestUrl.host() != QLatin1String(kClipboardHost) ||
+        !TrustedOrigins::IsTrustedClipboardOrigin(job->initiator(), QUrl())) {
+      Deny(job);
+      return;
+    }
+
+    // Paths look like /<bridge token>/<transfer id>/<chunk index>
+    const QStringList segments = requestUrl.path().split(QLatin1Char('/'), Qt::SkipEmptyParts);
+    bool hasChunkIndex = false;
+    const int chunkIndex = segments.size() == 3 ? segments.at(2).toInt(&hasChunkIndex) : -1;
+    if (!hasChunkIndex || segments.at(0) != m_bridgeToken) {
+      Deny(job);
+      return;
+    }
+
+    const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    DropStaleTransfers(nowMs);
+
+    const QString transferId = segments.at(1);
+    const QUrlQuery query(requestUrl);
+    if (!m_transfers.contains(transferId)) {
+      if (chunkIndex != 0 || m_transfers.size() >= kMaxOpenTransfers) {
+        Deny(job);
+        return;
+      }
+      // The first chunk says how big the copy is, the buffer still only grows with accepted chunks
+      const qsizetype totalBytes = query.queryItemValue(QStringLiteral("total")).toLongLong();
+      if (totalBytes <= 0 || totalBytes > kMaxTransferBytes) {
+        Deny(job);
+        return;
+      }
+      m_transfers[transferId].declaredBytes = totalBytes;
+    }
+
+    // The page awaits each post, so chunks always arrive in order
+    Transfer &transfer = m_transfers[transferId];
+    if (chunkIndex != transfer.nextChunk ||
+        !AppendRequestBody(job->requestBody(), transfer.declaredBytes, transfer.bytes)) {
+      m_transfers.remove(transferId);
+      Deny(job);
+      return;
+    }
+    ++transfer.nextChunk;
+    transfer.lastActivityAtMs = nowMs;
+
+    if (query.queryItemValue(QStringLiteral("last")) == QStringLiteral("1")) {
+      const QByteArray utf8Text = std::move(transfer.bytes);
+      m_transfers.remove(transferId);
+      // Clipboard writes only accept meaningful text content
+      if (!ContainsVisibleText(utf8Text)) {
+        Deny(job);
+        return;
+      }
+      ClipboardChannel::CommitClipboardBytes(utf8Text);
+      Metrics::Increment(Metrics::Counter::ClipboardChannelCopies);
+      Metrics::Observe(Metrics::Histogram::ClipboardPayloadBytes, static_cast<quint64>(utf8Text.size()));
+    }
+    ReplyOk(job);
+  }
+
+private:
+  struct Transfer {
+    QByteArray bytes;
+    // Chunks past the size the first one announced are refused
+    qsizetype declaredBytes = 0;
+    int nextChunk = 0;
+    qint64 lastActivityAtMs = 0;
+  };
+
+  static bool AppendRequestBody(QIODevice *body, qsizetype maxBytes, QByteArray &bytes) {
+    if (body == nullptr || !body->isReadable()) {
+      return false;
+    }
+
+    // Read straight into the tail of the transfer buffer so each byte is copied once
+    while (!body->atEnd()) {
+      const qsizetype offset = bytes.size();
+      const qint64 availableBytes = body->bytesAvailable();
+      // One byte past the announced size is enough to catch an oversized body
+      const qint64 stepBytes =
+          std::min<qint64>(availableBytes > 0 ? availableBytes : kBodyReadStepBytes, maxBytes - offset + 1);
+      bytes.resize(offset + stepBytes);
+      const qint64 readBytes = body->read(bytes.data() + offset, stepBytes);
+      bytes.resize(offset + std::max<qint64>(0, readBytes));
+      if (readBytes < 0 || bytes.size() > maxBytes) {
+        return false;
+      }
+      if (readBytes == 0) {
+        break;
+      }
+    }
+    return true;
+  }
+
+  void DropStaleTransfers(qint64 nowMs) {
+    m_transfers.removeIf([nowMs](const QHash<QString, Transfer>::iterator &entry) {
+      return entry.value().lastActivityAtMs > 0 && nowMs - entry.value().lastActivityAtMs > kStaleTransferMs;
+    });
+  }
+
+  QString m_bridgeToken;
+  QHash<QString, Transfer> m_transfers;
+};
+#endif
+} // namespace
+
+namespace ClipboardChannel {
+
+void RegisterUrlScheme() {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+  QWebEngineUrlScheme scheme(kSchemeName);
+  scheme.setSyntax(QWebEngineUrlScheme::Syntax::Host);
+  // Secure keeps HTTPS pages from treating posts as mixed content, fetch needs its own opt in
+  scheme.setFlags(QWebEngineUrlScheme::SecureScheme | QWebEngineUrlScheme::CorsEnabled |
+                  QWebEngineUrlScheme::FetchApiAllowed);
+  QWebEngineUrlScheme::registerScheme(scheme);
+#endif
+}
+
+bool IsAvailable() {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+  return true;
+#else
+  return false;
+#endif
+}
+
+void InstallHandler(QWebEngineProfile *profile, const QString &bridgeToken) {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 7, 0)
+  if (profile == nullptr || bridgeToken.isEmpty()) {
+    return;
+  }
+  profile->installUrlSchemeHandler(kSchemeName, new ClipboardSchemeHandler(bridgeToken, profile));
+#else
+  Q_UNUSED(profile);
+  Q_UNUSED(bridgeToken);
+#endif
+}
+
+QString ChannelBaseUrl(const QString &bridgeToken) {
+  if (!IsAvailable() || bridgeToken.isEmpty()) {
+    return QString();
+  }
+  return QStringLiteral("%1://%2/%3")
+      .arg(QLatin1String(kSchemeName), QLatin1String(kClipboardHost), bridgeToken);
+}
+
+void CommitClipboardBytes(const QByteArray &utf8Text) {
+  if (!ContainsVisibleText(utf8Text)) {
+    return;
+  }
+
+  QCoreApplication *application = QGuiApplication::instance();
+  if (application == nullptr) {
+    return;
+  }
+
+  // Queue into the GUI loop for clipboard safety
+  QMetaObject::invokeMethod(
+      application,
+      [utf8Text]() {
+        ApplyClipboardBytes(utf8Text);
+        // Retry once in case the page's own copy handler races this one
+        QTimer::singleShot(kClipboardRetryDelayMs, QGuiApplication::instance(),
+                           [utf8Text]() { ApplyClipboardBytes(utf8Text); });
+      },
+      Qt::QueuedConnection);
+}
+
+} // namespace ClipboardChannel
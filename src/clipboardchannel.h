@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+class QWebEngineProfile;
+
+namespace ClipboardChannel {
+
+// Chromium reads custom scheme registrations once, before QApplication exists
+void RegisterUrlScheme();
+// Streaming needs request bodies on scheme handlers, older Qt keeps the prompt bridge
+bool IsAvailable();
+// Serve copy uploads for pages on this profile, guarded by the per run bridge token
+void InstallHandler(QWebEngineProfile *profile, const QString &bridgeToken);
+// Base URL the injected bridge posts chunks to, empty when streaming is unavailable
+QString ChannelBaseUrl(const QString &bridgeToken);
+// Write UTF-8 text to both clipboard targets without decoding it first
+void CommitClipboardBytes(const QByteArray &utf8Text);
+
+} // namespace ClipboardChannel
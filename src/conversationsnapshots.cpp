@@ -0,0 +1,458 @@
+#include "conversationsnapshots.h"
+#include "browserprofile.h"
+#include "perflog.h"
+#include "searchindex.h"
+#include "trustedorigins.h"
+
+#include <QByteArray>
+#include <QCborArray>
+#include <QCborValue>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileDevice>
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QPair>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QtEndian>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace {
+constexpr auto kLogFileName = "conversation-snapshots.log";
+constexpr auto kScrollFileName = "conversation-scroll.json";
+// Records start with this tag so a scan can tell a torn tail from real data
+constexpr quint32 kRecordMagic = 0x314E5343; // "CSN1"
+constexpr qint64 kHeaderBytes = 24;
+constexpr qint64 kFormatVersion = 1;
+// One runaway page should not be able to fill the disk
+constexpr qint64 kMaxRecordBytes = 32 * 1024 * 1024;
+// Older conversations are dropped at compaction once the live set passes this
+constexpr qint64 kMaxLiveBytes = 256 * 1024 * 1024;
+// Short chats render fast enough on their own, the search index still gets them
+constexpr qsizetype kMinSnapshotTurns = 24;
+// Small logs are cheaper to keep than to rewrite
+constexpr qint64 kCompactMinLogBytes = 16 * 1024 * 1024;
+
+struct RecordHeader {
+  quint32 magic = 0;
+  quint32 keyBytes = 0;
+  quint32 payloadBytes = 0;
+  quint32 checksum = 0;
+  qint64 savedAtMs = 0;
+};
+
+// Header fields are little endian on disk: magic, key size, payload size, checksum, save time
+RecordHeader ReadHeader(const uchar *data) {
+  RecordHeader header;
+  header.magic = qFromLittleEndian<quint32>(data);
+  header.keyBytes = qFromLittleEndian<quint32>(data + 4);
+  header.payloadBytes = qFromLittleEndian<quint32>(data + 8);
+  header.checksum = qFromLittleEndian<quint32>(data + 12);
+  header.savedAtMs = qFromLittleEndian<qint64>(data + 16);
+  return header;
+}
+
+QByteArray BuildRecord(const QByteArray &key, const QByteArray &payload, qint64 savedAtMs) {
+  QByteArray record(kHeaderBytes, Qt::Uninitialized);
+  uchar *data = reinterpret_cast<uchar *>(record.data());
+  qToLittleEndian<quint32>(kRecordMagic, data);
+  qToLittleEndian<quint32>(static_cast<quint32>(key.size()), data + 4);
+  qToLittleEndian<quint32>(static_cast<quint32>(payload.size()), data + 8);
+  qToLittleEndian<quint32>(qChecksum(payload), data + 12);
+  qToLittleEndian<qint64>(savedAtMs, data + 16);
+  record.reserve(kHeaderBytes + key.size() + payload.size());
+  record.append(key);
+  record.append(payload);
+  return record;
+}
+
+// Payloads are CBOR arrays: [version, scroll turn, [[role, [[is code, language, text], ...]], ...]]
+QByteArray EncodePayload(const ConversationSnapshot &snapshot) {
+  QCborArray turns;
+  for (const ConversationSnapshot::Turn &turn : snapshot.turns) {
+    QCborArray blocks;
+    for (const ConversationSnapshot::Block &block : turn.blocks) {
+      blocks.append(QCborArray{block.isCode, block.language, block.text});
+    }
+    turns.append(QCborArray{turn.role, blocks});
+  }
+  return QCborValue(QCborArray{kFormatVersion, snapshot.scrollTurn, turns}).toCbor();
+}
+
+std::optional<ConversationSnapshot> DecodePayload(const QByteArray &payload) {
+  const QCborArray root = QCborValue::fromCbor(payload).toArray();
+  if (root.size() != 3 || root.at(0).toInteger() != kFormatVersion) {
+    return std::nullopt;
+  }
+
+  ConversationSnapshot snapshot;
+  snapshot.scrollTurn = static_cast<int>(root.at(1).toInteger());
+  const QCborArray turns = root.at(2).toArray();
+  snapshot.turns.reserve(turns.size());
+  for (const QCborValue &turnValue : turns) {
+    const QCborArray turnArray = turnValue.toArray();
+    ConversationSnapshot::Turn turn;
+    turn.role = turnArray.at(0).toString();
+    const QCborArray blocks = turnArray.at(1).toArray();
+    turn.blocks.reserve(blocks.size());
+    for (const QCborValue &blockValue : blocks) {
+      const QCborArray blockArray = blockValue.toArray();
+      turn.blocks.append(ConversationSnapshot::Block{blockArray.at(0).toBool(), blockArray.at(1).toString(),
+                                                     blockArray.at(2).toString()});
+    }
+    snapshot.turns.append(std::move(turn));
+  }
+  const int lastTurn = std::max(0, static_cast<int>(snapshot.turns.size()) - 1);
+  snapshot.scrollTurn = std::clamp(snapshot.scrollTurn, 0, lastTurn);
+  return snapshot;
+}
+
+ConversationSnapshot SnapshotFromJson(const QJsonObject &object) {
+  ConversationSnapshot snapshot;
+  snapshot.scrollTurn = object.value(QStringLiteral("scrollTurn")).toInt();
+  const QJsonArray turns = object.value(QStringLiteral("turns")).toArray();
+  snapshot.turns.reserve(turns.size());
+  for (const QJsonValue &turnValue : turns) {
+    const QJsonObject turnObject = turnValue.toObject();
+    ConversationSnapshot::Turn turn;
+    turn.role = turnObject.value(QStringLiteral("role")).toString();
+    // The page sends blocks as [is code, language, text]
+    for (const QJsonValue &blockValue : turnObject.value(QStringLiteral("blocks")).toArray()) {
+      const QJsonArray blockArray = blockValue.toArray();
+      turn.blocks.append(ConversationSnapshot::Block{blockArray.at(0).toInt() != 0, blockArray.at(1).toString(),
+                                                     blockArray.at(2).toString()});
+    }
+    snapshot.turns.append(std::move(turn));
+  }
+  return snapshot;
+}
+} // namespace
+
+ConversationSnapshots &ConversationSnapshots::Instance() {
+  // Function static gives one snapshot log for the whole process
+  static ConversationSnapshots instance;
+  return instance;
+}
+
+ConversationSnapshots::~ConversationSnapshots() { Unmap(); }
+
+bool ConversationSnapshots::IsEnabled() {
+  const QString value = qEnvironmentVariable("CHATGPT_DESKTOP_CONVERSATION_SNAPSHOTS").trimmed().toLower();
+  return value != QStringLiteral("0") && value != QStringLiteral("false") && value != QStringLiteral("off");
+}
+
+QString ConversationSnapshots::KeyForUrl(const QUrl &url) {
+  if (!TrustedOrigins::IsTrustedHttpsUrl(url)) {
+    return QString();
+  }
+
+  // Conversations live at /c/<id>, project chats nest the same path under /g/<project>
+  static const QRegularExpression conversationPath(QStringLiteral("/c/[^/]+/?$"));
+  const QString path = url.path();
+  if (!conversationPath.match(path).hasMatch()) {
+    return QString();
+  }
+
+  QString key = url.host().toLower() + path;
+  if (key.endsWith(QLatin1Char('/'))) {
+    key.chop(1);
+  }
+  return key;
+}
+
+bool ConversationSnapshots::Contains(const QString &key) {
+  return !key.isEmpty() && EnsureOpen() && m_index.contains(key);
+}
+
+std::optional<ConversationSnapshot> ConversationSnapshots::Load(const QString &key) {
+  if (!Contains(key)) {
+    return std::nullopt;
+  }
+
+  const Entry entry = m_index.value(key);
+  const uchar *record = MapRecord(entry);
+  if (record == nullptr) {
+    return std::nullopt;
+  }
+
+  const RecordHeader header = ReadHeader(record);
+  // Wrap the mapped bytes without copying, CBOR decoding makes its own strings
+  const QByteArray payload = QByteArray::fromRawData(
+      reinterpret_cast<const char *>(record + kHeaderBytes + header.keyBytes), header.payloadBytes);
+  std::optional<ConversationSnapshot> snapshot;
+  if (qChecksum(payload) == header.checksum) {
+    snapshot = DecodePayload(payload);
+  }
+  if (!snapshot.has_value()) {
+    qWarning() << "Dropping unreadable conversation snapshot:" << key;
+    m_liveBytes -= entry.recordBytes;
+    m_index.remove(key);
+    return std::nullopt;
+  }
+  snapshot->savedAtMs = header.savedAtMs;
+  const auto scrollTurn = m_scrollTurns.constFind(key);
+  if (scrollTurn != m_scrollTurns.constEnd()) {
+    snapshot->scrollTurn = std::clamp(*scrollTurn, 0, std::max(0, static_cast<int>(snapshot->turns.size()) - 1));
+  }
+  return snapshot;
+}
+
+void ConversationSnapshots::StoreFromPage(const QString &snapshotsJson) {
+  if (snapshotsJson.isEmpty()) {
+    return;
+  }
+
+  const bool logOpen = EnsureOpen();
+  bool scrollTurnsChanged = false;
+  const QJsonArray snapshots = QJsonDocument::fromJson(snapshotsJson.toUtf8()).array();
+  for (const QJsonValue &snapshotValue : snapshots) {
+    const QJsonObject snapshotObject = snapshotValue.toObject();
+    // The page only names its own conversation, the key check keeps anything else out
+    const QString key = KeyForUrl(QUrl(snapshotObject.value(QStringLiteral("url")).toString()));
+    if (key.isEmpty()) {
+      continue;
+    }
+    if (!snapshotObject.contains(QStringLiteral("turns"))) {
+      // Scroll only entries move the saved position of a logged conversation and leave its record alone
+      const int scrollTurn = snapshotObject.value(QStringLiteral("scrollTurn")).toInt();
+      if (logOpen && m_index.contains(key) && m_scrollTurns.value(key, -1) != scrollTurn) {
+        m_scrollTurns.insert(key, scrollTurn);
+        scrollTurnsChanged = true;
+      }
+      continue;
+    }
+    const ConversationSnapshot snapshot = SnapshotFromJson(snapshotObject);
+    if (snapshot.turns.isEmpty()) {
+      continue;
+    }
+    if (logOpen && snapshot.turns.size() >= kMinSnapshotTurns && Append(key, snapshot)) {
+      // The new record carries the position it was captured at
+      scrollTurnsChanged = m_scrollTurns.remove(key) > 0 || scrollTurnsChanged;
+    }
+    SearchIndex::Instance().IndexConversation(key, snapshotObject.value(QStringLiteral("title")).toString(), snapshot);
+  }
+  if (logOpen) {
+    scrollTurnsChanged = CompactIfNeeded() || scrollTurnsChanged;
+  }
+  if (scrollTurnsChanged) {
+    SaveScrollTurns();
+  }
+}
+
+bool ConversationSnapshots::EnsureOpen() {
+  if (m_opened) {
+    return m_log != nullptr;
+  }
+  m_opened = true;
+  if (!IsEnabled()) {
+    return false;
+  }
+
+  const QString storagePath = BrowserProfile::Instance().StoragePath();
+  if (storagePath.isEmpty()) {
+    return false;
+  }
+  m_logPath = QDir(storagePath).filePath(QString::fromLatin1(kLogFileName));
+
+  auto log = std::make_unique<QFile>(m_logPath);
+  if (!log->open(QIODevice::ReadWrite)) {
+    qWarning() << "Failed to open conversation snapshot log:" << m_logPath << log->errorString();
+    return false;
+  }
+  // Conversation text is private, keep it to the owning user
+  log->setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+  m_log = std::move(log);
+  ScanLog();
+  LoadScrollTurns();
+  return true;
+}
+
+void ConversationSnapshots::LoadScrollTurns() {
+  m_scrollPath = QDir(BrowserProfile::Instance().StoragePath()).filePath(QString::fromLatin1(kScrollFileName));
+  QFile scrollFile(m_scrollPath);
+  if (!scrollFile.open(QIODevice::ReadOnly)) {
+    return;
+  }
+  const QJsonObject positions = QJsonDocument::fromJson(scrollFile.readAll()).object();
+  for (auto position = positions.constBegin(); position != positions.constEnd(); ++position) {
+    // Positions outlive their record only until the next compaction writes the file again
+    if (m_index.contains(position.key())) {
+      m_scrollTurns.insert(position.key(), position.value().toInt());
+    }
+  }
+}
+
+void ConversationSnapshots::SaveScrollTurns() {
+  QJsonObject positions;
+  for (auto position = m_scrollTurns.constBegin(); position != m_scrollTurns.constEnd(); ++position) {
+    positions.insert(position.key(), position.value());
+  }
+  const QByteArray bytes = QJsonDocument(positions).toJson(QJsonDocument::Compact);
+  QSaveFile scrollFile(m_scrollPath);
+  if (!scrollFile.open(QIODevice::WriteOnly) || scrollFile.write(bytes) != bytes.size() || !scrollFile.commit()) {
+    qWarning() << "Failed to write conversation scroll positions:" << m_scrollPath << scrollFile.errorString();
+    return;
+  }
+  // Conversation keys name private chats, keep them to the owning user
+  QFile::setPermissions(m_scrollPath, QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+}
+
+void ConversationSnapshots::ScanLog() {
+  Unmap();
+  m_index.clear();
+  m_liveBytes = 0;
+
+  const qint64 logBytes = m_log->size();
+  if (logBytes == 0) {
+    return;
+  }
+  m_mapped = m_log->map(0, logBytes);
+  if (m_mapped == nullptr) {
+    qWarning() << "Failed to map conversation snapshot log:" << m_logPath << m_log->errorString();
+    return;
+  }
+  m_mappedBytes = logBytes;
+
+  // Headers carry their own sizes, so indexing skips over every payload
+  qint64 offset = 0;
+  while (offset + kHeaderBytes <= logBytes) {
+    const RecordHeader header = ReadHeader(m_mapped + offset);
+    const qint64 recordBytes = kHeaderBytes + header.keyBytes + header.payloadBytes;
+    if (header.magic != kRecordMagic || offset + recordBytes > logBytes) {
+      break;
+    }
+    const QString key = QString::fromUtf8(reinterpret_cast<const char *>(m_mapped + offset + kHeaderBytes),
+                                          header.keyBytes);
+    // Later records for the same conversation replace earlier ones
+    const auto existing = m_index.constFind(key);
+    if (existing != m_index.constEnd()) {
+      m_liveBytes -= existing->recordBytes;
+    }
+    m_index.insert(key, Entry{offset, recordBytes, header.savedAtMs});
+    m_liveBytes += recordBytes;
+    offset += recordBytes;
+  }
+
+  if (offset < logBytes) {
+    // A crash mid append leaves a partial record, later appends must not land behind it
+    qWarning() << "Truncating conversation snapshot log after" << offset << "bytes";
+    Unmap();
+    m_log->resize(offset);
+  }
+}
+
+bool ConversationSnapshots::Append(const QString &key, const ConversationSnapshot &snapshot) {
+  const QByteArray keyBytes = key.toUtf8();
+  const QByteArray payload = EncodePayload(snapshot);
+  const qint64 savedAtMs = QDateTime::currentMSecsSinceEpoch();
+  const QByteArray record = BuildRecord(keyBytes, payload, savedAtMs);
+  if (record.size() > kMaxRecordBytes) {
+    qWarning() << "Skipping oversized conversation snapshot:" << key << record.size() << "bytes";
+    return false;
+  }
+
+  const qint64 offset = m_log->size();
+  if (!m_log->seek(offset) || m_log->write(record) != record.size() || !m_log->flush()) {
+    qWarning() << "Failed to append conversation snapshot:" << m_logPath << m_log->errorString();
+    Unmap();
+    m_log->resize(offset);
+    return false;
+  }
+
+  const auto existing = m_index.constFind(key);
+  if (existing != m_index.constEnd()) {
+    m_liveBytes -= existing->recordBytes;
+  }
+  m_index.insert(key, Entry{offset, record.size(), savedAtMs});
+  m_liveBytes += record.size();
+  qCInfo(lcPerformance).noquote() << "Saved conversation snapshot for" << key << "with" << snapshot.turns.size()
+                                  << "turns in" << record.size() << "bytes";
+  return true;
+}
+
+const uchar *ConversationSnapshots::MapRecord(const Entry &entry) {
+  if (entry.offset + entry.recordBytes > m_mappedBytes) {
+    Unmap();
+    const qint64 logBytes = m_log->size();
+    m_mapped = logBytes > 0 ? m_log->map(0, logBytes) : nullptr;
+    if (m_mapped == nullptr) {
+      return nullptr;
+    }
+    m_mappedBytes = logBytes;
+  }
+  return entry.offset + entry.recordBytes <= m_mappedBytes ? m_mapped + entry.offset : nullptr;
+}
+
+void ConversationSnapshots::Unmap() {
+  if (m_mapped != nullptr && m_log != nullptr) {
+    m_log->unmap(m_mapped);
+  }
+  m_mapped = nullptr;
+  m_mappedBytes = 0;
+}
+
+bool ConversationSnapshots::CompactIfNeeded() {
+  const qint64 logBytes = m_log->size();
+  if (m_liveBytes <= kMaxLiveBytes && (logBytes < kCompactMinLogBytes || logBytes < 2 * m_liveBytes)) {
+    return false;
+  }
+
+  // Newest conversations win when the live set is over budget
+  QList<QPair<QString, Entry>> entries;
+  entries.reserve(m_index.size());
+  for (auto it = m_index.constBegin(); it != m_index.constEnd(); ++it) {
+    entries.append({it.key(), it.value()});
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const auto &left, const auto &right) { return left.second.savedAtMs > right.second.savedAtMs; });
+
+  QSaveFile compacted(m_logPath);
+  if (!compacted.open(QIODevice::WriteOnly)) {
+    qWarning() << "Failed to compact conversation snapshot log:" << compacted.errorString();
+    return false;
+  }
+  qint64 keptBytes = 0;
+  int droppedCount = 0;
+  for (const QPair<QString, Entry> &keyedEntry : std::as_const(entries)) {
+    const Entry &entry = keyedEntry.second;
+    const uchar *record = MapRecord(entry);
+    if (record == nullptr || keptBytes + entry.recordBytes > kMaxLiveBytes) {
+      ++droppedCount;
+      continue;
+    }
+    compacted.write(reinterpret_cast<const char *>(record), entry.recordBytes);
+    keptBytes += entry.recordBytes;
+  }
+
+  // The old mapping and handle point at the file QSaveFile is about to replace
+  Unmap();
+  m_log->close();
+  if (!compacted.commit()) {
+    qWarning() << "Failed to replace conversation snapshot log:" << compacted.errorString();
+  }
+  if (!m_log->open(QIODevice::ReadWrite)) {
+    qWarning() << "Failed to reopen conversation snapshot log:" << m_logPath << m_log->errorString();
+    m_log.reset();
+    m_index.clear();
+    m_scrollTurns.clear();
+    m_liveBytes = 0;
+    return true;
+  }
+  m_log->setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+  ScanLog();
+  // Dropped conversations take their saved positions with them
+  for (auto position = m_scrollTurns.begin(); position != m_scrollTurns.end();) {
+    position = m_index.contains(position.key()) ? std::next(position) : m_scrollTurns.erase(position);
+  }
+  qCInfo(lcPerformance).noquote() << "Compacted conversation snapshot log from" << logBytes << "to" << keptBytes
+                                  << "bytes, dropped" << droppedCount << "old conversations";
+  return true;
+}
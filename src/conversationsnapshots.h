@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QUrl>
+#include <QtGlobal>
+#include <memory>
+#include <optional>
+
+class QFile;
+
+struct ConversationSnapshot {
+  struct Block {
+    bool isCode = false;
+    QString language;
+    QString text;
+  };
+  struct Turn {
+    QString role;
+    QList<Block> blocks;
+  };
+
+  QList<Turn> turns;
+  // First turn that was on screen when the page was captured
+  int scrollTurn = 0;
+  qint64 savedAtMs = 0;
+};
+
+class ConversationSnapshots final {
+public:
+  // One append-only log per profile serves every window in the process
+  static ConversationSnapshots &Instance();
+
+  // CHATGPT_DESKTOP_CONVERSATION_SNAPSHOTS=0 keeps conversation text off the disk
+  static bool IsEnabled();
+  // Conversation pages on trusted hosts map to host plus path, anything else to an empty key
+  static QString KeyForUrl(const QUrl &url);
+
+  bool Contains(const QString &key);
+  // Decode straight from the mapped log, nothing is read until a conversation is opened
+  std::optional<ConversationSnapshot> Load(const QString &key);
+  // Take the JSON array the page script hands over, log long snapshots and index every one for search
+  void StoreFromPage(const QString &snapshotsJson);
+
+private:
+  struct Entry {
+    qint64 offset = 0;
+    qint64 recordBytes = 0;
+    qint64 savedAtMs = 0;
+  };
+
+  ConversationSnapshots() = default;
+  ~ConversationSnapshots();
+
+  // The log is opened and indexed on first use so startup never touches it
+  bool EnsureOpen();
+  // Index every record header, a torn tail from a crash is cut off here
+  void ScanLog();
+  bool Append(const QString &key, const ConversationSnapshot &snapshot);
+  // Scroll positions change far more often than turns, they live in a small side file next to the log
+  void LoadScrollTurns();
+  void SaveScrollTurns();
+  // Map the whole log again once appends have grown it past the current mapping
+  const uchar *MapRecord(const Entry &entry);
+  void Unmap();
+  // Rewrite only the newest record per key once dead records dominate the log, true when it did
+  bool CompactIfNeeded();
+
+  bool m_opened = false;
+  QString m_logPath;
+  std::unique_ptr<QFile> m_log;
+  uchar *m_mapped = nullptr;
+  qint64 m_mappedBytes = 0;
+  QHash<QString, Entry> m_index;
+  qint64 m_liveBytes = 0;
+  QString m_scrollPath;
+  // Newer than the scroll turn inside the record, dropped again when the next record lands
+  QHash<QString, int> m_scrollTurns;
+};
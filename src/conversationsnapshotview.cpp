@@ -0,0 +1,101 @@
+#include "conversationsnapshotview.h"
+#include "conversationsnapshots.h"
+
+#include <QFontDatabase>
+#include <QPalette>
+#include <QPlainTextDocumentLayout>
+#include <QScrollBar>
+#include <QTextBlock>
+#include <QTextBlockFormat>
+#include <QTextCharFormat>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextFormat>
+#include <algorithm>
+
+namespace {
+QString RoleLabel(const QString &role) {
+  if (role == QStringLiteral("user")) {
+    return QStringLiteral("You");
+  }
+  if (role == QStringLiteral("assistant")) {
+    return QStringLiteral("ChatGPT");
+  }
+  return role.isEmpty() ? QStringLiteral("Message") : role;
+}
+} // namespace
+
+ConversationSnapshotView::ConversationSnapshotView(const ConversationSnapshot &snapshot, QWidget *parent)
+    : QPlainTextEdit(parent) {
+  setReadOnly(true);
+  setFrameShape(QFrame::NoFrame);
+  // Selecting and scrolling work, typing belongs to the live page once it takes over
+  setTextInteractionFlags(Qt::TextSelectableByMouse | Qt::TextSelectableByKeyboard);
+  setFocusPolicy(Qt::ClickFocus);
+  BuildDocument(snapshot);
+  ScrollToTurn(snapshot.scrollTurn);
+}
+
+int ConversationSnapshotView::TopTurn() const {
+  const int topBlock = firstVisibleBlock().blockNumber();
+  const auto next = std::upper_bound(m_turnFirstBlocks.cbegin(), m_turnFirstBlocks.cend(), topBlock);
+  return std::max(0, static_cast<int>(next - m_turnFirstBlocks.cbegin()) - 1);
+}
+
+void ConversationSnapshotView::BuildDocument(const ConversationSnapshot &snapshot) {
+  auto *snapshotDocument = new QTextDocument(this);
+  snapshotDocument->setDocumentLayout(new QPlainTextDocumentLayout(snapshotDocument));
+  snapshotDocument->setUndoRedoEnabled(false);
+
+  QTextCharFormat roleFormat;
+  roleFormat.setFontWeight(QFont::Bold);
+  const QTextCharFormat textFormat;
+  QTextCharFormat codeFormat;
+  codeFormat.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  const QTextBlockFormat textBlockFormat;
+  QTextBlockFormat codeBlockFormat;
+  codeBlockFormat.setBackground(palette().color(QPalette::AlternateBase));
+
+  QTextCursor cursor(snapshotDocument);
+  bool firstBlock = true;
+  // The empty document already holds one block, every later piece opens a new one
+  auto startBlock = [&cursor, &firstBlock](const QTextBlockFormat &blockFormat, const QTextCharFormat &charFormat) {
+    if (firstBlock) {
+      cursor.setBlockFormat(blockFormat);
+      cursor.setBlockCharFormat(charFormat);
+      cursor.setCharFormat(charFormat);
+      firstBlock = false;
+      return;
+    }
+    cursor.insertBlock(blockFormat, charFormat);
+  };
+
+  m_turnFirstBlocks.reserve(snapshot.turns.size());
+  for (const ConversationSnapshot::Turn &turn : snapshot.turns) {
+    if (!firstBlock) {
+      // One blank line between turns
+      startBlock(textBlockFormat, textFormat);
+    }
+    startBlock(textBlockFormat, roleFormat);
+    m_turnFirstBlocks.append(cursor.blockNumber());
+    cursor.insertText(RoleLabel(turn.role));
+    for (const ConversationSnapshot::Block &block : turn.blocks) {
+      // Newlines in the text become blocks that keep the format they started with
+      startBlock(block.isCode ? codeBlockFormat : textBlockFormat, block.isCode ? codeFormat : textFormat);
+      cursor.insertText(block.text);
+    }
+  }
+
+  setDocument(snapshotDocument);
+}
+
+void ConversationSnapshotView::ScrollToTurn(int turnIndex) {
+  if (turnIndex < 0 || turnIndex >= m_turnFirstBlocks.size()) {
+    return;
+  }
+
+  // The plain text scroll bar counts lines, so this puts the turn at the top edge
+  const QTextBlock block = document()->findBlockByNumber(m_turnFirstBlocks.at(turnIndex));
+  setTextCursor(QTextCursor(block));
+  verticalScrollBar()->setValue(block.firstLineNumber());
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QList>
+#include <QPlainTextEdit>
+
+struct ConversationSnapshot;
+class QWidget;
+
+// Read-only stand-in for a conversation while its live page loads underneath
+class ConversationSnapshotView final : public QPlainTextEdit {
+public:
+  explicit ConversationSnapshotView(const ConversationSnapshot &snapshot, QWidget *parent = nullptr);
+
+  // Turn at the top edge, so the live page can open where the reader is
+  int TopTurn() const;
+  void ScrollToTurn(int turnIndex);
+
+private:
+  // Plain text layout only lays out the blocks on screen, which keeps huge chats cheap to open
+  void BuildDocument(const ConversationSnapshot &snapshot);
+
+  // Block number where each turn starts, in turn order
+  QList<int> m_turnFirstBlocks;
+};
@@ -0,0 +1,454 @@
+#include "downloadmanager.h"
+#include "downloadpanel.h"
+#include "metrics.h"
+#include "perflog.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QTimer>
+#include <QWebEngineDownloadRequest>
+#include <QWebEngineProfile>
+#include <QWebEngineView>
+#include <QWidget>
+#include <algorithm>
+
+namespace {
+constexpr int kDefaultMaxActive = 3;
+constexpr int kMaxActiveLimit = 16;
+constexpr int kSampleIntervalMs = 1000;
+// Recent samples weigh more, so the speed follows a stall within a few seconds
+constexpr double kSpeedSmoothing = 0.3;
+// Waits of 2, 4 and 8 seconds before a transient failure counts as final
+constexpr int kMaxResumeAttempts = 3;
+constexpr int kResumeBaseDelayMs = 2000;
+// Finished rows stay in the panel until this many have piled up
+constexpr int kKeptFinishedItems = 50;
+
+QString ConfigFilePath() {
+  QString configRoot = qEnvironmentVariable("XDG_CONFIG_HOME");
+  if (configRoot.isEmpty()) {
+    configRoot = QDir::home().filePath(QStringLiteral(".config"));
+  }
+  return QDir(configRoot).filePath(QStringLiteral("chatgpt-desktop-unix/downloads.conf"));
+}
+
+QString DefaultDirectory() {
+  QString downloadDirectory = QStandardPaths::writableLocation(QStandardPaths::DownloadLocation);
+  if (downloadDirectory.isEmpty()) {
+    // Some setups do not report a download folder through XDG paths
+    downloadDirectory = QDir::homePath() + QDir::separator() + QStringLiteral("Downloads");
+  }
+  return downloadDirectory;
+}
+
+QString ExpandHome(const QString &path) {
+  if (path == QStringLiteral("~")) {
+    return QDir::homePath();
+  }
+  if (path.startsWith(QStringLiteral("~/"))) {
+    return QDir::home().filePath(path.mid(2));
+  }
+  return path;
+}
+
+// Network and server hiccups are worth another try, file and policy errors are not
+bool IsTransientInterruption(QWebEngineDownloadRequest::DownloadInterruptReason reason) {
+  switch (reason) {
+  case QWebEngineDownloadRequest::FileTransientError:
+  case QWebEngineDownloadRequest::NetworkFailed:
+  case QWebEngineDownloadRequest::NetworkTimeout:
+  case QWebEngineDownloadRequest::NetworkDisconnected:
+  case QWebEngineDownloadRequest::NetworkServerDown:
+  case QWebEngineDownloadRequest::ServerFailed:
+  case QWebEngineDownloadRequest::ServerUnreachable:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool IsFinished(DownloadManager::ItemState state) {
+  return state == DownloadManager::ItemState::Completed || state == DownloadManager::ItemState::Failed ||
+         state == DownloadManager::ItemState::Cancelled;
+}
+} // namespace
+
+DownloadManager &DownloadManager::Instance() {
+  // Function static gives one queue for the whole process
+  static DownloadManager instance;
+  return instance;
+}
+
+DownloadManager::DownloadManager() {
+  LoadRules();
+  m_sampleTimer = new QTimer(QCoreApplication::instance());
+  m_sampleTimer->setInterval(kSampleIntervalMs);
+  QObject::connect(m_sampleTimer, &QTimer::timeout, m_sampleTimer, [this]() { SampleThroughput(); });
+}
+
+void DownloadManager::Attach(QWebEngineProfile *profile) {
+  if (profile == nullptr || m_profiles.contains(profile)) {
+    return;
+  }
+  m_profiles.append(profile);
+  QObject::connect(profile, &QWebEngineProfile::downloadRequested, profile,
+                   [this](QWebEngineDownloadRequest *download) { HandleDownloadRequest(download); });
+}
+
+void DownloadManager::LoadRules() {
+  m_maxActive = kDefaultMaxActive;
+  QFile configFile(ConfigFilePath());
+  if (!configFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    return;
+  }
+  // One pattern=directory per line, # starts a comment and max-active sets the queue width
+  while (!configFile.atEnd()) {
+    const QString line = QString::fromUtf8(configFile.readLine()).section(QLatin1Char('#'), 0, 0).trimmed();
+    const qsizetype separator = line.indexOf(QLatin1Char('='));
+    if (separator <= 0) {
+      continue;
+    }
+    const QString key = line.left(separator).trimmed();
+    const QString value = line.mid(separator + 1).trimmed();
+    if (key == QStringLiteral("max-active")) {
+      m_maxActive = std::clamp(value.toInt(), 1, kMaxActiveLimit);
+      continue;
+    }
+    Rule rule;
+    rule.pattern = QRegularExpression(QRegularExpression::wildcardToRegularExpression(key),
+                                      QRegularExpression::CaseInsensitiveOption);
+    rule.matchesMimeType = key.contains(QLatin1Char('/'));
+    rule.directory = value == QStringLiteral("ask") ? QString() : QDir::cleanPath(ExpandHome(value));
+    if (!rule.pattern.isValid() || value.isEmpty()) {
+      qWarning() << "Ignoring download rule:" << line;
+      continue;
+    }
+    m_rules.append(rule);
+  }
+  qCInfo(lcPerformance).noquote() << "Download rules:" << m_rules.size() << "from" << ConfigFilePath()
+                                  << "max active" << m_maxActive;
+}
+
+void DownloadManager::HandleDownloadRequest(QWebEngineDownloadRequest *download) {
+  // Qt can still fire this while a page is shutting down
+  if (download == nullptr || download->state() != QWebEngineDownloadRequest::DownloadRequested) {
+    return;
+  }
+
+  const QString targetPath = ChooseTargetPath(download);
+  if (targetPath.isEmpty()) {
+    // A closed dialog or an unusable folder means the download should stop
+    download->cancel();
+    return;
+  }
+
+  // Split the chosen path back into the pieces Qt expects
+  const QFileInfo targetInfo(targetPath);
+  download->setDownloadDirectory(targetInfo.absolutePath());
+  download->setDownloadFileName(targetInfo.fileName());
+  QObject::connect(download, &QWebEngineDownloadRequest::stateChanged, download,
+                   [this, download]() { HandleStateChanged(download); });
+  // Chromium only honours an accept made inside the request signal, so the queue holds downloads by
+  // pausing them right after instead of delaying the accept
+  download->accept();
+
+  Item item;
+  item.request = download;
+  item.targetPath = targetPath;
+  item.totalBytes = download->totalBytes();
+  m_items.append(item);
+  Metrics::Increment(Metrics::Counter::DownloadsStarted);
+  QTimer::singleShot(0, download, [this]() { StartQueuedItems(); });
+
+  if (m_panel == nullptr || !m_panel->isVisible()) {
+    TogglePanel();
+  }
+}
+
+QString DownloadManager::ChooseTargetPath(QWebEngineDownloadRequest *download) {
+  const QString suggestedName =
+      download->downloadFileName().isEmpty() ? QStringLiteral("download") : download->downloadFileName();
+  const QString mimeType = download->mimeType();
+  const Rule *matchedRule = nullptr;
+  for (const Rule &rule : m_rules) {
+    if (rule.pattern.match(rule.matchesMimeType ? mimeType : suggestedName).hasMatch()) {
+      matchedRule = &rule;
+      break;
+    }
+  }
+
+  if (matchedRule != nullptr && matchedRule->directory.isEmpty()) {
+    // Ask rules keep the old save dialog, Chromium needs the answer before this signal returns
+    QWidget *dialogParent = QWebEngineView::forPage(download->page());
+    const QString suggestedPath = QDir(DefaultDirectory()).filePath(suggestedName);
+    const QString selectedPath = QFileDialog::getSaveFileName(
+        dialogParent, QCoreApplication::translate("DownloadManager", "Save File"), suggestedPath);
+    if (selectedPath.isEmpty()) {
+      return QString();
+    }
+    const QFileInfo selectedInfo(selectedPath);
+    if (selectedInfo.fileName().isEmpty() || !PrepareDirectory(selectedInfo.absolutePath())) {
+      qWarning() << "Invalid target path for download:" << selectedPath;
+      return QString();
+    }
+    // The dialog already asked about overwriting
+    return selectedInfo.absoluteFilePath();
+  }
+
+  const QString directory = matchedRule != nullptr ? matchedRule->directory : DefaultDirectory();
+  if (!PrepareDirectory(directory)) {
+    return QString();
+  }
+  return UniquePath(directory, QFileInfo(suggestedName).fileName());
+}
+
+QString DownloadManager::UniquePath(const QString &directory, const QString &fileName) const {
+  const QDir targetDirectory(directory);
+  const QFileInfo nameInfo(fileName);
+  const QString baseName = nameInfo.completeBaseName();
+  const QString suffix = nameInfo.suffix().isEmpty() ? QString() : QLatin1Char('.') + nameInfo.suffix();
+  // Downloads still in flight have not created their file yet, so their names are taken too
+  const auto isTaken = [this](const QString &path) {
+    if (QFileInfo::exists(path)) {
+      return true;
+    }
+    return std::any_of(m_items.cbegin(), m_items.cend(),
+                       [&path](const Item &item) { return !IsFinished(item.state) && item.targetPath == path; });
+  };
+  QString candidate = targetDirectory.filePath(fileName);
+  for (int copy = 1; isTaken(candidate); ++copy) {
+    candidate = targetDirectory.filePath(QStringLiteral("%1 (%2)%3").arg(baseName).arg(copy).arg(suffix));
+  }
+  return candidate;
+}
+
+bool DownloadManager::PrepareDirectory(const QString &directory) {
+  if (m_preparedDirectories.contains(directory)) {
+    return true;
+  }
+  if (!QDir().mkpath(directory)) {
+    qWarning() << "Failed to create download directory:" << directory;
+    return false;
+  }
+  m_preparedDirectories.insert(directory);
+  return true;
+}
+
+void DownloadManager::HandleStateChanged(QWebEngineDownloadRequest *download) {
+  Item *item = FindItem(download);
+  if (item == nullptr || IsFinished(item->state)) {
+    return;
+  }
+
+  switch (download->state()) {
+  case QWebEngineDownloadRequest::DownloadCompleted:
+    FinishItem(*item, ItemState::Completed);
+    break;
+  case QWebEngineDownloadRequest::DownloadCancelled:
+    FinishItem(*item, ItemState::Cancelled);
+    break;
+  case QWebEngineDownloadRequest::DownloadInterrupted:
+    if (IsTransientInterruption(download->interruptReason()) && item->resumeAttempts < kMaxResumeAttempts) {
+      StopItemClock(*item);
+      if (item->state != ItemState::Retrying) {
+        item->stateBeforeRetry = item->state;
+      }
+      item->state = ItemState::Retrying;
+      ScheduleResume(download);
+      break;
+    }
+    FinishItem(*item, ItemState::Failed);
+    break;
+  case QWebEngineDownloadRequest::DownloadInProgress:
+    if (item->state == ItemState::Retrying) {
+      qCInfo(lcPerformance).noquote() << "Download resumed:" << QFileInfo(item->targetPath).fileName() << "attempt"
+                                      << item->resumeAttempts;
+      if (item->stateBeforeRetry == ItemState::Queued) {
+        // Still waiting for a slot, StartQueuedItems below either starts it or pauses it again
+        item->state = ItemState::Queued;
+        break;
+      }
+      item->state = ItemState::Active;
+      item->activeTimer.start();
+      m_sampleTimer->start();
+    }
+    break;
+  case QWebEngineDownloadRequest::DownloadRequested:
+    break;
+  }
+  StartQueuedItems();
+}
+
+void DownloadManager::StartQueuedItems() {
+  int activeCount = ActiveCount();
+  // Oldest first, everything past the limit waits paused
+  for (Item &item : m_items) {
+    if (item.state != ItemState::Queued || item.request.isNull()) {
+      continue;
+    }
+    if (activeCount < m_maxActive) {
+      StartItem(item);
+      ++activeCount;
+    } else if (item.request->state() == QWebEngineDownloadRequest::DownloadInProgress && !item.request->isPaused()) {
+      item.request->pause();
+    }
+  }
+}
+
+void DownloadManager::StartItem(Item &item) {
+  item.state = ItemState::Active;
+  if (item.request->isPaused()) {
+    item.request->resume();
+  }
+  item.sampledBytes = item.request->receivedBytes();
+  item.activeTimer.start();
+  m_sampleTimer->start();
+}
+
+void DownloadManager::StopItemClock(Item &item) {
+  if (item.activeTimer.isValid()) {
+    item.activeMsBefore += item.activeTimer.elapsed();
+    item.activeTimer.invalidate();
+  }
+  item.bytesPerSecond = 0.0;
+}
+
+void DownloadManager::FinishItem(Item &item, ItemState state) {
+  StopItemClock(item);
+  item.state = state;
+  QWebEngineDownloadRequest *download = item.request.data();
+  if (download != nullptr) {
+    item.receivedBytes = download->receivedBytes();
+    item.totalBytes = download->totalBytes();
+  }
+  const QString fileName = QFileInfo(item.targetPath).fileName();
+
+  if (state == ItemState::Completed) {
+    const quint64 receivedBytes = static_cast<quint64>(std::max<qint64>(0, item.receivedBytes));
+    const qint64 activeMs = std::max<qint64>(1, item.activeMsBefore);
+    // Average over transfer time only, so the panel and the histogram agree
+    item.bytesPerSecond = static_cast<double>(receivedBytes) * 1000.0 / static_cast<double>(activeMs);
+    Metrics::Increment(Metrics::Counter::DownloadsCompleted);
+    Metrics::Increment(Metrics::Counter::DownloadBytes, receivedBytes);
+    Metrics::Observe(Metrics::Histogram::DownloadBytesPerSecond, receivedBytes * 1000 / activeMs);
+    qCInfo(lcPerformance).noquote() << "Download completed:" << fileName << receivedBytes / 1024 << "KiB in"
+                                    << activeMs << "ms," << static_cast<qint64>(item.bytesPerSecond / 1024)
+                                    << "KiB/s," << item.resumeAttempts << "resumes";
+  } else {
+    Metrics::Increment(Metrics::Counter::DownloadsFailed);
+    // Keep a clear log line when the browser stops a download
+    if (download != nullptr) {
+      qWarning() << "Download failed:" << download->url() << "state:" << download->state()
+                 << "reason:" << download->interruptReasonString() << "resumes:" << item.resumeAttempts;
+    }
+  }
+
+  // Only finished rows are dropped, oldest first, and item is not used past this point
+  int finishedCount = static_cast<int>(
+      std::count_if(m_items.cbegin(), m_items.cend(), [](const Item &entry) { return IsFinished(entry.state); }));
+  for (qsizetype index = 0; index < m_items.size() && finishedCount > kKeptFinishedItems;) {
+    if (IsFinished(m_items.at(index).state)) {
+      m_items.removeAt(index);
+      --finishedCount;
+      continue;
+    }
+    ++index;
+  }
+}
+
+void DownloadManager::ScheduleResume(QWebEngineDownloadRequest *download) {
+  Item *item = FindItem(download);
+  const int delayMs = kResumeBaseDelayMs << item->resumeAttempts;
+  ++item->resumeAttempts;
+  QTimer::singleShot(delayMs, download, [this, download]() {
+    if (download->state() != QWebEngineDownloadRequest::DownloadInterrupted) {
+      return;
+    }
+    download->resume();
+    // Chromium leaves downloads it cannot resume interrupted without another signal
+    QTimer::singleShot(kResumeBaseDelayMs, download, [this, download]() {
+      const Item *retried = FindItem(download);
+      if (retried != nullptr && retried->state == ItemState::Retrying &&
+          download->state() == QWebEngineDownloadRequest::DownloadInterrupted) {
+        HandleStateChanged(download);
+      }
+    });
+  });
+}
+
+void DownloadManager::SampleThroughput() {
+  bool anyActive = false;
+  for (Item &item : m_items) {
+    if (item.state != ItemState::Active || item.request.isNull()) {
+      continue;
+    }
+    anyActive = true;
+    const qint64 receivedBytes = item.request->receivedBytes();
+    const double sampleBytesPerSecond =
+        static_cast<double>(std::max<qint64>(0, receivedBytes - item.sampledBytes)) * 1000.0 / kSampleIntervalMs;
+    item.bytesPerSecond = item.bytesPerSecond <= 0.0
+                              ? sampleBytesPerSecond
+                              : item.bytesPerSecond + kSpeedSmoothing * (sampleBytesPerSecond - item.bytesPerSecond);
+    item.sampledBytes = receivedBytes;
+    item.receivedBytes = receivedBytes;
+    item.totalBytes = item.request->totalBytes();
+  }
+  if (!anyActive) {
+    m_sampleTimer->stop();
+  }
+}
+
+DownloadManager::Stats DownloadManager::CurrentStats() const {
+  Stats stats;
+  stats.items.reserve(m_items.size());
+  for (auto entry = m_items.crbegin(); entry != m_items.crend(); ++entry) {
+    ItemStats itemStats;
+    itemStats.fileName = QFileInfo(entry->targetPath).fileName();
+    itemStats.targetPath = entry->targetPath;
+    itemStats.state = entry->state;
+    const bool live = !entry->request.isNull() && !IsFinished(entry->state);
+    itemStats.receivedBytes = live ? entry->request->receivedBytes() : entry->receivedBytes;
+    itemStats.totalBytes = live ? entry->request->totalBytes() : entry->totalBytes;
+    itemStats.bytesPerSecond = entry->bytesPerSecond;
+    itemStats.resumeAttempts = entry->resumeAttempts;
+    if (entry->state == ItemState::Active || entry->state == ItemState::Retrying) {
+      ++stats.activeCount;
+      stats.bytesPerSecond += entry->bytesPerSecond;
+    } else if (entry->state == ItemState::Queued) {
+      ++stats.queuedCount;
+    }
+    stats.items.append(itemStats);
+  }
+  return stats;
+}
+
+void DownloadManager::TogglePanel() {
+  if (m_panel == nullptr) {
+    m_panel = new DownloadPanel([this]() { return CurrentStats(); });
+  }
+  m_panel->Toggle();
+}
+
+DownloadManager::Item *DownloadManager::FindItem(const QWebEngineDownloadRequest *download) {
+  for (Item &item : m_items) {
+    if (item.request == download) {
+      return &item;
+    }
+  }
+  return nullptr;
+}
+
+int DownloadManager::ActiveCount() const {
+  return static_cast<int>(std::count_if(m_items.cbegin(), m_items.cend(), [](const Item &item) {
+    // A queued download that got interrupted is retried without taking a slot
+    return item.state == ItemState::Active ||
+           (item.state == ItemState::Retrying && item.stateBeforeRetry == ItemState::Active);
+  }));
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QPointer>
+#include <QRegularExpression>
+#include <QSet>
+#include <QString>
+#include <QtGlobal>
+
+class DownloadPanel;
+class QTimer;
+class QWebEngineDownloadRequest;
+class QWebEngineProfile;
+
+class DownloadManager final {
+public:
+  enum class ItemState { Queued, Active, Retrying, Completed, Failed, Cancelled };
+
+  struct ItemStats {
+    QString fileName;
+    QString targetPath;
+    ItemState state = ItemState::Queued;
+    qint64 receivedBytes = 0;
+    // Zero or less when the server sent no length
+    qint64 totalBytes = 0;
+    double bytesPerSecond = 0.0;
+    int resumeAttempts = 0;
+    // Queued or Active, where a retried download goes back to once Chromium resumes it
+    ItemState stateBeforeRetry = ItemState::Active;
+  };
+
+  struct Stats {
+    QList<ItemStats> items;
+    int activeCount = 0;
+    int queuedCount = 0;
+    double bytesPerSecond = 0.0;
+  };
+
+  // One queue for every window and profile in the process
+  static DownloadManager &Instance();
+
+  // Profiles are shared by many views, each one is connected once
+  void Attach(QWebEngineProfile *profile);
+  // Newest first, speeds are smoothed over the last few seconds
+  Stats CurrentStats() const;
+  // The panel is built on first use and shared by every window
+  void TogglePanel();
+
+private:
+  struct Rule {
+    QRegularExpression pattern;
+    // Patterns with a slash match the MIME type, the rest match the file name
+    bool matchesMimeType = false;
+    // Empty means ask with a save dialog
+    QString directory;
+  };
+
+  struct Item {
+    QPointer<QWebEngineDownloadRequest> request;
+    QString targetPath;
+    ItemState state = ItemState::Queued;
+    // Last values seen, kept after Chromium drops the request
+    qint64 receivedBytes = 0;
+    qint64 totalBytes = 0;
+    // Time spent transferring, queued and retry waits are left out of the throughput
+    QElapsedTimer activeTimer;
+    qint64 activeMsBefore = 0;
+    qint64 sampledBytes = 0;
+    double bytesPerSecond = 0.0;
+    int resumeAttempts = 0;
+    // Queued or Active, where a retried download goes back to once Chromium resumes it
+    ItemState stateBeforeRetry = ItemState::Active;
+  };
+
+  DownloadManager();
+  ~DownloadManager() = default;
+
+  // Rules come from downloads.conf next to performance.conf, read once per process
+  void LoadRules();
+  void HandleDownloadRequest(QWebEngineDownloadRequest *download);
+  // Empty when the user closed the save dialog of an ask rule
+  QString ChooseTargetPath(QWebEngineDownloadRequest *download);
+  QString UniquePath(const QString &directory, const QString &fileName) const;
+  bool PrepareDirectory(const QString &directory);
+  void HandleStateChanged(QWebEngineDownloadRequest *download);
+  void StartQueuedItems();
+  void StartItem(Item &item);
+  void StopItemClock(Item &item);
+  void FinishItem(Item &item, ItemState state);
+  void ScheduleResume(QWebEngineDownloadRequest *download);
+  void SampleThroughput();
+  Item *FindItem(const QWebEngineDownloadRequest *download);
+  int ActiveCount() const;
+
+  QList<QPointer<QWebEngineProfile>> m_profiles;
+  QList<Item> m_items;
+  // First match wins, no match saves into the download folder without asking
+  QList<Rule> m_rules;
+  int m_maxActive = 3;
+  // Directories already created this session, so bursts of downloads skip mkpath
+  QSet<QString> m_preparedDirectories;
+  QTimer *m_sampleTimer = nullptr;
+  DownloadPanel *m_panel = nullptr;
+};
@@ -0,0 +1,135 @@
+#include "downloadpanel.h"
+
+#include <QDesktopServices>
+#include <QFileInfo>
+#include <QLabel>
+#include <QListWidget>
+#include <QListWidgetItem>
+#include <QStringList>
+#include <QTimer>
+#include <QUrl>
+#include <QVBoxLayout>
+#include <QVariant>
+#include <utility>
+
+namespace {
+// Same cadence as the manager's speed samples
+constexpr int kRefreshIntervalMs = 1000;
+constexpr int kPanelWidth = 460;
+constexpr int kPanelHeight = 320;
+
+QString FormatBytes(double bytes) {
+  if (bytes >= 1024.0 * 1024.0) {
+    return QString::number(bytes / (1024.0 * 1024.0), 'f', 1) + QStringLiteral(" MiB");
+  }
+  return QString::number(bytes / 1024.0, 'f', 0) + QStringLiteral(" KiB");
+}
+
+QString StateName(DownloadManager::ItemState state) {
+  switch (state) {
+  case DownloadManager::ItemState::Queued:
+    return QStringLiteral("queued");
+  case DownloadManager::ItemState::Active:
+    return QStringLiteral("active");
+  case DownloadManager::ItemState::Retrying:
+    return QStringLiteral("retrying");
+  case DownloadManager::ItemState::Completed:
+    return QStringLiteral("done");
+  case DownloadManager::ItemState::Failed:
+    return QStringLiteral("failed");
+  case DownloadManager::ItemState::Cancelled:
+    return QStringLiteral("cancelled");
+  }
+  return QString();
+}
+
+QString DescribeItem(const DownloadManager::ItemStats &item) {
+  QStringList parts = {StateName(item.state)};
+  if (item.totalBytes > 0) {
+    const int percent = static_cast<int>(item.receivedBytes * 100 / item.totalBytes);
+    parts << QStringLiteral("%1% of %2").arg(percent).arg(FormatBytes(static_cast<double>(item.totalBytes)));
+  } else {
+    parts << FormatBytes(static_cast<double>(item.receivedBytes));
+  }
+  // Finished rows keep their average, running rows show the current speed
+  if (item.bytesPerSecond > 0.0) {
+    parts << FormatBytes(item.bytesPerSecond) + QStringLiteral("/s");
+  }
+  if (item.resumeAttempts > 0) {
+    parts << QStringLiteral("%1 resumes").arg(item.resumeAttempts);
+  }
+  return item.fileName + QLatin1Char('\n') + parts.join(QStringLiteral(", "));
+}
+} // namespace
+
+DownloadPanel::DownloadPanel(StatsProvider statsProvider)
+    : QFrame(nullptr, Qt::Tool), m_statsProvider(std::move(statsProvider)) {
+  setWindowTitle(QStringLiteral("Downloads"));
+  setAttribute(Qt::WA_ShowWithoutActivating);
+  // A parentless tool window still counts as a primary window, an open panel must not keep the app alive
+  setAttribute(Qt::WA_QuitOnClose, false);
+  resize(kPanelWidth, kPanelHeight);
+
+  m_summaryLabel = new QLabel(this);
+  m_itemList = new QListWidget(this);
+  m_itemList->setSelectionMode(QAbstractItemView::SingleSelection);
+  auto *layout = new QVBoxLayout(this);
+  layout->addWidget(m_summaryLabel);
+  layout->addWidget(m_itemList);
+
+  connect(m_itemList, &QListWidget::itemActivated, this,
+          [this](const QListWidgetItem *row) { OpenItemFolder(row); });
+
+  m_refreshTimer = new QTimer(this);
+  m_refreshTimer->setInterval(kRefreshIntervalMs);
+  connect(m_refreshTimer, &QTimer::timeout, this, [this]() {
+    // Closing the window hides it without going through Toggle
+    if (!isVisible()) {
+      m_refreshTimer->stop();
+      return;
+    }
+    Refresh();
+  });
+}
+
+void DownloadPanel::Toggle() {
+  if (isVisible()) {
+    m_refreshTimer->stop();
+    hide();
+    return;
+  }
+  Refresh();
+  show();
+  m_refreshTimer->start();
+}
+
+void DownloadPanel::Refresh() {
+  const DownloadManager::Stats stats = m_statsProvider();
+  m_summaryLabel->setText(QStringLiteral("%1 active, %2 queued, %3/s")
+                              .arg(stats.activeCount)
+                              .arg(stats.queuedCount)
+                              .arg(FormatBytes(stats.bytesPerSecond)));
+
+  // Rows are reused so the selection survives a refresh
+  while (m_itemList->count() > stats.items.size()) {
+    delete m_itemList->takeItem(m_itemList->count() - 1);
+  }
+  for (qsizetype index = 0; index < stats.items.size(); ++index) {
+    const DownloadManager::ItemStats &item = stats.items.at(index);
+    QListWidgetItem *row = m_itemList->item(static_cast<int>(index));
+    if (row == nullptr) {
+      row = new QListWidgetItem(m_itemList);
+    }
+    row->setText(DescribeItem(item));
+    row->setData(Qt::UserRole, item.targetPath);
+    row->setToolTip(item.targetPath);
+  }
+}
+
+void DownloadPanel::OpenItemFolder(const QListWidgetItem *row) const {
+  const QString targetPath = row->data(Qt::UserRole).toString();
+  if (targetPath.isEmpty()) {
+    return;
+  }
+  QDesktopServices::openUrl(QUrl::fromLocalFile(QFileInfo(targetPath).absolutePath()));
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "downloadmanager.h"
+
+#include <QFrame>
+#include <functional>
+
+class QLabel;
+class QListWidget;
+class QListWidgetItem;
+class QTimer;
+
+// Small tool window listing downloads from every window with their speed and the total
+class DownloadPanel final : public QFrame {
+public:
+  using StatsProvider = std::function<DownloadManager::Stats()>;
+
+  explicit DownloadPanel(StatsProvider statsProvider);
+
+  // Showing never takes focus away from the chat that started the download
+  void Toggle();
+
+private:
+  void Refresh();
+  // Finished rows open their folder on double click
+  void OpenItemFolder(const QListWidgetItem *row) const;
+
+  StatsProvider m_statsProvider;
+  QLabel *m_summaryLabel = nullptr;
+  QListWidget *m_itemList = nullptr;
+  QTimer *m_refreshTimer = nullptr;
+};
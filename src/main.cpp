@@ -1,12 +1,29 @@
 #include <QApplication>
 #include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QGuiApplication>
 #include <QSocketNotifier>
 #include <QUrl>
+#include <QVariant>
+#include <QWebEnginePage>
+#include <QWebEngineScript>
 #include <csignal>
 #include <cerrno>
 #include <fcntl.h>
+#include <memory>
 #include <unistd.h>
 #include "appwindow.h"
+#include "assetstore.h"
+#include "browserprofile.h"
+#include "chromiumflags.h"
+#include "chatview.h"
+#include "chatviewpool.h"
+#include "clipboardchannel.h"
+#include "metrics.h"
+#include "perflog.h"
+#include "sessionstore.h"
+#include "singleinstance.h"
+#include "startuptrace.h"
 
 // Signal bridge for graceful shutdown on SIGINT and SIGTERM
 static int signalPipeFileDescriptors[2] = {-1, -1};
@@ -18,10 +35,38 @@ static void CloseSignalPipe();
 static void HandleSignal(int signalNumber);
 static void HandleSignalNotification();
 static QUrl ResolveInitialUrl();
+static void OpenForwardedWindow(const QUrl &url);
+static void RestoreBackgroundWindows(const QList<SessionWindow> &savedWindows);
+static void TraceFirstWindowLoad(ChatView *chatView);
+static void QuitAfterShutdownDrain();
 
 int main(int argc, char *argv[]) {
+  // Start the clock before anything else so the trace covers the whole launch
+  StartupTrace::Initialize(argc, argv);
+
+  // A running owner can take this launch before any Qt or Chromium setup
+  const QUrl initialUrl = ResolveInitialUrl();
+  StartupTrace::Begin("SingleInstance::ForwardToRunningInstance");
+  const bool forwarded = SingleInstance::IsEnabled() && SingleInstance::ForwardToRunningInstance(initialUrl);
+  StartupTrace::End("SingleInstance::ForwardToRunningInstance");
+  if (forwarded) {
+    StartupTrace::Finish();
+    return 0;
+  }
+
+  // Chromium reads its switches once, when QApplication brings it up
+  StartupTrace::Begin("ChromiumFlags::Apply");
+  ChromiumFlags::Apply(argc, argv);
+  StartupTrace::End("ChromiumFlags::Apply");
+
+  // Custom schemes must be known before Chromium starts with QApplication
+  ClipboardChannel::RegisterUrlScheme();
+  AssetStore::RegisterUrlScheme();
+
   // Create the GUI app before any WebEngine objects are touched
+  StartupTrace::Begin("QApplication construction");
   QApplication app(argc, argv);
+  StartupTrace::End("QApplication construction");
 
   // Stable application identity for persistent storage paths
   QCoreApplication::setOrganizationName(QStringLiteral("chatgpt-desktop-unix"));
@@ -30,11 +75,45 @@ int main(int argc, char *argv[]) {
 
   // Map Ctrl+C and service stop signals into a normal Qt quit
   InstallSignalHandlers(&app);
+  // Closing the last window quits through the same drain as a signal
+  app.setQuitOnLastWindowClosed(false);
+  QObject::connect(&app, &QGuiApplication::lastWindowClosed, &app, []() { QuitAfterShutdownDrain(); });
+
+  // Fleet monitoring scrapes from a background thread, so the GUI thread never waits on a reader
+  if (Metrics::IsServingEnabled()) {
+    Metrics::StartServing(&app);
+  }
 
-  // Tests can point the first window at a small local page
-  // Normal runs still use the built-in default start page
-  AppWindow window(ResolveInitialUrl());
+  // Only the main profile owner takes later launches, isolated copies stay standalone
+  if (SingleInstance::IsEnabled() && BrowserProfile::Instance().OwnsMainProfile()) {
+    SingleInstance::StartListening(&app, OpenForwardedWindow);
+  }
+
+  // Tests can point the first window at a small local page, those runs leave the saved session alone
+  // Normal runs bring back the last session's windows, or the built-in default start page
+  const QList<SessionWindow> savedWindows =
+      initialUrl.isEmpty() ? SessionStore::Instance().Load(AppWindow::IsTabbedModeEnabled()) : QList<SessionWindow>();
+  const std::unique_ptr<AppWindow> firstWindow = savedWindows.isEmpty()
+                                                     ? std::make_unique<AppWindow>(initialUrl)
+                                                     : std::make_unique<AppWindow>(savedWindows.first());
+  AppWindow &window = *firstWindow;
+  if (!savedWindows.isEmpty()) {
+    RestoreBackgroundWindows(savedWindows);
+    // The focused window of the last session is the only one that loads now
+    window.GetChatView()->LoadDeferredPage();
+  }
   window.show();
+  if (savedWindows.size() > 1) {
+    // Background windows were shown first, focus goes back to the one that had it
+    window.raise();
+    window.activateWindow();
+  }
+  TraceFirstWindowLoad(window.GetChatView());
+
+  // Warm the view pool once the first page is done with its own load
+  QObject::connect(window.GetChatView(), &QWebEngineView::loadFinished, &app,
+                   []([[maybe_unused]] bool ok) { ChatViewPool::Instance().ScheduleRefill(); },
+                   Qt::SingleShotConnection);
 
   return app.exec();
 }
@@ -59,6 +138,82 @@ static QUrl ResolveInitialUrl() {
   return QUrl();
 }
 
+static void OpenForwardedWindow(const QUrl &url) {
+  // Forwarded launches share this profile, so they keep login and warm caches
+  AppWindow *forwardedWindow = new AppWindow(ChatViewPool::Instance().Open(url));
+  // Extra windows live on the heap, so close can delete them safely
+  forwardedWindow->setAttribute(Qt::WA_DeleteOnClose);
+  forwardedWindow->show();
+  forwardedWindow->raise();
+  forwardedWindow->activateWindow();
+}
+
+static void RestoreBackgroundWindows(const QList<SessionWindow> &savedWindows) {
+  StartupTrace::Scope traceScope("session restore");
+  QElapsedTimer restoreTimer;
+  restoreTimer.start();
+  // Each one is a window and an empty view, pages and renderers come once the user looks at it
+  for (qsizetype index = 1; index < savedWindows.size(); ++index) {
+    AppWindow *restoredWindow = new AppWindow(savedWindows.at(index));
+    // Extra windows live on the heap, so close can delete them safely
+    restoredWindow->setAttribute(Qt::WA_DeleteOnClose);
+    restoredWindow->show();
+  }
+  qCInfo(lcPerformance).noquote() << "Session restore:" << savedWindows.size() - 1
+                                  << "background windows deferred in" << restoreTimer.elapsed() << "ms";
+}
+
+static void TraceFirstWindowLoad(ChatView *chatView) {
+  if (chatView == nullptr) {
+    return;
+  }
+
+  // Page marks, paint timing, and navigation timing all live in the page timeline
+  static const QString pageEventsQuery = QStringLiteral(
+      "(() => {"
+      "  const events = [];"
+      "  const toEpoch = (time) => performance.timeOrigin + time;"
+      "  const ownEntries = performance.getEntriesByType('mark')"
+      "    .concat(performance.getEntriesByType('measure'))"
+      "    .filter((entry) => entry.name.startsWith('chatgpt-desktop:'));"
+      "  for (const entry of ownEntries) {"
+      "    events.push({ name: entry.name, ts: toEpoch(entry.startTime), dur: entry.duration });"
+      "  }"
+      "  for (const entry of performance.getEntriesByType('paint')) {"
+      "    events.push({ name: entry.name, ts: toEpoch(entry.startTime) });"
+      "  }"
+      "  const navigation = performance.getEntriesByType('navigation')[0];"
+      "  if (navigation) {"
+      "    events.push({ name: 'navigation', ts: toEpoch(navigation.startTime), dur: navigation.duration });"
+      "    events.push({ name: 'responseStart', ts: toEpoch(navigation.responseStart) });"
+      "    events.push({ name: 'domContentLoaded', ts: toEpoch(navigation.domContentLoadedEventEnd) });"
+      "  }"
+      "  return events;"
+      "})()");
+
+  QObject::connect(chatView, &QWebEngineView::loadStarted, chatView,
+                   []() { StartupTrace::Instant("first loadStarted"); }, Qt::SingleShotConnection);
+  QObject::connect(
+      chatView, &QWebEngineView::loadFinished, chatView,
+      [chatView]([[maybe_unused]] bool ok) {
+        StartupTrace::Instant("first loadFinished");
+        // The marks above also feed the metrics endpoint, only a trace needs the page timeline
+        if (!StartupTrace::IsEnabled()) {
+          return;
+        }
+        chatView->page()->runJavaScript(pageEventsQuery, QWebEngineScript::ApplicationWorld,
+                                        [](const QVariant &result) {
+                                          StartupTrace::MergePageEvents(result.toList());
+                                          StartupTrace::Finish();
+                                        });
+      },
+      Qt::SingleShotConnection);
+
+  // Write whatever was recorded when the app quits before the first load completes
+  QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit,
+                   []() { StartupTrace::Finish(); });
+}
+
 static void InstallSignalHandlers(QCoreApplication *application) {
   if (application == nullptr) {
     return;
@@ -163,7 +318,13 @@ static void HandleSignalNotification() {
   while (::read(signalPipeFileDescriptors[0], &signalByte, sizeof(signalByte)) > 0) {
   }
 
-  // One Qt quit is enough even if several signals arrived
-  QCoreApplication::quit();
+  // One drain is enough even if several signals arrived, a later signal cuts it short
+  QuitAfterShutdownDrain();
   signalSocketNotifier->setEnabled(true);
 }
+
+static void QuitAfterShutdownDrain() {
+  // The drain hides every window, so the layout is written first
+  SessionStore::Instance().Finish();
+  BrowserProfile::Instance().DrainForShutdown([]() { QCoreApplication::quit(); });
+}
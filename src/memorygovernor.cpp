@@ -0,0 +1,259 @@
+#include "memorygovernor.h"
+#include "chatview.h"
+#include "metrics.h"
+#include "perflog.h"
+#include "processstats.h"
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QIODevice>
+#include <QTimer>
+#include <QWebEnginePage>
+#include <algorithm>
+#include <utility>
+
+namespace {
+// PSI averages move over seconds, sampling faster only burns wakeups
+constexpr int kSampleIntervalMs = 2000;
+// Give Chromium a moment to unmap memory before the reclaim is measured
+constexpr int kReclaimMeasureDelayMs = 1500;
+// Out-of-view pages age into Discarded even without pressure
+constexpr qint64 kIdleDiscardAfterMs = 30 * 60 * 1000;
+constexpr qint64 kModerateDiscardAfterMs = 5 * 60 * 1000;
+// Cgroup usage ratios and PSI stall percentages that mark each pressure tier
+constexpr double kModerateUsageRatio = 0.80;
+constexpr double kCriticalUsageRatio = 0.92;
+constexpr double kModerateSomeAvg10 = 10.0;
+constexpr double kCriticalSomeAvg10 = 50.0;
+constexpr double kCriticalFullAvg10 = 10.0;
+
+QByteArray ReadSmallFile(const QString &path) {
+  if (path.isEmpty()) {
+    return QByteArray();
+  }
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return QByteArray();
+  }
+  return file.read(4096);
+}
+
+double ParseAvg10(const QByteArray &pressureText, const QByteArray &linePrefix) {
+  // PSI lines look like: some avg10=1.23 avg60=0.40 avg300=0.10 total=12345
+  for (const QByteArray &line : pressureText.split('\n')) {
+    if (!line.startsWith(linePrefix)) {
+      continue;
+    }
+    const qsizetype valueStart = line.indexOf("avg10=");
+    if (valueStart < 0) {
+      return 0.0;
+    }
+    const qsizetype valueEnd = line.indexOf(' ', valueStart);
+    return line.mid(valueStart + 6, valueEnd < 0 ? -1 : valueEnd - valueStart - 6).toDouble();
+  }
+  return 0.0;
+}
+
+QString PressureLevelName(MemoryGovernor::PressureLevel level) {
+  switch (level) {
+  case MemoryGovernor::PressureLevel::Critical:
+    return QStringLiteral("critical");
+  case MemoryGovernor::PressureLevel::Moderate:
+    return QStringLiteral("moderate");
+  case MemoryGovernor::PressureLevel::None:
+    break;
+  }
+  return QStringLiteral("none");
+}
+} // namespace
+
+MemoryGovernor &MemoryGovernor::Instance() {
+  // Function static gives one governor for the whole process
+  static MemoryGovernor instance;
+  return instance;
+}
+
+MemoryGovernor::MemoryGovernor() {
+  ResolveCgroupPaths();
+
+  m_sampleTimer = new QTimer(QCoreApplication::instance());
+  m_sampleTimer->setInterval(kSampleIntervalMs);
+  QObject::connect(m_sampleTimer, &QTimer::timeout, m_sampleTimer, [this]() { Evaluate(); });
+  m_sampleTimer->start();
+}
+
+void MemoryGovernor::Track(ChatView *view) {
+  if (view == nullptr) {
+    return;
+  }
+  m_views.append(view);
+}
+
+MemoryGovernor::PressureLevel MemoryGovernor::CurrentPressureLevel() const { return m_pressureLevel; }
+
+void MemoryGovernor::ResolveCgroupPaths() {
+  // System wide PSI is the fallback when the cgroup has no pressure file
+  m_pressurePath = QStringLiteral("/proc/pressure/memory");
+
+  // Only the unified cgroup v2 hierarchy has a single 0:: entry
+  const QByteArray cgroupText = ReadSmallFile(QStringLiteral("/proc/self/cgroup"));
+  for (const QByteArray &line : cgroupText.split('\n')) {
+    if (!line.startsWith("0::")) {
+      continue;
+    }
+
+    const QString cgroupRoot = QStringLiteral("/sys/fs/cgroup") + QString::fromUtf8(line.mid(3)).trimmed();
+    if (QFile::exists(cgroupRoot + QStringLiteral("/memory.pressure"))) {
+      // Per cgroup PSI tracks the user limit instead of the whole host
+      m_pressurePath = cgroupRoot + QStringLiteral("/memory.pressure");
+    }
+    if (QFile::exists(cgroupRoot + QStringLiteral("/memory.max"))) {
+      m_memoryCurrentPath = cgroupRoot + QStringLiteral("/memory.current");
+      m_memoryMaxPath = cgroupRoot + QStringLiteral("/memory.max");
+    }
+    break;
+  }
+}
+
+MemoryGovernor::PressureLevel MemoryGovernor::SamplePressureLevel() const {
+  double usageRatio = 0.0;
+  const QByteArray memoryMaxText = ReadSmallFile(m_memoryMaxPath).trimmed();
+  // A literal max means the cgroup has no limit to stay under
+  if (!memoryMaxText.isEmpty() && memoryMaxText != "max") {
+    const double memoryMax = memoryMaxText.toDouble();
+    const double memoryCurrent = ReadSmallFile(m_memoryCurrentPath).trimmed().toDouble();
+    if (memoryMax > 0.0) {
+      usageRatio = memoryCurrent / memoryMax;
+    }
+  }
+
+  const QByteArray pressureText = ReadSmallFile(m_pressurePath);
+  const double someAvg10 = ParseAvg10(pressureText, "some ");
+  const double fullAvg10 = ParseAvg10(pressureText, "full ");
+
+  if (usageRatio >= kCriticalUsageRatio || someAvg10 >= kCriticalSomeAvg10 || fullAvg10 >= kCriticalFullAvg10) {
+    return PressureLevel::Critical;
+  }
+  if (usageRatio >= kModerateUsageRatio || someAvg10 >= kModerateSomeAvg10) {
+    return PressureLevel::Moderate;
+  }
+  return PressureLevel::None;
+}
+
+void MemoryGovernor::Evaluate() {
+  m_views.removeIf([](const QPointer<ChatView> &view) { return view.isNull(); });
+  if (Metrics::IsServing()) {
+    PublishPageCensus();
+  }
+
+  const PressureLevel pressureLevel = SamplePressureLevel();
+  if (pressureLevel != m_pressureLevel) {
+    qCInfo(lcMemory) << "Memory pressure changed from" << PressureLevelName(m_pressureLevel) << "to"
+                     << PressureLevelName(pressureLevel);
+    m_pressureLevel = pressureLevel;
+  }
+
+  qint64 discardAfterMs = kIdleDiscardAfterMs;
+  int transitionBudget = 1;
+  if (pressureLevel == PressureLevel::Moderate) {
+    discardAfterMs = kModerateDiscardAfterMs;
+  } else if (pressureLevel == PressureLevel::Critical) {
+    // Under critical pressure every out-of-view page is fair game
+    discardAfterMs = 0;
+    transitionBudget = 3;
+  }
+
+  // Longest hidden pages go first, they are the least likely to be needed soon
+  QList<ChatView *> outOfViewViews;
+  for (const QPointer<ChatView> &view : std::as_const(m_views)) {
+    // Warm pool views sit on about:blank and hold almost nothing worth reclaiming
+    if (view->OutOfViewSinceMs() > 0 && view->url().scheme() != QStringLiteral("about")) {
+      outOfViewViews.append(view.data());
+    }
+  }
+  std::sort(outOfViewViews.begin(), outOfViewViews.end(), [](const ChatView *left, const ChatView *right) {
+    return left->OutOfViewSinceMs() < right->OutOfViewSinceMs();
+  });
+
+  const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+  for (ChatView *view : std::as_const(outOfViewViews)) {
+    if (transitionBudget <= 0) {
+      break;
+    }
+
+    QWebEnginePage *viewPage = view->page();
+    if (viewPage == nullptr) {
+      continue;
+    }
+
+    const qint64 outOfViewMs = nowMs - view->OutOfViewSinceMs();
+    const QWebEnginePage::LifecycleState currentState = viewPage->lifecycleState();
+    const bool shouldFreeze = currentState == QWebEnginePage::LifecycleState::Active;
+    const bool shouldDiscard =
+        currentState == QWebEnginePage::LifecycleState::Frozen && outOfViewMs >= discardAfterMs;
+    if (!shouldFreeze && !shouldDiscard) {
+      continue;
+    }
+
+    const qint64 processId = viewPage->renderProcessPid();
+    const qint64 residentBytesBefore = ProcessStats::ResidentBytes(processId);
+    const QString cause = QStringLiteral("pressure %1, out of view %2 s")
+                              .arg(PressureLevelName(pressureLevel))
+                              .arg(outOfViewMs / 1000);
+
+    if (shouldFreeze) {
+      // Pages normally freeze as they leave view, this catches any that did not
+      viewPage->setLifecycleState(QWebEnginePage::LifecycleState::Frozen);
+      ReportReclaim(view->url().toString(), QStringLiteral("Active -> Frozen"), cause, processId,
+                    residentBytesBefore);
+      --transitionBudget;
+      continue;
+    }
+
+    if (view->DiscardPage()) {
+      ReportReclaim(view->url().toString(), QStringLiteral("Frozen -> Discarded"), cause, processId,
+                    residentBytesBefore);
+      --transitionBudget;
+    }
+  }
+}
+
+void MemoryGovernor::PublishPageCensus() const {
+  // Only pids and states here, the scrape thread reads renderer memory itself
+  Metrics::PageCensus census;
+  for (const QPointer<ChatView> &view : std::as_const(m_views)) {
+    const QWebEnginePage *viewPage = view->page();
+    if (viewPage == nullptr) {
+      continue;
+    }
+    switch (viewPage->lifecycleState()) {
+    case QWebEnginePage::LifecycleState::Active:
+      ++census.activePages;
+      break;
+    case QWebEnginePage::LifecycleState::Frozen:
+      ++census.frozenPages;
+      break;
+    case QWebEnginePage::LifecycleState::Discarded:
+      ++census.discardedPages;
+      break;
+    }
+    if (viewPage->renderProcessPid() > 0) {
+      census.rendererPids.append(viewPage->renderProcessPid());
+    }
+  }
+  Metrics::PublishPageCensus(std::move(census));
+}
+
+void MemoryGovernor::ReportReclaim(const QString &url, const QString &transition, const QString &cause,
+                                   qint64 processId, qint64 residentBytesBefore) {
+  QTimer::singleShot(kReclaimMeasureDelayMs, m_sampleTimer,
+                     [url, transition, cause, processId, residentBytesBefore]() {
+                       // A renderer shared with other pages may keep most of its memory
+                       const qint64 residentBytesAfter = ProcessStats::ResidentBytes(processId);
+                       const qint64 reclaimedBytes = std::max<qint64>(0, residentBytesBefore - residentBytesAfter);
+                       qCInfo(lcMemory).noquote() << "Memory governor" << transition << url << "(" + cause + "),"
+                                                  << "reclaimed" << (reclaimedBytes / (1024 * 1024)) << "MiB";
+                     });
+}
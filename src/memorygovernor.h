@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QList>
+#include <QPointer>
+#include <QString>
+#include <QtGlobal>
+
+class ChatView;
+class QTimer;
+
+class MemoryGovernor final {
+public:
+  enum class PressureLevel { None, Moderate, Critical };
+
+  // One governor watches memory for every window in the process
+  static MemoryGovernor &Instance();
+
+  // Views register once and drop out on their own when deleted
+  void Track(ChatView *view);
+  PressureLevel CurrentPressureLevel() const;
+
+private:
+  MemoryGovernor();
+  ~MemoryGovernor() = default;
+
+  // Find this process cgroup once so each sample is two small file reads
+  void ResolveCgroupPaths();
+  PressureLevel SamplePressureLevel() const;
+  // Push out-of-view pages one tier further when pressure or idle time says so
+  void Evaluate();
+  // Hand page states and renderer pids to the metrics endpoint
+  void PublishPageCensus() const;
+  // Log the transition once the renderer had time to give memory back
+  void ReportReclaim(const QString &url, const QString &transition, const QString &cause, qint64 processId,
+                     qint64 residentBytesBefore);
+
+  QList<QPointer<ChatView>> m_views;
+  QTimer *m_sampleTimer = nullptr;
+  QString m_pressurePath;
+  QString m_memoryCurrentPath;
+  QString m_memoryMaxPath;
+  PressureLevel m_pressureLevel = PressureLevel::None;
+};
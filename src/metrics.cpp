@@ -0,0 +1,461 @@
+#include "metrics.h"
+#include "perflog.h"
+#include "processstats.h"
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QObject>
+#include <QString>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+constexpr auto kSocketName = "chatgpt-desktop-unix-metrics.sock";
+constexpr int kListenBacklog = 8;
+// Plain readers like socat send nothing, so a short wait tells them apart from HTTP clients
+constexpr int kRequestWaitMs = 200;
+// A scraper that stops reading must not hold the serving thread
+constexpr int kWriteTimeoutMs = 1000;
+constexpr int kHistogramBounds = 6;
+
+struct CounterInfo {
+  const char *family;
+  const char *labels;
+  const char *help;
+};
+
+// Entries of one family sit next to each other so HELP and TYPE are written once
+constexpr CounterInfo kCounters[] = {
+    {"chatgpt_desktop_page_lifecycle_changes_total", "state=\"frozen\"", "Page lifecycle changes by entered state"},
+    {"chatgpt_desktop_page_lifecycle_changes_total", "state=\"active\"", nullptr},
+    {"chatgpt_desktop_page_lifecycle_changes_total", "state=\"discarded\"", nullptr},
+    {"chatgpt_desktop_clipboard_bridge_calls_total", "path=\"prompt\",result=\"ok\"",
+     "Code copies through the clipboard bridge"},
+    {"chatgpt_desktop_clipboard_bridge_calls_total", "path=\"prompt\",result=\"rejected\"", nullptr},
+    {"chatgpt_desktop_clipboard_bridge_calls_total", "path=\"channel\",result=\"ok\"", nullptr},
+    {"chatgpt_desktop_clipboard_bridge_calls_total", "path=\"channel\",result=\"rejected\"", nullptr},
+    {"chatgpt_desktop_downloads_total", "result=\"started\"", "Downloads by outcome"},
+    {"chatgpt_desktop_downloads_total", "result=\"completed\"", nullptr},
+    {"chatgpt_desktop_downloads_total", "result=\"failed\"", nullptr},
+    {"chatgpt_desktop_download_bytes_total", "", "Bytes received by completed downloads"},
+    {"chatgpt_desktop_cookie_changes_total", "", "Cookies added or removed in the profile"},
+    {"chatgpt_desktop_intercepted_requests_total", "action=\"blocked\"", "Requests checked against the block rules"},
+    {"chatgpt_desktop_intercepted_requests_total", "action=\"allowed\"", nullptr},
+};
+static_assert(std::size(kCounters) == static_cast<size_t>(Metrics::Counter::Count));
+
+struct HistogramInfo {
+  const char *family;
+  const char *help;
+  std::array<quint64, kHistogramBounds> bounds;
+};
+
+constexpr HistogramInfo kHistograms[] = {
+    {"chatgpt_desktop_clipboard_payload_bytes", "Size of each clipboard bridge copy",
+     {1024, 16 * 1024, 256 * 1024, 1024 * 1024, 8 * 1024 * 1024, 64 * 1024 * 1024}},
+    {"chatgpt_desktop_download_throughput_bytes_per_second", "Average throughput of each completed download",
+     {64 * 1024, 256 * 1024, 1024 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024, 64 * 1024 * 1024}},
+};
+static_assert(std::size(kHistograms) == static_cast<size_t>(Metrics::Histogram::Count));
+
+struct HistogramState {
+  // One slot per bound plus the overflow slot, made cumulative only when rendered
+  std::array<std::atomic<quint64>, kHistogramBounds + 1> buckets{};
+  std::atomic<quint64> count{0};
+  std::atomic<quint64> sum{0};
+};
+
+std::array<std::atomic<quint64>, std::size(kCounters)> g_counters{};
+std::array<HistogramState, std::size(kHistograms)> g_histograms;
+std::atomic<bool> g_serving{false};
+
+// Startup timings and the page census change rarely, a plain lock keeps them simple
+struct SharedState {
+  std::mutex mutex;
+  std::vector<std::pair<QByteArray, double>> startupPhaseSeconds;
+  std::vector<std::pair<QByteArray, double>> startupMarkSeconds;
+  Metrics::PageCensus census;
+};
+
+SharedState &Shared() {
+  static SharedState state;
+  return state;
+}
+
+struct ServerState {
+  QByteArray socketPath;
+  int listenDescriptor = -1;
+  int wakeDescriptors[2] = {-1, -1};
+  std::thread thread;
+
+  // Normal quits stop the thread first, this only covers exits that skip aboutToQuit
+  ~ServerState() {
+    if (thread.joinable()) {
+      thread.detach();
+    }
+  }
+};
+
+ServerState &Server() {
+  static ServerState state;
+  return state;
+}
+
+void RecordFirst(std::vector<std::pair<QByteArray, double>> &entries, const char *name, double seconds) {
+  const QByteArray key(name);
+  const bool known = std::any_of(entries.begin(), entries.end(), [&key](const auto &entry) {
+    return entry.first == key;
+  });
+  if (!known) {
+    entries.emplace_back(key, seconds);
+  }
+}
+
+QByteArray EscapeLabelValue(const QByteArray &value) {
+  QByteArray escaped = value;
+  escaped.replace('\\', "\\\\");
+  escaped.replace('"', "\\\"");
+  escaped.replace('\n', "\\n");
+  return escaped;
+}
+
+void AppendFamilyHeader(QByteArray &text, const char *family, const char *help, const char *type) {
+  text += "# HELP ";
+  text += family;
+  text += ' ';
+  text += help;
+  text += "\n# TYPE ";
+  text += family;
+  text += ' ';
+  text += type;
+  text += '\n';
+}
+
+void AppendSample(QByteArray &text, const char *family, const QByteArray &labels, double value) {
+  text += family;
+  if (!labels.isEmpty()) {
+    text += '{' + labels + '}';
+  }
+  text += ' ';
+  text += QByteArray::number(value, 'g', 15);
+  text += '\n';
+}
+
+void AppendLabeledGauges(QByteArray &text, const char *family, const char *help, const char *labelName,
+                         const std::vector<std::pair<QByteArray, double>> &entries) {
+  if (entries.empty()) {
+    return;
+  }
+  AppendFamilyHeader(text, family, help, "gauge");
+  for (const auto &entry : entries) {
+    AppendSample(text, family, QByteArray(labelName) + "=\"" + EscapeLabelValue(entry.first) + '"', entry.second);
+  }
+}
+
+// Runs on the serving thread, everything it reads is atomic or behind the shared lock
+QByteArray RenderPrometheusText() {
+  QByteArray text;
+  text.reserve(8 * 1024);
+
+  for (size_t index = 0; index < std::size(kCounters); ++index) {
+    const CounterInfo &info = kCounters[index];
+    if (info.help != nullptr) {
+      AppendFamilyHeader(text, info.family, info.help, "counter");
+    }
+    AppendSample(text, info.family, QByteArray(info.labels),
+                 static_cast<double>(g_counters[index].load(std::memory_order_relaxed)));
+  }
+
+  for (size_t index = 0; index < std::size(kHistograms); ++index) {
+    const HistogramInfo &info = kHistograms[index];
+    const HistogramState &state = g_histograms[index];
+    AppendFamilyHeader(text, info.family, info.help, "histogram");
+    const QByteArray bucketFamily = QByteArray(info.family) + "_bucket";
+    quint64 cumulative = 0;
+    for (int bucket = 0; bucket <= kHistogramBounds; ++bucket) {
+      cumulative += state.buckets[bucket].load(std::memory_order_relaxed);
+      const QByteArray bound =
+          bucket < kHistogramBounds ? QByteArray::number(info.bounds[bucket]) : QByteArrayLiteral("+Inf");
+      AppendSample(text, bucketFamily.constData(), "le=\"" + bound + '"', static_cast<double>(cumulative));
+    }
+    AppendSample(text, (QByteArray(info.family) + "_sum").constData(), QByteArray(),
+                 static_cast<double>(state.sum.load(std::memory_order_relaxed)));
+    AppendSample(text, (QByteArray(info.family) + "_count").constData(), QByteArray(),
+                 static_cast<double>(state.count.load(std::memory_order_relaxed)));
+  }
+
+  SharedState &shared = Shared();
+  Metrics::PageCensus census;
+  std::vector<std::pair<QByteArray, double>> phaseSeconds;
+  std::vector<std::pair<QByteArray, double>> markSeconds;
+  {
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    census = shared.census;
+    phaseSeconds = shared.startupPhaseSeconds;
+    markSeconds = shared.startupMarkSeconds;
+  }
+
+  // Several pages can share one renderer, its memory only counts once
+  std::sort(census.rendererPids.begin(), census.rendererPids.end());
+  census.rendererPids.erase(std::unique(census.rendererPids.begin(), census.rendererPids.end()),
+                            census.rendererPids.end());
+  qint64 rendererBytes = 0;
+  for (const qint64 processId : std::as_const(census.rendererPids)) {
+    rendererBytes += std::max<qint64>(0, ProcessStats::ResidentBytes(processId));
+  }
+  AppendFamilyHeader(text, "chatgpt_desktop_pages", "Pages per lifecycle state", "gauge");
+  AppendSample(text, "chatgpt_desktop_pages", "state=\"active\"", census.activePages);
+  AppendSample(text, "chatgpt_desktop_pages", "state=\"frozen\"", census.frozenPages);
+  AppendSample(text, "chatgpt_desktop_pages", "state=\"discarded\"", census.discardedPages);
+  AppendFamilyHeader(text, "chatgpt_desktop_renderer_processes", "Renderer processes behind live pages", "gauge");
+  AppendSample(text, "chatgpt_desktop_renderer_processes", QByteArray(),
+               static_cast<double>(census.rendererPids.size()));
+  AppendFamilyHeader(text, "chatgpt_desktop_renderer_resident_bytes", "Resident memory of those renderers",
+                     "gauge");
+  AppendSample(text, "chatgpt_desktop_renderer_resident_bytes", QByteArray(), static_cast<double>(rendererBytes));
+  AppendFamilyHeader(text, "chatgpt_desktop_browser_resident_bytes", "Resident memory of the app process", "gauge");
+  AppendSample(text, "chatgpt_desktop_browser_resident_bytes", QByteArray(),
+               static_cast<double>(ProcessStats::ResidentBytes(QCoreApplication::applicationPid())));
+
+  AppendLabeledGauges(text, "chatgpt_desktop_startup_phase_seconds", "Duration of each startup phase", "phase",
+                      phaseSeconds);
+  AppendLabeledGauges(text, "chatgpt_desktop_startup_mark_seconds", "Time from launch to each startup mark",
+                      "mark", markSeconds);
+  return text;
+}
+
+QString ResolveSocketPath(const QString &socketName) {
+  // The runtime dir is private to the user and cleared on logout
+  const QString runtimeRoot = qEnvironmentVariable("XDG_RUNTIME_DIR");
+  if (!runtimeRoot.isEmpty()) {
+    return QDir(runtimeRoot).filePath(socketName);
+  }
+  // Keep the fallback name per user so shared temp dirs do not mix owners
+  return QDir(QDir::tempPath()).filePath(QStringLiteral("%1-%2").arg(::getuid()).arg(socketName));
+}
+
+bool FillAddress(const QByteArray &socketPath, sockaddr_un &address) {
+  if (socketPath.isEmpty() || static_cast<size_t>(socketPath.size()) >= sizeof(address.sun_path)) {
+    return false;
+  }
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, socketPath.constData(), static_cast<size_t>(socketPath.size()));
+  return true;
+}
+
+bool IsSocketAnswering(const sockaddr_un &address) {
+  const int probeDescriptor = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (probeDescriptor < 0) {
+    return false;
+  }
+  const bool answering =
+      ::connect(probeDescriptor, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+  ::close(probeDescriptor);
+  return answering;
+}
+
+// A stale socket from a crashed run is replaced, a live one from another instance is left alone
+int BindListeningSocket(const QByteArray &socketPath) {
+  sockaddr_un address{};
+  if (!FillAddress(socketPath, address)) {
+    return -1;
+  }
+  const int listenDescriptor = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listenDescriptor < 0) {
+    return -1;
+  }
+  const auto bindAddress = [&]() {
+    return ::bind(listenDescriptor, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+  };
+  bool bound = bindAddress();
+  if (!bound && errno == EADDRINUSE && !IsSocketAnswering(address)) {
+    ::unlink(socketPath.constData());
+    bound = bindAddress();
+  }
+  // Scrapes run as the same user, nobody else gets to read window and download activity
+  if (!bound || ::chmod(socketPath.constData(), S_IRUSR | S_IWUSR) != 0 ||
+      ::listen(listenDescriptor, kListenBacklog) != 0) {
+    ::close(listenDescriptor);
+    return -1;
+  }
+  return listenDescriptor;
+}
+
+bool SendAll(int socketDescriptor, const QByteArray &bytes) {
+  qsizetype offset = 0;
+  pollfd pollDescriptor{};
+  pollDescriptor.fd = socketDescriptor;
+  pollDescriptor.events = POLLOUT;
+  while (offset < bytes.size()) {
+    const int ready = ::poll(&pollDescriptor, 1, kWriteTimeoutMs);
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ready <= 0) {
+      return false;
+    }
+    const ssize_t sent = ::send(socketDescriptor, bytes.constData() + offset,
+                                static_cast<size_t>(bytes.size() - offset), MSG_NOSIGNAL);
+    if (sent < 0 && (errno == EINTR || errno == EAGAIN)) {
+      continue;
+    }
+    if (sent <= 0) {
+      return false;
+    }
+    offset += sent;
+  }
+  return true;
+}
+
+void ServeConnection(int connectionDescriptor) {
+  // curl --unix-socket sends an HTTP request, socat and nc just read
+  char request[16] = {};
+  pollfd pollDescriptor{};
+  pollDescriptor.fd = connectionDescriptor;
+  pollDescriptor.events = POLLIN;
+  ssize_t requestBytes = 0;
+  if (::poll(&pollDescriptor, 1, kRequestWaitMs) > 0) {
+    requestBytes = ::recv(connectionDescriptor, request, sizeof(request), 0);
+  }
+
+  const QByteArray body = RenderPrometheusText();
+  QByteArray response;
+  if (requestBytes >= 4 && std::memcmp(request, "GET ", 4) == 0) {
+    response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: " +
+               QByteArray::number(body.size()) + "\r\nConnection: close\r\n\r\n";
+  }
+  response += body;
+  SendAll(connectionDescriptor, response);
+  ::close(connectionDescriptor);
+}
+
+void ServeUntilWoken(int listenDescriptor, int wakeDescriptor) {
+  pollfd pollDescriptors[2] = {};
+  pollDescriptors[0].fd = listenDescriptor;
+  pollDescriptors[0].events = POLLIN;
+  pollDescriptors[1].fd = wakeDescriptor;
+  pollDescriptors[1].events = POLLIN;
+  while (true) {
+    const int ready = ::poll(pollDescriptors, 2, -1);
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ready < 0 || pollDescriptors[1].revents != 0) {
+      return;
+    }
+    if ((pollDescriptors[0].revents & POLLIN) == 0) {
+      continue;
+    }
+    // Scrapes are rare and tiny, one at a time keeps the thread count at one
+    const int connectionDescriptor = ::accept4(listenDescriptor, nullptr, nullptr, SOCK_CLOEXEC);
+    if (connectionDescriptor >= 0) {
+      ServeConnection(connectionDescriptor);
+    }
+  }
+}
+
+void StopServing() {
+  ServerState &server = Server();
+  if (!server.thread.joinable()) {
+    return;
+  }
+  const char wakeByte = 0;
+  [[maybe_unused]] const ssize_t written = ::write(server.wakeDescriptors[1], &wakeByte, sizeof(wakeByte));
+  server.thread.join();
+  ::close(server.listenDescriptor);
+  ::close(server.wakeDescriptors[0]);
+  ::close(server.wakeDescriptors[1]);
+  ::unlink(server.socketPath.constData());
+  g_serving.store(false, std::memory_order_relaxed);
+}
+} // namespace
+
+namespace Metrics {
+
+void Increment(Counter counter, quint64 amount) {
+  g_counters[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+}
+
+void Observe(Histogram histogram, quint64 value) {
+  const size_t index = static_cast<size_t>(histogram);
+  const auto &bounds = kHistograms[index].bounds;
+  const size_t bucket = std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+  HistogramState &state = g_histograms[index];
+  state.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  state.count.fetch_add(1, std::memory_order_relaxed);
+  state.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+void RecordStartupPhase(const char *phaseName, qint64 durationUs) {
+  SharedState &shared = Shared();
+  std::lock_guard<std::mutex> lock(shared.mutex);
+  RecordFirst(shared.startupPhaseSeconds, phaseName, static_cast<double>(durationUs) / 1e6);
+}
+
+void RecordStartupMark(const char *markName, qint64 sinceLaunchUs) {
+  SharedState &shared = Shared();
+  std::lock_guard<std::mutex> lock(shared.mutex);
+  RecordFirst(shared.startupMarkSeconds, markName, static_cast<double>(sinceLaunchUs) / 1e6);
+}
+
+void PublishPageCensus(PageCensus census) {
+  SharedState &shared = Shared();
+  std::lock_guard<std::mutex> lock(shared.mutex);
+  shared.census = std::move(census);
+}
+
+bool IsServingEnabled() {
+  const QString value = qEnvironmentVariable("CHATGPT_DESKTOP_METRICS").trimmed().toLower();
+  return value == QStringLiteral("1") || value == QStringLiteral("true") || value == QStringLiteral("on");
+}
+
+bool IsServing() { return g_serving.load(std::memory_order_relaxed); }
+
+void StartServing(QObject *parent) {
+  ServerState &server = Server();
+  if (server.thread.joinable()) {
+    return;
+  }
+
+  // A second instance on an isolated profile serves next to the first one instead of replacing it
+  server.socketPath = QFile::encodeName(ResolveSocketPath(QString::fromLatin1(kSocketName)));
+  server.listenDescriptor = BindListeningSocket(server.socketPath);
+  if (server.listenDescriptor < 0) {
+    server.socketPath = QFile::encodeName(ResolveSocketPath(
+        QStringLiteral("chatgpt-desktop-unix-metrics-%1.sock").arg(QCoreApplication::applicationPid())));
+    server.listenDescriptor = BindListeningSocket(server.socketPath);
+  }
+  if (server.listenDescriptor < 0) {
+    qWarning() << "Failed to listen for metrics scrapes:" << server.socketPath << std::strerror(errno);
+    return;
+  }
+  if (::pipe2(server.wakeDescriptors, O_CLOEXEC) != 0) {
+    ::close(server.listenDescriptor);
+    ::unlink(server.socketPath.constData());
+    return;
+  }
+
+  g_serving.store(true, std::memory_order_relaxed);
+  server.thread = std::thread(ServeUntilWoken, server.listenDescriptor, server.wakeDescriptors[0]);
+  QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, parent, []() { StopServing(); });
+  qCInfo(lcPerformance).noquote() << "Serving metrics on" << QString::fromLocal8Bit(server.socketPath);
+}
+
+} // namespace Metrics
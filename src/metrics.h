@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QList>
+#include <QtGlobal>
+
+class QObject;
+
+namespace Metrics {
+
+// Recording is a relaxed atomic add, cheap enough to stay on everywhere and on any thread
+enum class Counter {
+  PagesFrozen,
+  PagesResumed,
+  PagesDiscarded,
+  ClipboardPromptCopies,
+  ClipboardPromptRejected,
+  ClipboardChannelCopies,
+  ClipboardChannelRejected,
+  DownloadsStarted,
+  DownloadsCompleted,
+  DownloadsFailed,
+  DownloadBytes,
+  CookieChanges,
+  RequestsBlocked,
+  RequestsAllowed,
+  Count
+};
+
+enum class Histogram { ClipboardPayloadBytes, DownloadBytesPerSecond, Count };
+
+// Live pages and their renderers, published by the memory governor pass while serving
+struct PageCensus {
+  QList<qint64> rendererPids;
+  int activePages = 0;
+  int frozenPages = 0;
+  int discardedPages = 0;
+};
+
+void Increment(Counter counter, quint64 amount = 1);
+void Observe(Histogram histogram, quint64 value);
+// Only the first run of a phase counts, later windows repeat some of them
+void RecordStartupPhase(const char *phaseName, qint64 durationUs);
+// Point in time since launch, such as the first finished load
+void RecordStartupMark(const char *markName, qint64 sinceLaunchUs);
+void PublishPageCensus(PageCensus census);
+
+// Serving is opt in with CHATGPT_DESKTOP_METRICS=1
+bool IsServingEnabled();
+bool IsServing();
+// Prometheus text on a per-user Unix socket, answered from a background thread until the app quits
+void StartServing(QObject *parent);
+
+} // namespace Metrics
@@ -0,0 +1,4 @@
+#include "perflog.h"
+
+Q_LOGGING_CATEGORY(lcPerformance, "chatgpt-desktop.performance", QtWarningMsg)
+Q_LOGGING_CATEGORY(lcMemory, "chatgpt-desktop.memory", QtInfoMsg)
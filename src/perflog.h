@@ -0,0 +1,8 @@
+#pragma once
+
+#include <QLoggingCategory>
+
+// Performance notes stay quiet unless QT_LOGGING_RULES enables chatgpt-desktop.performance.info
+Q_DECLARE_LOGGING_CATEGORY(lcPerformance)
+// Memory reclaim decisions are logged by default so OOM reports can be traced back
+Q_DECLARE_LOGGING_CATEGORY(lcMemory)
@@ -0,0 +1,148 @@
+#include "performancehud.h"
+#include "chatview.h"
+#include "processstats.h"
+
+#include <QEvent>
+#include <QFontDatabase>
+#include <QLabel>
+#include <QStringList>
+#include <QTimer>
+#include <QVBoxLayout>
+#include <QVariant>
+#include <QWebEnginePage>
+#include <QWebEngineScript>
+#include <QWidget>
+#include <algorithm>
+#include <utility>
+
+namespace {
+constexpr int kSampleIntervalMs = 1000;
+constexpr int kHudMargin = 12;
+const QString kSampleQuery = QStringLiteral("globalThis.__chatgptDesktopHudSample"
+                                            " ? globalThis.__chatgptDesktopHudSample() : null");
+const QString kMissingValue = QStringLiteral("-");
+
+QString LifecycleName(QWebEnginePage::LifecycleState state) {
+  switch (state) {
+  case QWebEnginePage::LifecycleState::Active:
+    return QStringLiteral("active");
+  case QWebEnginePage::LifecycleState::Frozen:
+    return QStringLiteral("frozen");
+  case QWebEnginePage::LifecycleState::Discarded:
+    return QStringLiteral("discarded");
+  }
+  return kMissingValue;
+}
+
+// Page values are null when the browser does not expose them
+QString FormatNumber(const QVariant &value, int precision) {
+  return value.isValid() && !value.isNull() ? QString::number(value.toDouble(), 'f', precision) : kMissingValue;
+}
+
+QString FormatMib(const QVariant &bytes) {
+  if (!bytes.isValid() || bytes.isNull()) {
+    return kMissingValue;
+  }
+  return QString::number(bytes.toDouble() / (1024.0 * 1024.0), 'f', 1) + QStringLiteral(" MiB");
+}
+} // namespace
+
+PerformanceHud::PerformanceHud(ViewProvider currentView, QWidget *parent)
+    : QFrame(parent), m_currentView(std::move(currentView)) {
+  setFrameShape(QFrame::StyledPanel);
+  setAutoFillBackground(true);
+  // Reading the numbers must never take clicks away from the page underneath
+  setAttribute(Qt::WA_TransparentForMouseEvents);
+
+  m_label = new QLabel(this);
+  m_label->setTextFormat(Qt::PlainText);
+  m_label->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  auto *layout = new QVBoxLayout(this);
+  layout->addWidget(m_label);
+
+  m_sampleTimer = new QTimer(this);
+  m_sampleTimer->setInterval(kSampleIntervalMs);
+  connect(m_sampleTimer, &QTimer::timeout, this, [this]() { Sample(); });
+  parent->installEventFilter(this);
+  hide();
+}
+
+void PerformanceHud::Toggle() {
+  if (isVisible()) {
+    m_sampleTimer->stop();
+    hide();
+    return;
+  }
+  Sample();
+  show();
+  raise();
+  m_sampleTimer->start();
+}
+
+bool PerformanceHud::eventFilter(QObject *watched, QEvent *event) {
+  if (watched == parent() && event->type() == QEvent::Resize && isVisible()) {
+    UpdateGeometry();
+  }
+  return QFrame::eventFilter(watched, event);
+}
+
+void PerformanceHud::Sample() {
+  ChatView *view = m_currentView ? m_currentView() : nullptr;
+  QWebEnginePage *page = view != nullptr && !view->IsLoadDeferred() ? view->page() : nullptr;
+  if (page != m_sampledPage) {
+    // Tab switches and pool swaps bring a new page, old numbers would be misleading
+    m_pageStats.clear();
+    m_sampledPage = page;
+  }
+  Render(page);
+  // Frozen and discarded pages run no script, their last numbers stay up
+  if (page == nullptr || page->lifecycleState() != QWebEnginePage::LifecycleState::Active) {
+    return;
+  }
+
+  page->runJavaScript(kSampleQuery, QWebEngineScript::ApplicationWorld, [this, page](const QVariant &result) {
+    if (page != m_sampledPage || !isVisible()) {
+      return;
+    }
+    m_pageStats = result.toMap();
+    Render(page);
+  });
+}
+
+void PerformanceHud::Render(const QWebEnginePage *page) {
+  if (page == nullptr) {
+    m_label->setText(QStringLiteral("No page"));
+    UpdateGeometry();
+    return;
+  }
+
+  const qint64 rendererPid = page->renderProcessPid();
+  const qint64 rendererBytes = rendererPid > 0 ? ProcessStats::ResidentBytes(rendererPid) : 0;
+  const QVariant managedTurns = m_pageStats.value(QStringLiteral("managedTurns"));
+  const QString longChatLine =
+      managedTurns.isValid() && !managedTurns.isNull()
+          ? QStringLiteral("%1 managed").arg(managedTurns.toInt())
+          : kMissingValue;
+  const QStringList lines = {
+      QStringLiteral("renderer   pid %1, %2")
+          .arg(rendererPid > 0 ? QString::number(rendererPid) : kMissingValue,
+               rendererBytes > 0 ? FormatMib(rendererBytes) : kMissingValue),
+      QStringLiteral("lifecycle  %1").arg(LifecycleName(page->lifecycleState())),
+      QStringLiteral("js heap    %1").arg(FormatMib(m_pageStats.value(QStringLiteral("usedJsHeapBytes")))),
+      QStringLiteral("fps        %1").arg(FormatNumber(m_pageStats.value(QStringLiteral("fps")), 1)),
+      QStringLiteral("long tasks %1/min, %2 ms in 5 s")
+          .arg(FormatNumber(m_pageStats.value(QStringLiteral("longTasksPerMinute")), 1),
+               FormatNumber(m_pageStats.value(QStringLiteral("longTaskMs")), 0)),
+      QStringLiteral("turns      %1").arg(longChatLine),
+      QStringLiteral("dom        %1 elements")
+          .arg(FormatNumber(m_pageStats.value(QStringLiteral("documentElements")), 0)),
+  };
+  m_label->setText(lines.join(QLatin1Char('\n')));
+  UpdateGeometry();
+}
+
+void PerformanceHud::UpdateGeometry() {
+  const QWidget *host = parentWidget();
+  adjustSize();
+  move(std::max(0, host->width() - width() - kHudMargin), kHudMargin);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QFrame>
+#include <QPointer>
+#include <QVariantMap>
+#include <functional>
+
+class ChatView;
+class QEvent;
+class QLabel;
+class QObject;
+class QTimer;
+class QWebEnginePage;
+class QWidget;
+
+// Renderer, heap and frame numbers for the current view, drawn over the window corner
+class PerformanceHud final : public QFrame {
+public:
+  using ViewProvider = std::function<ChatView *()>;
+
+  PerformanceHud(ViewProvider currentView, QWidget *parent);
+
+  // Sampling only runs while the HUD is visible, the page side stops itself soon after
+  void Toggle();
+
+protected:
+  // Keeps the HUD pinned to the parent's top right corner
+  bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+  void Sample();
+  void Render(const QWebEnginePage *page);
+  void UpdateGeometry();
+
+  ViewProvider m_currentView;
+  QLabel *m_label = nullptr;
+  QTimer *m_sampleTimer = nullptr;
+  QPointer<QWebEnginePage> m_sampledPage;
+  // Last answer from the page script, kept while the page is frozen
+  QVariantMap m_pageStats;
+};
@@ -0,0 +1,69 @@
+#include "processstats.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QList>
+#include <QString>
+#include <unistd.h>
+
+namespace ProcessStats {
+
+qint64 ResidentBytes(qint64 processId) {
+  if (processId <= 0) {
+    return 0;
+  }
+
+  // statm is one short line, much cheaper to parse than status
+  QFile statmFile(QStringLiteral("/proc/%1/statm").arg(processId));
+  if (!statmFile.open(QIODevice::ReadOnly)) {
+    return 0;
+  }
+
+  const QList<QByteArray> fields = statmFile.readLine().split(' ');
+  if (fields.size() < 2) {
+    return 0;
+  }
+
+  bool parsed = false;
+  const qint64 residentPages = fields.at(1).toLongLong(&parsed);
+  if (!parsed) {
+    return 0;
+  }
+  return residentPages * static_cast<qint64>(::sysconf(_SC_PAGESIZE));
+}
+
+qint64 CpuTimeMs(qint64 processId) {
+  if (processId <= 0) {
+    return -1;
+  }
+
+  QFile statFile(QStringLiteral("/proc/%1/stat").arg(processId));
+  if (!statFile.open(QIODevice::ReadOnly)) {
+    return -1;
+  }
+
+  // The command name can hold spaces, so fields are counted from its closing paren
+  const QByteArray statLine = statFile.readLine();
+  const qsizetype commandEnd = statLine.lastIndexOf(')');
+  if (commandEnd < 0) {
+    return -1;
+  }
+  const QList<QByteArray> fields = statLine.mid(commandEnd + 2).split(' ');
+  // utime and stime are fields 14 and 15, the first field after the paren is field 3
+  if (fields.size() < 13) {
+    return -1;
+  }
+
+  bool userParsed = false;
+  bool systemParsed = false;
+  const qint64 userTicks = fields.at(11).toLongLong(&userParsed);
+  const qint64 systemTicks = fields.at(12).toLongLong(&systemParsed);
+  const qint64 ticksPerSecond = ::sysconf(_SC_CLK_TCK);
+  if (!userParsed || !systemParsed || ticksPerSecond <= 0) {
+    return -1;
+  }
+  return (userTicks + systemTicks) * 1000 / ticksPerSecond;
+}
+
+} // namespace ProcessStats
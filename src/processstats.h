@@ -0,0 +1,12 @@
+#pragma once
+
+#include <QtGlobal>
+
+namespace ProcessStats {
+
+// Resident set size from /proc, or 0 when the process is gone
+qint64 ResidentBytes(qint64 processId);
+// User plus system CPU time from /proc, or -1 when the process is gone
+qint64 CpuTimeMs(qint64 processId);
+
+} // namespace ProcessStats
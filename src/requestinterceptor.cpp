@@ -0,0 +1,120 @@
+#include "requestinterceptor.h"
+#include "assetstore.h"
+#include "metrics.h"
+#include "perflog.h"
+#include "trustedorigins.h"
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QIODevice>
+#include <QList>
+#include <QPair>
+#include <QUrl>
+#include <QWebEngineUrlRequestInfo>
+#include <algorithm>
+#include <utility>
+
+namespace {
+constexpr auto kRulesFileName = "request-rules.txt";
+constexpr int kLoggedHosts = 10;
+
+// The store scheme gets no CSP bypass, scripts pass the site's nonce policy from any URL but styles and fonts would not
+bool IsStorableResourceType(QWebEngineUrlRequestInfo::ResourceType resourceType) {
+  switch (resourceType) {
+  case QWebEngineUrlRequestInfo::ResourceTypeScript:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Pages and frames are what the user sees, a rule must never take one down
+bool IsNavigation(QWebEngineUrlRequestInfo::ResourceType resourceType) {
+  return resourceType == QWebEngineUrlRequestInfo::ResourceTypeMainFrame ||
+         resourceType == QWebEngineUrlRequestInfo::ResourceTypeSubFrame;
+}
+} // namespace
+
+bool RequestInterceptor::IsBlockingEnabled() {
+  const QString value = qEnvironmentVariable("CHATGPT_DESKTOP_BLOCK_ANALYTICS").trimmed().toLower();
+  return value == QStringLiteral("1") || value == QStringLiteral("true") || value == QStringLiteral("on");
+}
+
+RequestRuleSet RequestInterceptor::LoadBlockRules(const QString &storagePath) {
+  QString rulesPath = qEnvironmentVariable("CHATGPT_DESKTOP_BLOCK_RULES");
+  if (rulesPath.isEmpty()) {
+    rulesPath = QDir(storagePath).filePath(QString::fromLatin1(kRulesFileName));
+  }
+
+  QFile rulesFile(rulesPath);
+  if (!rulesFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    if (qEnvironmentVariableIsSet("CHATGPT_DESKTOP_BLOCK_RULES")) {
+      qWarning() << "Failed to open request rules file, using the built-in rules:" << rulesPath;
+    }
+    return RequestRuleSet::Defaults();
+  }
+  const RequestRuleSet rules = RequestRuleSet::Compile(QString::fromUtf8(rulesFile.readAll()));
+  qCInfo(lcPerformance).noquote() << "Loaded" << rules.RuleCount() << "request rules from" << rulesPath;
+  return rules;
+}
+
+RequestInterceptor::RequestInterceptor(bool serveStoredAssets, std::optional<RequestRuleSet> blockRules,
+                                       QObject *parent)
+    : QWebEngineUrlRequestInterceptor(parent), m_serveStoredAssets(serveStoredAssets),
+      m_blockRules(std::move(blockRules)) {
+  if (m_blockRules.has_value()) {
+    QObject::connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, this, [this]() { LogCounters(); });
+  }
+}
+
+void RequestInterceptor::interceptRequest(QWebEngineUrlRequestInfo &info) {
+  const QUrl requestUrl = info.requestUrl();
+  if (m_blockRules.has_value() && !IsNavigation(info.resourceType())) {
+    const QString host = requestUrl.host();
+    if (m_blockRules->Matches(QStringView(host), QStringView(requestUrl.path()))) {
+      {
+        const std::lock_guard<std::mutex> lock(m_blockedMutex);
+        ++m_blockedByHost[host];
+      }
+      Metrics::Increment(Metrics::Counter::RequestsBlocked);
+      info.block(true);
+      return;
+    }
+    m_allowedRequests.fetch_add(1, std::memory_order_relaxed);
+    Metrics::Increment(Metrics::Counter::RequestsAllowed);
+  }
+
+  // Only loads made for trusted pages go through the shared store
+  if (m_serveStoredAssets && info.requestMethod() == QByteArrayLiteral("GET") &&
+      IsStorableResourceType(info.resourceType()) && TrustedOrigins::IsTrustedHttpsUrl(info.firstPartyUrl()) &&
+      AssetStore::IsImmutableAssetUrl(requestUrl)) {
+    // The store's handler serves hits from disk and downloads misses once for the page and the store
+    info.redirect(AssetStore::StoreUrlFor(requestUrl));
+  }
+}
+
+void RequestInterceptor::LogCounters() const {
+  QList<QPair<QString, quint64>> hosts;
+  {
+    // Copy out under the lock, requests still in flight at quit keep counting
+    const std::lock_guard<std::mutex> lock(m_blockedMutex);
+    hosts.reserve(m_blockedByHost.size());
+    for (auto entry = m_blockedByHost.cbegin(); entry != m_blockedByHost.cend(); ++entry) {
+      hosts.append(qMakePair(entry.key(), entry.value()));
+    }
+  }
+  quint64 totalBlocked = 0;
+  for (const auto &host : hosts) {
+    totalBlocked += host.second;
+  }
+  std::sort(hosts.begin(), hosts.end(), [](const auto &left, const auto &right) { return left.second > right.second; });
+
+  qCInfo(lcPerformance).noquote() << "Request rules blocked" << totalBlocked << "and allowed"
+                                  << m_allowedRequests.load(std::memory_order_relaxed) << "requests";
+  for (qsizetype index = 0; index < std::min<qsizetype>(kLoggedHosts, hosts.size()); ++index) {
+    qCInfo(lcPerformance).noquote() << "  " << hosts.at(index).first << "blocked" << hosts.at(index).second;
+  }
+}
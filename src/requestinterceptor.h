@@ -0,0 +1,39 @@
+#pragma once
+
+#include "requestrules.h"
+
+#include <QHash>
+#include <QString>
+#include <QWebEngineUrlRequestInterceptor>
+#include <QtGlobal>
+#include <atomic>
+#include <mutex>
+#include <optional>
+
+class QObject;
+class QWebEngineUrlRequestInfo;
+
+// One interceptor per profile, every native rule for outgoing page requests lives here
+class RequestInterceptor final : public QWebEngineUrlRequestInterceptor {
+public:
+  // CHATGPT_DESKTOP_BLOCK_ANALYTICS=1 turns on request blocking
+  static bool IsBlockingEnabled();
+  // CHATGPT_DESKTOP_BLOCK_RULES names the rules file, then request-rules.txt in the storage path, then the defaults
+  static RequestRuleSet LoadBlockRules(const QString &storagePath);
+
+  RequestInterceptor(bool serveStoredAssets, std::optional<RequestRuleSet> blockRules, QObject *parent);
+
+  // Chromium may call this off the GUI thread, so the counters below are atomic or behind the mutex
+  void interceptRequest(QWebEngineUrlRequestInfo &info) override;
+
+private:
+  // Top hosts by blocked requests, printed on exit
+  void LogCounters() const;
+
+  bool m_serveStoredAssets = false;
+  std::optional<RequestRuleSet> m_blockRules;
+  std::atomic<quint64> m_allowedRequests{0};
+  // Allowed requests only bump the total, a host is copied into the map the first time it is blocked
+  mutable std::mutex m_blockedMutex;
+  QHash<QString, quint64> m_blockedByHost;
+};
@@ -0,0 +1,83 @@
+#include "requestrules.h"
+
+#include <QLatin1String>
+#include <algorithm>
+#include <utility>
+
+namespace {
+// Only endpoints that record what the page did, nothing the app needs to work
+constexpr auto kDefaultRules = R"__rules__(
+# First party event and experiment logging
+chatgpt.com/ces/
+ab.chatgpt.com/v1/rgstr
+events.statsigapi.net/v1/rgstr
+# Third party analytics and error reporting
+api.segment.io
+cdn.segment.com
+browser-intake-datadoghq.com
+ingest.sentry.io
+www.google-analytics.com
+www.googletagmanager.com
+)__rules__";
+} // namespace
+
+RequestRuleSet RequestRuleSet::Compile(QStringView rulesText) {
+  RequestRuleSet ruleSet;
+  for (QStringView line : rulesText.split(QLatin1Char('\n'))) {
+    const qsizetype commentStart = line.indexOf(QLatin1Char('#'));
+    if (commentStart >= 0) {
+      line = line.left(commentStart);
+    }
+    line = line.trimmed();
+    if (line.isEmpty()) {
+      continue;
+    }
+
+    // Rules name hosts, so a pasted scheme or wildcard label is just noise
+    if (const qsizetype schemeEnd = line.indexOf(QLatin1String("://")); schemeEnd >= 0) {
+      line = line.mid(schemeEnd + 3);
+    }
+    if (line.startsWith(QLatin1String("*."))) {
+      line = line.mid(2);
+    }
+    const qsizetype pathStart = line.indexOf(QLatin1Char('/'));
+    Rule rule;
+    rule.host = line.left(pathStart).toString().toLower();
+    if (pathStart >= 0 && pathStart + 1 < line.size()) {
+      rule.pathPrefix = line.mid(pathStart).toString();
+    }
+    if (!rule.host.isEmpty()) {
+      ruleSet.m_rules.append(std::move(rule));
+    }
+  }
+
+  std::sort(ruleSet.m_rules.begin(), ruleSet.m_rules.end(), [](const Rule &left, const Rule &right) {
+    return left.host < right.host;
+  });
+  return ruleSet;
+}
+
+RequestRuleSet RequestRuleSet::Defaults() { return Compile(QString::fromLatin1(kDefaultRules)); }
+
+bool RequestRuleSet::Matches(QStringView host, QStringView path) const {
+  // Try the host itself, then each parent domain
+  QStringView candidate = host;
+  while (!candidate.isEmpty()) {
+    const auto first =
+        std::lower_bound(m_rules.cbegin(), m_rules.cend(), candidate,
+                         [](const Rule &rule, QStringView requestHost) { return rule.host < requestHost; });
+    for (auto rule = first; rule != m_rules.cend() && rule->host == candidate; ++rule) {
+      if (rule->pathPrefix.isEmpty() || path.startsWith(rule->pathPrefix)) {
+        return true;
+      }
+    }
+    const qsizetype labelEnd = candidate.indexOf(QLatin1Char('.'));
+    if (labelEnd < 0) {
+      break;
+    }
+    candidate = candidate.mid(labelEnd + 1);
+  }
+  return false;
+}
+
+qsizetype RequestRuleSet::RuleCount() const { return m_rules.size(); }
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringView>
+
+// Host and path prefix rules, compiled once into a sorted table that matches without allocating
+class RequestRuleSet final {
+public:
+  // One rule per line as host or host/path-prefix, a host also covers its subdomains, # starts a comment
+  static RequestRuleSet Compile(QStringView rulesText);
+  // Built-in list of analytics, beacon and experiment logging endpoints
+  static RequestRuleSet Defaults();
+
+  // Host must already be lower case, as QUrl hands it out
+  bool Matches(QStringView host, QStringView path) const;
+  qsizetype RuleCount() const;
+
+private:
+  struct Rule {
+    QString host;
+    // Empty blocks the whole host
+    QString pathPrefix;
+  };
+
+  // Sorted by host so every suffix of a request host is one binary search
+  QList<Rule> m_rules;
+};
@@ -0,0 +1,1046 @@
+#include "searchindex.h"
+#include "browserprofile.h"
+#include "conversationsnapshots.h"
+#include "perflog.h"
+
+#include <QChar>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileDevice>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QSaveFile>
+#include <QSet>
+#include <QStringList>
+#include <QtEndian>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <string_view>
+#include <utility>
+
+namespace {
+constexpr auto kDocumentTableName = "documents.idx";
+constexpr auto kDocumentTextsName = "documents.dat";
+constexpr auto kConversationLogName = "conversations.log";
+constexpr auto kSegmentPattern = "segment-*.seg";
+// Present only while a compaction replaces the files one by one
+constexpr auto kCompactMarkerName = "compacting";
+// Document table rows: text offset, text hash, text size, conversation, turn, padding
+constexpr qint64 kDocumentRecordBytes = 32;
+constexpr quint32 kSegmentMagic = 0x31495343; // "CSI1"
+// Segment header: magic, term count, first document, last document, dictionary start, postings start
+constexpr qint64 kSegmentHeaderBytes = 24;
+constexpr quint32 kNoConversation = std::numeric_limits<quint32>::max();
+constexpr int kMinWordChars = 2;
+// Longer runs are hashes and base64 blobs nobody searches for
+constexpr int kMaxWordChars = 48;
+// Prefix queries stop expanding after this many terms per segment
+constexpr quint32 kMaxPrefixTerms = 256;
+constexpr qsizetype kSnippetLeadChars = 40;
+constexpr qsizetype kSnippetChars = 160;
+// The conversation log is rewritten once old records outweigh the live ones this much
+constexpr qint64 kCompactLogMinBytes = 4 * 1024 * 1024;
+constexpr qint64 kCompactLogDeadRatio = 3;
+// Streaming replaces the last turn on every capture, its old documents are dropped once they outnumber the live ones
+constexpr quint32 kCompactDocumentsMinCount = 4096;
+
+using TermPostings = std::map<QByteArray, std::vector<quint32>>;
+
+// These scripts do not separate words with spaces, so each character is a token
+bool IsStandaloneScript(QChar::Script script) {
+  return script == QChar::Script_Han || script == QChar::Script_Hiragana || script == QChar::Script_Katakana;
+}
+
+void AppendVarint(QByteArray &out, quint32 value) {
+  while (value >= 0x80) {
+    out.append(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.append(static_cast<char>(value));
+}
+
+bool ReadVarint(const uchar *&cursor, const uchar *end, quint32 &value) {
+  value = 0;
+  for (int shift = 0; shift < 35 && cursor < end; shift += 7) {
+    const uchar byte = *cursor++;
+    value |= static_cast<quint32>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+QString TurnText(const ConversationSnapshot::Turn &turn) {
+  QStringList parts;
+  parts.reserve(turn.blocks.size());
+  for (const ConversationSnapshot::Block &block : turn.blocks) {
+    parts.append(block.text);
+  }
+  return parts.join(QLatin1Char('\n'));
+}
+
+quint64 TextHash(const QByteArray &utf8Text) {
+  const QByteArray digest = QCryptographicHash::hash(utf8Text, QCryptographicHash::Sha1);
+  return qFromLittleEndian<quint64>(digest.constData());
+}
+
+void CollectPostings(TermPostings &postings, quint32 documentId, QStringView text) {
+  QList<QByteArray> tokens = SearchIndex::Tokenize(text);
+  std::sort(tokens.begin(), tokens.end());
+  tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+  // Documents arrive in id order, so every list stays sorted
+  for (const QByteArray &token : std::as_const(tokens)) {
+    postings[token].push_back(documentId);
+  }
+}
+
+std::vector<quint32> Intersect(const std::vector<quint32> &shorter, const std::vector<quint32> &longer) {
+  std::vector<quint32> matches;
+  matches.reserve(shorter.size());
+  // Galloping through the long list pays off once it is much longer than the short one
+  if (longer.size() / 16 > shorter.size()) {
+    auto searchFrom = longer.cbegin();
+    for (const quint32 documentId : shorter) {
+      // Double the step until it passes the id, then binary search only the last step
+      std::ptrdiff_t step = 1;
+      auto probe = searchFrom;
+      while (longer.cend() - probe > step && *(probe + step) < documentId) {
+        probe += step;
+        step *= 2;
+      }
+      const auto searchTo = longer.cend() - probe > step ? probe + step + 1 : longer.cend();
+      searchFrom = std::lower_bound(probe, searchTo, documentId);
+      if (searchFrom == longer.cend()) {
+        break;
+      }
+      if (*searchFrom == documentId) {
+        matches.push_back(documentId);
+      }
+    }
+    return matches;
+  }
+  std::set_intersection(shorter.cbegin(), shorter.cend(), longer.cbegin(), longer.cend(),
+                        std::back_inserter(matches));
+  return matches;
+}
+
+QString BuildSnippet(const QString &text, const QStringList &words) {
+  qsizetype matchAt = -1;
+  for (const QString &word : words) {
+    matchAt = text.indexOf(word, 0, Qt::CaseInsensitive);
+    if (matchAt >= 0) {
+      break;
+    }
+  }
+  const qsizetype start = std::max<qsizetype>(0, matchAt - kSnippetLeadChars);
+  QString snippet = text.mid(start, kSnippetChars).simplified();
+  if (start > 0) {
+    snippet.prepend(QChar(0x2026));
+  }
+  if (start + kSnippetChars < text.size()) {
+    snippet.append(QChar(0x2026));
+  }
+  return snippet;
+}
+
+std::unique_ptr<QFile> OpenPrivateFile(const QDir &directory, const char *fileName) {
+  auto file = std::make_unique<QFile>(directory.filePath(QString::fromLatin1(fileName)));
+  if (!file->open(QIODevice::ReadWrite)) {
+    qWarning() << "Failed to open search index file:" << file->fileName() << file->errorString();
+    return nullptr;
+  }
+  // Turn text is private, keep it to the owning user
+  file->setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+  return file;
+}
+} // namespace
+
+// Immutable, memory mapped term dictionary plus delta encoded posting lists
+class SearchIndex::Segment {
+public:
+  static std::unique_ptr<Segment> Open(const QString &path) {
+    std::unique_ptr<Segment> segment(new Segment());
+    segment->m_file = std::make_unique<QFile>(path);
+    if (!segment->m_file->open(QIODevice::ReadOnly)) {
+      return nullptr;
+    }
+    segment->m_bytes = segment->m_file->size();
+    if (segment->m_bytes < kSegmentHeaderBytes) {
+      return nullptr;
+    }
+    segment->m_data = segment->m_file->map(0, segment->m_bytes);
+    if (segment->m_data == nullptr) {
+      return nullptr;
+    }
+
+    const uchar *header = segment->m_data;
+    segment->m_termCount = qFromLittleEndian<quint32>(header + 4);
+    segment->m_firstDocument = qFromLittleEndian<quint32>(header + 8);
+    segment->m_lastDocument = qFromLittleEndian<quint32>(header + 12);
+    segment->m_dictionaryStart = qFromLittleEndian<quint32>(header + 16);
+    segment->m_postingsStart = qFromLittleEndian<quint32>(header + 20);
+    const qint64 offsetsEnd = kSegmentHeaderBytes + static_cast<qint64>(segment->m_termCount) * 4;
+    if (qFromLittleEndian<quint32>(header) != kSegmentMagic || segment->m_firstDocument > segment->m_lastDocument ||
+        offsetsEnd > segment->m_dictionaryStart || segment->m_dictionaryStart > segment->m_postingsStart ||
+        segment->m_postingsStart > segment->m_bytes) {
+      return nullptr;
+    }
+    segment->m_path = path;
+    return segment;
+  }
+
+  ~Segment() {
+    if (m_data != nullptr) {
+      m_file->unmap(m_data);
+    }
+  }
+
+  const QString &Path() const { return m_path; }
+  qint64 Bytes() const { return m_bytes; }
+  quint32 TermCount() const { return m_termCount; }
+  quint32 FirstDocument() const { return m_firstDocument; }
+  quint32 LastDocument() const { return m_lastDocument; }
+
+  // Dictionary entries: term size, term bytes, document count, postings offset, postings size
+  std::string_view TermAt(quint32 termIndex) const {
+    const qint64 entryStart = EntryStart(termIndex);
+    if (entryStart < 0) {
+      return std::string_view();
+    }
+    const quint16 termBytes = qFromLittleEndian<quint16>(m_data + entryStart);
+    return std::string_view(reinterpret_cast<const char *>(m_data + entryStart + 2), termBytes);
+  }
+
+  // First term that is not less than the given one
+  quint32 LowerBound(std::string_view term) const {
+    quint32 low = 0;
+    quint32 high = m_termCount;
+    while (low < high) {
+      const quint32 middle = low + (high - low) / 2;
+      if (TermAt(middle) < term) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    return low;
+  }
+
+  void AppendPostings(quint32 termIndex, std::vector<quint32> &documentIds) const {
+    const qint64 entryStart = EntryStart(termIndex);
+    if (entryStart < 0) {
+      return;
+    }
+    const uchar *entry = m_data + entryStart + 2 + qFromLittleEndian<quint16>(m_data + entryStart);
+    const quint32 documentCount = qFromLittleEndian<quint32>(entry);
+    const qint64 postingsStart = m_postingsStart + qFromLittleEndian<quint32>(entry + 4);
+    const qint64 postingsEnd = postingsStart + qFromLittleEndian<quint32>(entry + 8);
+    if (postingsEnd > m_bytes) {
+      return;
+    }
+
+    const uchar *cursor = m_data + postingsStart;
+    const uchar *end = m_data + postingsEnd;
+    documentIds.reserve(documentIds.size() + documentCount);
+    quint32 documentId = 0;
+    for (quint32 index = 0; index < documentCount; ++index) {
+      quint32 delta = 0;
+      if (!ReadVarint(cursor, end, delta)) {
+        return;
+      }
+      documentId += delta;
+      documentIds.push_back(documentId);
+    }
+  }
+
+private:
+  Segment() = default;
+
+  // Offset of a dictionary entry, or -1 when a damaged file points outside the dictionary
+  qint64 EntryStart(quint32 termIndex) const {
+    if (termIndex >= m_termCount) {
+      return -1;
+    }
+    const qint64 entryStart =
+        m_dictionaryStart + qFromLittleEndian<quint32>(m_data + kSegmentHeaderBytes + qint64(termIndex) * 4);
+    if (entryStart + 2 > m_postingsStart) {
+      return -1;
+    }
+    const qint64 entryEnd = entryStart + 2 + qFromLittleEndian<quint16>(m_data + entryStart) + 12;
+    return entryEnd <= m_postingsStart ? entryStart : -1;
+  }
+
+  QString m_path;
+  std::unique_ptr<QFile> m_file;
+  uchar *m_data = nullptr;
+  qint64 m_bytes = 0;
+  quint32 m_termCount = 0;
+  quint32 m_firstDocument = 0;
+  quint32 m_lastDocument = 0;
+  qint64 m_dictionaryStart = 0;
+  qint64 m_postingsStart = 0;
+};
+
+class SearchIndex::SegmentWriter {
+public:
+  SegmentWriter(quint32 firstDocument, quint32 lastDocument)
+      : m_firstDocument(firstDocument), m_lastDocument(lastDocument) {}
+
+  quint32 FirstDocument() const { return m_firstDocument; }
+
+  // Terms must arrive in byte order, each with ascending document ids
+  void Add(std::string_view term, const std::vector<quint32> &documentIds) {
+    const qsizetype postingsOffset = m_postings.size();
+    quint32 previous = 0;
+    for (const quint32 documentId : documentIds) {
+      AppendVarint(m_postings, documentId - previous);
+      previous = documentId;
+    }
+
+    m_entryOffsets.push_back(static_cast<quint32>(m_dictionary.size()));
+    AppendLittleEndian<quint16>(m_dictionary, static_cast<quint16>(term.size()));
+    m_dictionary.append(term.data(), static_cast<qsizetype>(term.size()));
+    AppendLittleEndian<quint32>(m_dictionary, static_cast<quint32>(documentIds.size()));
+    AppendLittleEndian<quint32>(m_dictionary, static_cast<quint32>(postingsOffset));
+    AppendLittleEndian<quint32>(m_dictionary, static_cast<quint32>(m_postings.size() - postingsOffset));
+  }
+
+  QByteArray Finish() const {
+    const qint64 dictionaryStart = kSegmentHeaderBytes + static_cast<qint64>(m_entryOffsets.size()) * 4;
+    const qint64 postingsStart = dictionaryStart + m_dictionary.size();
+    QByteArray segment;
+    segment.reserve(postingsStart + m_postings.size());
+    AppendLittleEndian<quint32>(segment, kSegmentMagic);
+    AppendLittleEndian<quint32>(segment, static_cast<quint32>(m_entryOffsets.size()));
+    AppendLittleEndian<quint32>(segment, m_firstDocument);
+    AppendLittleEndian<quint32>(segment, m_lastDocument);
+    AppendLittleEndian<quint32>(segment, static_cast<quint32>(dictionaryStart));
+    AppendLittleEndian<quint32>(segment, static_cast<quint32>(postingsStart));
+    for (const quint32 entryOffset : m_entryOffsets) {
+      AppendLittleEndian<quint32>(segment, entryOffset);
+    }
+    segment.append(m_dictionary);
+    segment.append(m_postings);
+    return segment;
+  }
+
+private:
+  template <typename T> static void AppendLittleEndian(QByteArray &out, T value) {
+    char bytes[sizeof(T)];
+    qToLittleEndian<T>(value, bytes);
+    out.append(bytes, sizeof(T));
+  }
+
+  quint32 m_firstDocument = 0;
+  quint32 m_lastDocument = 0;
+  std::vector<quint32> m_entryOffsets;
+  QByteArray m_dictionary;
+  QByteArray m_postings;
+};
+
+SearchIndex &SearchIndex::Instance() {
+  // Function static gives one index for the whole process
+  static SearchIndex instance(QDir(BrowserProfile::Instance().StoragePath()).filePath(QStringLiteral("search-index")));
+  return instance;
+}
+
+SearchIndex::SearchIndex(const QString &directoryPath) : m_directoryPath(directoryPath) {}
+
+SearchIndex::~SearchIndex() = default;
+
+QList<QByteArray> SearchIndex::Tokenize(QStringView text) {
+  QList<QByteArray> tokens;
+  QString word;
+  auto flushWord = [&tokens, &word]() {
+    if (word.size() >= kMinWordChars && word.size() <= kMaxWordChars) {
+      tokens.append(word.toUtf8());
+    }
+    word.clear();
+  };
+
+  for (const QChar character : text) {
+    if (!character.isLetterOrNumber()) {
+      flushWord();
+      continue;
+    }
+    if (IsStandaloneScript(character.script())) {
+      flushWord();
+      tokens.append(QString(character).toUtf8());
+      continue;
+    }
+    word.append(character.toCaseFolded());
+  }
+  flushWord();
+  return tokens;
+}
+
+void SearchIndex::IndexConversation(const QString &conversationKey, const QString &title,
+                                    const ConversationSnapshot &snapshot) {
+  if (conversationKey.isEmpty() || !EnsureOpen()) {
+    return;
+  }
+
+  quint32 conversationId = m_conversationIds.value(conversationKey, kNoConversation);
+  const bool isNewConversation = conversationId == kNoConversation;
+  if (isNewConversation) {
+    conversationId = static_cast<quint32>(m_conversations.size());
+    m_conversations.append(Conversation{conversationKey, QString(), {}, 0});
+    m_conversationIds.insert(conversationKey, conversationId);
+  }
+  Conversation &conversation = m_conversations[conversationId];
+
+  const quint32 firstNewDocument = m_documentCount;
+  bool changed = isNewConversation || conversation.title != title ||
+                 conversation.documentIds.size() != snapshot.turns.size();
+  QList<quint32> documentIds;
+  documentIds.reserve(snapshot.turns.size());
+  TermPostings postings;
+  for (qsizetype turnIndex = 0; turnIndex < snapshot.turns.size(); ++turnIndex) {
+    const QString text = TurnText(snapshot.turns.at(turnIndex));
+    const QByteArray utf8Text = text.toUtf8();
+    const quint64 textHash = TextHash(utf8Text);
+    // Streaming only ever touches the last turns, everything before keeps its document
+    if (turnIndex < conversation.documentIds.size()) {
+      const quint32 previousId = conversation.documentIds.at(turnIndex);
+      if (ReadDocument(previousId).textHash == textHash) {
+        documentIds.append(previousId);
+        continue;
+      }
+    }
+
+    const qint64 documentId =
+        AppendDocument(DocumentRecord{0, textHash, 0, conversationId, static_cast<quint32>(turnIndex)}, utf8Text);
+    if (documentId < 0) {
+      qWarning() << "Failed to append to the search index, indexing stops for this run";
+      m_usable = false;
+      return;
+    }
+    documentIds.append(static_cast<quint32>(documentId));
+    CollectPostings(postings, static_cast<quint32>(documentId), text);
+    changed = true;
+  }
+  if (!changed) {
+    return;
+  }
+
+  // Ownership flips before any merge so replaced turns drop out of the segments right away
+  for (const quint32 documentId : std::as_const(conversation.documentIds)) {
+    // A record can outlive rows lost to a crash
+    if (documentId < m_documentOwners.size() && m_documentOwners[documentId] != kNoConversation) {
+      m_documentOwners[documentId] = kNoConversation;
+      --m_liveDocumentCount;
+    }
+  }
+  for (const quint32 documentId : std::as_const(documentIds)) {
+    m_documentOwners[documentId] = conversationId;
+    ++m_liveDocumentCount;
+  }
+  conversation.title = title;
+  conversation.documentIds = documentIds;
+
+  // Texts and rows first, then the record that points at them, then the postings
+  m_documentTexts->flush();
+  m_documentTable->flush();
+  if (!AppendConversationRecord(conversationId)) {
+    qWarning() << "Failed to append to the search index, indexing stops for this run";
+    m_usable = false;
+    return;
+  }
+
+  if (m_documentCount > firstNewDocument) {
+    if (FirstUnsegmentedDocument() < firstNewDocument) {
+      // An earlier segment write failed, its documents are read back from the table along with these
+      IndexUnsegmentedTail();
+    } else {
+      SegmentWriter writer(firstNewDocument, m_documentCount - 1);
+      for (const auto &[term, termDocuments] : postings) {
+        writer.Add(std::string_view(term.constData(), static_cast<size_t>(term.size())), termDocuments);
+      }
+      // A failed write leaves these documents past the newest segment, the next update or open retries them
+      if (WriteSegment(writer)) {
+        MergeNewestSegments();
+      }
+    }
+  }
+  CompactConversationLogIfNeeded();
+}
+
+QList<SearchHit> SearchIndex::Search(const QString &query, int limit) {
+  QList<SearchHit> hits;
+  QList<QByteArray> terms = Tokenize(query);
+  if (terms.isEmpty() || limit <= 0 || !EnsureOpen()) {
+    return hits;
+  }
+
+  // The word still being typed matches as a prefix
+  const QByteArray prefix = terms.takeLast();
+  std::sort(terms.begin(), terms.end());
+  terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+  std::vector<std::vector<quint32>> postingLists;
+  postingLists.reserve(terms.size() + 1);
+  for (const QByteArray &term : std::as_const(terms)) {
+    postingLists.push_back(Postings(term));
+  }
+  postingLists.push_back(PrefixPostings(prefix));
+
+  // Intersect from the shortest list up so the working set only shrinks
+  std::sort(postingLists.begin(), postingLists.end(),
+            [](const std::vector<quint32> &left, const std::vector<quint32> &right) {
+              return left.size() < right.size();
+            });
+  std::vector<quint32> matches = std::move(postingLists.front());
+  for (size_t index = 1; index < postingLists.size() && !matches.empty(); ++index) {
+    matches = Intersect(matches, postingLists.at(index));
+  }
+
+  // Snippets look for the words as typed
+  const QStringList words = query.split(QLatin1Char(' '), Qt::SkipEmptyParts);
+  QSet<quint32> seenConversations;
+  for (auto match = matches.crbegin(); match != matches.crend() && hits.size() < limit; ++match) {
+    const quint32 conversationId = OwnerOf(*match);
+    if (conversationId == kNoConversation || seenConversations.contains(conversationId)) {
+      continue;
+    }
+    seenConversations.insert(conversationId);
+    const Conversation &conversation = m_conversations.at(conversationId);
+    const DocumentRecord record = ReadDocument(*match);
+    hits.append(SearchHit{conversation.key, conversation.title, static_cast<int>(record.turnIndex),
+                          BuildSnippet(ReadDocumentText(*match), words)});
+  }
+  return hits;
+}
+
+int SearchIndex::ConversationCount() { return EnsureOpen() ? static_cast<int>(m_conversations.size()) : 0; }
+
+qint64 SearchIndex::DiskBytes() {
+  if (!EnsureOpen()) {
+    return 0;
+  }
+  qint64 bytes = m_documentTable->size() + m_documentTexts->size() + m_conversationLog->size();
+  for (const std::unique_ptr<Segment> &segment : m_segments) {
+    bytes += segment->Bytes();
+  }
+  return bytes;
+}
+
+bool SearchIndex::EnsureOpen() {
+  if (m_opened) {
+    return m_usable;
+  }
+  m_opened = true;
+
+  if (!QDir().mkpath(m_directoryPath)) {
+    qWarning() << "Failed to create search index path:" << m_directoryPath;
+    return false;
+  }
+  QDir directory(m_directoryPath);
+  // Files half way through a compaction mix two numberings, the index is derived data so it starts over
+  if (directory.exists(QString::fromLatin1(kCompactMarkerName))) {
+    qWarning() << "Discarding search index left behind by an interrupted compaction:" << m_directoryPath;
+    for (const QString &fileName : directory.entryList(QDir::Files)) {
+      directory.remove(fileName);
+    }
+  }
+  m_documentTable = OpenPrivateFile(directory, kDocumentTableName);
+  m_documentTexts = OpenPrivateFile(directory, kDocumentTextsName);
+  m_conversationLog = OpenPrivateFile(directory, kConversationLogName);
+  if (m_documentTable == nullptr || m_documentTexts == nullptr || m_conversationLog == nullptr) {
+    return false;
+  }
+
+  // A row torn by a crash is dropped, its text just stays unreferenced
+  const qint64 tableBytes = m_documentTable->size();
+  m_documentCount = static_cast<quint32>(tableBytes / kDocumentRecordBytes);
+  if (tableBytes % kDocumentRecordBytes != 0) {
+    m_documentTable->resize(static_cast<qint64>(m_documentCount) * kDocumentRecordBytes);
+  }
+
+  LoadConversations();
+  LoadSegments();
+  m_usable = true;
+  IndexUnsegmentedTail();
+  return m_usable;
+}
+
+void SearchIndex::LoadConversations() {
+  m_conversationLog->seek(0);
+  const QByteArray logBytes = m_conversationLog->readAll();
+  QDataStream stream(logBytes);
+  stream.setVersion(QDataStream::Qt_6_0);
+
+  // Records are appended per update, the newest one for a conversation wins
+  qint64 goodBytes = 0;
+  while (!stream.atEnd()) {
+    quint32 conversationId = 0;
+    QString key;
+    QString title;
+    QList<quint32> documentIds;
+    stream >> conversationId >> key >> title >> documentIds;
+    if (stream.status() != QDataStream::Ok || conversationId > m_conversations.size()) {
+      break;
+    }
+
+    const qint64 recordEnd = stream.device()->pos();
+    if (conversationId == m_conversations.size()) {
+      m_conversations.append(Conversation{key, QString(), {}, 0});
+      m_conversationIds.insert(key, conversationId);
+    }
+    Conversation &conversation = m_conversations[conversationId];
+    m_liveConversationLogBytes += recordEnd - goodBytes - conversation.recordBytes;
+    conversation.title = title;
+    conversation.documentIds = documentIds;
+    conversation.recordBytes = recordEnd - goodBytes;
+    goodBytes = recordEnd;
+  }
+  if (goodBytes < logBytes.size()) {
+    qWarning() << "Truncating search index conversation log after" << goodBytes << "bytes";
+    m_conversationLog->resize(goodBytes);
+  }
+
+  m_documentOwners.assign(m_documentCount, kNoConversation);
+  for (qsizetype conversationId = 0; conversationId < m_conversations.size(); ++conversationId) {
+    for (const quint32 documentId : std::as_const(m_conversations.at(conversationId).documentIds)) {
+      if (documentId < m_documentCount) {
+        m_documentOwners[documentId] = static_cast<quint32>(conversationId);
+      }
+    }
+  }
+  m_liveDocumentCount = static_cast<quint32>(std::count_if(m_documentOwners.cbegin(), m_documentOwners.cend(),
+                                                           [](quint32 owner) { return owner != kNoConversation; }));
+}
+
+void SearchIndex::LoadSegments() {
+  QDir directory(m_directoryPath);
+  // Leftovers from a write that never got renamed into place
+  for (const QString &partialName : directory.entryList({QStringLiteral("*.seg.tmp")}, QDir::Files)) {
+    directory.remove(partialName);
+  }
+
+  std::vector<std::unique_ptr<Segment>> segments;
+  for (const QString &segmentName : directory.entryList({QString::fromLatin1(kSegmentPattern)}, QDir::Files)) {
+    const quint64 segmentNumber = QFileInfo(segmentName).completeBaseName().mid(8).toULongLong();
+    m_nextSegmentNumber = std::max(m_nextSegmentNumber, segmentNumber + 1);
+    std::unique_ptr<Segment> segment = Segment::Open(directory.filePath(segmentName));
+    if (segment == nullptr) {
+      qWarning() << "Dropping unreadable search index segment:" << segmentName;
+      directory.remove(segmentName);
+      continue;
+    }
+    segments.push_back(std::move(segment));
+  }
+
+  // A crash mid merge leaves the merged segment next to the two it replaced
+  std::sort(segments.begin(), segments.end(), [](const auto &left, const auto &right) {
+    if (left->FirstDocument() != right->FirstDocument()) {
+      return left->FirstDocument() < right->FirstDocument();
+    }
+    return left->LastDocument() > right->LastDocument();
+  });
+  for (std::unique_ptr<Segment> &segment : segments) {
+    if (!m_segments.empty() && segment->FirstDocument() <= m_segments.back()->LastDocument()) {
+      const QString supersededPath = segment->Path();
+      segment.reset();
+      QFile::remove(supersededPath);
+      continue;
+    }
+    m_segments.push_back(std::move(segment));
+  }
+}
+
+quint32 SearchIndex::FirstUnsegmentedDocument() const {
+  return m_segments.empty() ? 0 : m_segments.back()->LastDocument() + 1;
+}
+
+void SearchIndex::IndexUnsegmentedTail() {
+  const quint32 firstUnsegmented = FirstUnsegmentedDocument();
+  if (firstUnsegmented >= m_documentCount) {
+    return;
+  }
+
+  TermPostings postings;
+  for (quint32 documentId = firstUnsegmented; documentId < m_documentCount; ++documentId) {
+    if (OwnerOf(documentId) != kNoConversation) {
+      CollectPostings(postings, documentId, ReadDocumentText(documentId));
+    }
+  }
+  SegmentWriter writer(firstUnsegmented, m_documentCount - 1);
+  for (const auto &[term, termDocuments] : postings) {
+    writer.Add(std::string_view(term.constData(), static_cast<size_t>(term.size())), termDocuments);
+  }
+  if (WriteSegment(writer)) {
+    MergeNewestSegments();
+  }
+}
+
+SearchIndex::DocumentRecord SearchIndex::ReadDocument(quint32 documentId) {
+  DocumentRecord record;
+  if (documentId >= m_documentCount ||
+      !m_documentTable->seek(static_cast<qint64>(documentId) * kDocumentRecordBytes)) {
+    return record;
+  }
+  const QByteArray row = m_documentTable->read(kDocumentRecordBytes);
+  if (row.size() != kDocumentRecordBytes) {
+    return record;
+  }
+  const uchar *data = reinterpret_cast<const uchar *>(row.constData());
+  record.textOffset = qFromLittleEndian<qint64>(data);
+  record.textHash = qFromLittleEndian<quint64>(data + 8);
+  record.textBytes = qFromLittleEndian<quint32>(data + 16);
+  record.conversationId = qFromLittleEndian<quint32>(data + 20);
+  record.turnIndex = qFromLittleEndian<quint32>(data + 24);
+  return record;
+}
+
+QString SearchIndex::ReadDocumentText(quint32 documentId) {
+  const DocumentRecord record = ReadDocument(documentId);
+  if (record.textBytes == 0 || !m_documentTexts->seek(record.textOffset)) {
+    return QString();
+  }
+  return QString::fromUtf8(qUncompress(m_documentTexts->read(record.textBytes)));
+}
+
+qint64 SearchIndex::AppendDocument(DocumentRecord record, const QByteArray &utf8Text) {
+  // Fast compression roughly halves chat text without slowing indexing down much
+  const QByteArray compressedText = qCompress(utf8Text, 1);
+  record.textOffset = m_documentTexts->size();
+  record.textBytes = static_cast<quint32>(compressedText.size());
+  if (!m_documentTexts->seek(record.textOffset) || m_documentTexts->write(compressedText) != compressedText.size()) {
+    return -1;
+  }
+
+  const QByteArray row = EncodeDocumentRow(record);
+  if (!m_documentTable->seek(static_cast<qint64>(m_documentCount) * kDocumentRecordBytes) ||
+      m_documentTable->write(row) != row.size()) {
+    return -1;
+  }
+  m_documentOwners.push_back(kNoConversation);
+  return m_documentCount++;
+}
+
+QByteArray SearchIndex::EncodeDocumentRow(const DocumentRecord &record) {
+  QByteArray row(kDocumentRecordBytes, '\0');
+  uchar *data = reinterpret_cast<uchar *>(row.data());
+  qToLittleEndian<qint64>(record.textOffset, data);
+  qToLittleEndian<quint64>(record.textHash, data + 8);
+  qToLittleEndian<quint32>(record.textBytes, data + 16);
+  qToLittleEndian<quint32>(record.conversationId, data + 20);
+  qToLittleEndian<quint32>(record.turnIndex, data + 24);
+  return row;
+}
+
+bool SearchIndex::AppendConversationRecord(quint32 conversationId) {
+  Conversation &conversation = m_conversations[conversationId];
+  QByteArray record;
+  QDataStream stream(&record, QIODevice::WriteOnly);
+  stream.setVersion(QDataStream::Qt_6_0);
+  stream << conversationId << conversation.key << conversation.title << conversation.documentIds;
+
+  if (!m_conversationLog->seek(m_conversationLog->size()) || m_conversationLog->write(record) != record.size() ||
+      !m_conversationLog->flush()) {
+    return false;
+  }
+  m_liveConversationLogBytes += record.size() - conversation.recordBytes;
+  conversation.recordBytes = record.size();
+  return true;
+}
+
+void SearchIndex::CompactConversationLogIfNeeded() {
+  const qint64 logBytes = m_conversationLog->size();
+  if (logBytes < kCompactLogMinBytes || logBytes < kCompactLogDeadRatio * m_liveConversationLogBytes) {
+    return;
+  }
+  RewriteConversationLog();
+}
+
+bool SearchIndex::RewriteConversationLog() {
+  // Conversation ids are positions, so the rewrite keeps every conversation in id order
+  QSaveFile compacted(m_conversationLog->fileName());
+  if (!compacted.open(QIODevice::WriteOnly)) {
+    qWarning() << "Failed to compact search index conversation log:" << compacted.errorString();
+    return false;
+  }
+  QDataStream stream(&compacted);
+  stream.setVersion(QDataStream::Qt_6_0);
+  QList<qint64> recordBytes;
+  recordBytes.reserve(m_conversations.size());
+  for (qsizetype conversationId = 0; conversationId < m_conversations.size(); ++conversationId) {
+    const Conversation &conversation = m_conversations.at(conversationId);
+    const qint64 recordStart = compacted.pos();
+    stream << static_cast<quint32>(conversationId) << conversation.key << conversation.title
+           << conversation.documentIds;
+    recordBytes.append(compacted.pos() - recordStart);
+  }
+
+  m_conversationLog->close();
+  const bool committed = compacted.commit();
+  if (!m_conversationLog->open(QIODevice::ReadWrite)) {
+    qWarning() << "Failed to reopen search index conversation log:" << m_conversationLog->errorString();
+    m_usable = false;
+    return false;
+  }
+  if (!committed) {
+    qWarning() << "Failed to replace search index conversation log:" << compacted.errorString();
+    return false;
+  }
+  m_liveConversationLogBytes = 0;
+  for (qsizetype conversationId = 0; conversationId < m_conversations.size(); ++conversationId) {
+    m_conversations[conversationId].recordBytes = recordBytes.at(conversationId);
+    m_liveConversationLogBytes += recordBytes.at(conversationId);
+  }
+  return true;
+}
+
+bool SearchIndex::WriteSegment(const SegmentWriter &writer) {
+  const QString segmentName =
+      QStringLiteral("segment-%1.seg").arg(m_nextSegmentNumber++, 12, 10, QLatin1Char('0'));
+  const QString segmentPath = QDir(m_directoryPath).filePath(segmentName);
+  const QString partialPath = segmentPath + QStringLiteral(".tmp");
+
+  // Segments are derived data, a rename without fsync is enough since a lost one is rebuilt on open
+  QFile partialFile(partialPath);
+  const QByteArray segmentBytes = writer.Finish();
+  if (!partialFile.open(QIODevice::WriteOnly) || partialFile.write(segmentBytes) != segmentBytes.size()) {
+    qWarning() << "Failed to write search index segment:" << partialPath << partialFile.errorString();
+    partialFile.remove();
+    return false;
+  }
+  partialFile.close();
+  if (!QFile::rename(partialPath, segmentPath)) {
+    qWarning() << "Failed to move search index segment into place:" << segmentPath;
+    QFile::remove(partialPath);
+    return false;
+  }
+
+  std::unique_ptr<Segment> segment = Segment::Open(segmentPath);
+  if (segment == nullptr) {
+    QFile::remove(segmentPath);
+    return false;
+  }
+  m_segments.push_back(std::move(segment));
+  return true;
+}
+
+void SearchIndex::MergeNewestSegments() {
+  // Folding while the newest segment is at least half its neighbour works like a binary counter
+  while (m_segments.size() >= 2) {
+    const Segment &older = *m_segments.at(m_segments.size() - 2);
+    const Segment &newer = *m_segments.back();
+    if (newer.Bytes() * 2 < older.Bytes()) {
+      break;
+    }
+
+    SegmentWriter writer(older.FirstDocument(), newer.LastDocument());
+    std::vector<quint32> termDocuments;
+    quint32 olderIndex = 0;
+    quint32 newerIndex = 0;
+    while (olderIndex < older.TermCount() || newerIndex < newer.TermCount()) {
+      const bool hasOlder = olderIndex < older.TermCount();
+      const bool hasNewer = newerIndex < newer.TermCount();
+      const std::string_view olderTerm = hasOlder ? older.TermAt(olderIndex) : std::string_view();
+      const std::string_view newerTerm = hasNewer ? newer.TermAt(newerIndex) : std::string_view();
+      const bool takeOlder = hasOlder && (!hasNewer || olderTerm <= newerTerm);
+      const bool takeNewer = hasNewer && (!hasOlder || newerTerm <= olderTerm);
+
+      termDocuments.clear();
+      if (takeOlder) {
+        older.AppendPostings(olderIndex++, termDocuments);
+      }
+      if (takeNewer) {
+        newer.AppendPostings(newerIndex++, termDocuments);
+      }
+      // Replaced turns are dropped here for good
+      termDocuments.erase(std::remove_if(termDocuments.begin(), termDocuments.end(),
+                                         [this](quint32 documentId) { return OwnerOf(documentId) == kNoConversation; }),
+                          termDocuments.end());
+      if (!termDocuments.empty()) {
+        writer.Add(takeOlder ? olderTerm : newerTerm, termDocuments);
+      }
+    }
+
+    const QString olderPath = older.Path();
+    const QString newerPath = newer.Path();
+    if (!WriteSegment(writer)) {
+      return;
+    }
+    // The merged segment is already at the back, the two it replaces sit right before it
+    std::unique_ptr<Segment> merged = std::move(m_segments.back());
+    m_segments.resize(m_segments.size() - 3);
+    m_segments.push_back(std::move(merged));
+    QFile::remove(olderPath);
+    QFile::remove(newerPath);
+  }
+
+  if (m_documentCount >= kCompactDocumentsMinCount && m_documentCount - m_liveDocumentCount > m_liveDocumentCount) {
+    CompactDocuments();
+  }
+}
+
+void SearchIndex::CompactDocuments() {
+  QElapsedTimer compactTimer;
+  compactTimer.start();
+  const QDir directory(m_directoryPath);
+  const QString markerPath = directory.filePath(QString::fromLatin1(kCompactMarkerName));
+  QFile marker(markerPath);
+  if (!marker.open(QIODevice::WriteOnly)) {
+    qWarning() << "Failed to start search index compaction:" << markerPath << marker.errorString();
+    return;
+  }
+  marker.close();
+
+  // Live documents keep their order, so every posting list is still sorted after renumbering
+  std::vector<quint32> newIds(m_documentCount, kNoConversation);
+  quint32 liveCount = 0;
+  for (quint32 documentId = 0; documentId < m_documentCount; ++documentId) {
+    if (m_documentOwners.at(documentId) != kNoConversation) {
+      newIds[documentId] = liveCount++;
+    }
+  }
+
+  // Texts move over still compressed
+  QSaveFile texts(m_documentTexts->fileName());
+  QSaveFile table(m_documentTable->fileName());
+  bool written = texts.open(QIODevice::WriteOnly) && table.open(QIODevice::WriteOnly);
+  qint64 textOffset = 0;
+  for (quint32 documentId = 0; written && documentId < m_documentCount; ++documentId) {
+    if (newIds.at(documentId) == kNoConversation) {
+      continue;
+    }
+    DocumentRecord record = ReadDocument(documentId);
+    QByteArray compressedText;
+    if (record.textBytes > 0 && m_documentTexts->seek(record.textOffset)) {
+      compressedText = m_documentTexts->read(record.textBytes);
+    }
+    record.textOffset = textOffset;
+    record.textBytes = static_cast<quint32>(compressedText.size());
+    const QByteArray row = EncodeDocumentRow(record);
+    written = texts.write(compressedText) == compressedText.size() && table.write(row) == row.size();
+    textOffset += compressedText.size();
+  }
+  if (!written) {
+    qWarning() << "Failed to write compacted search index documents:" << texts.errorString() << table.errorString();
+    texts.cancelWriting();
+    table.cancelWriting();
+    QFile::remove(markerPath);
+    return;
+  }
+
+  // Every segment folds into one, walking all dictionaries in term order at once
+  SegmentWriter writer(0, liveCount > 0 ? liveCount - 1 : 0);
+  std::vector<quint32> termIndexes(m_segments.size(), 0);
+  std::vector<quint32> termDocuments;
+  while (true) {
+    std::string_view term;
+    bool hasTerm = false;
+    for (size_t segmentIndex = 0; segmentIndex < m_segments.size(); ++segmentIndex) {
+      const Segment &segment = *m_segments.at(segmentIndex);
+      if (termIndexes.at(segmentIndex) < segment.TermCount() &&
+          (!hasTerm || segment.TermAt(termIndexes.at(segmentIndex)) < term)) {
+        term = segment.TermAt(termIndexes.at(segmentIndex));
+        hasTerm = true;
+      }
+    }
+    if (!hasTerm) {
+      break;
+    }
+    termDocuments.clear();
+    for (size_t segmentIndex = 0; segmentIndex < m_segments.size(); ++segmentIndex) {
+      const Segment &segment = *m_segments.at(segmentIndex);
+      if (termIndexes.at(segmentIndex) < segment.TermCount() && segment.TermAt(termIndexes.at(segmentIndex)) == term) {
+        segment.AppendPostings(termIndexes[segmentIndex]++, termDocuments);
+      }
+    }
+    size_t keptCount = 0;
+    for (const quint32 documentId : termDocuments) {
+      if (documentId < m_documentCount && newIds.at(documentId) != kNoConversation) {
+        termDocuments[keptCount++] = newIds.at(documentId);
+      }
+    }
+    termDocuments.resize(keptCount);
+    if (!termDocuments.empty()) {
+      writer.Add(term, termDocuments);
+    }
+  }
+
+  // From the first commit on the files disagree until the marker is gone, a failure leaves it for the next open
+  const quint32 oldDocumentCount = m_documentCount;
+  const size_t oldSegmentCount = m_segments.size();
+  m_documentTable->close();
+  m_documentTexts->close();
+  if (!texts.commit() || !table.commit()) {
+    qWarning() << "Failed to replace search index documents, the index is rebuilt on the next open";
+    m_usable = false;
+    return;
+  }
+  m_documentTable = OpenPrivateFile(directory, kDocumentTableName);
+  m_documentTexts = OpenPrivateFile(directory, kDocumentTextsName);
+  m_documentCount = liveCount;
+  if (m_documentTable == nullptr || m_documentTexts == nullptr || (liveCount > 0 && !WriteSegment(writer))) {
+    m_usable = false;
+    return;
+  }
+  for (size_t segmentIndex = 0; segmentIndex < oldSegmentCount; ++segmentIndex) {
+    QFile::remove(m_segments.at(segmentIndex)->Path());
+  }
+  m_segments.erase(m_segments.begin(), m_segments.begin() + static_cast<std::ptrdiff_t>(oldSegmentCount));
+
+  m_documentOwners.assign(liveCount, kNoConversation);
+  for (qsizetype conversationId = 0; conversationId < m_conversations.size(); ++conversationId) {
+    for (quint32 &documentId : m_conversations[conversationId].documentIds) {
+      documentId = documentId < oldDocumentCount ? newIds.at(documentId) : kNoConversation;
+      if (documentId != kNoConversation) {
+        m_documentOwners[documentId] = static_cast<quint32>(conversationId);
+      }
+    }
+  }
+  m_liveDocumentCount = liveCount;
+  if (!RewriteConversationLog()) {
+    m_usable = false;
+    return;
+  }
+  QFile::remove(markerPath);
+  qCInfo(lcPerformance).noquote() << "Compacted search index from" << oldDocumentCount << "to" << liveCount
+                                  << "documents in" << compactTimer.elapsed() << "ms";
+}
+
+quint32 SearchIndex::OwnerOf(quint32 documentId) const {
+  return documentId < m_documentOwners.size() ? m_documentOwners.at(documentId) : kNoConversation;
+}
+
+std::vector<quint32> SearchIndex::Postings(const QByteArray &term) const {
+  const std::string_view termView(term.constData(), static_cast<size_t>(term.size()));
+  std::vector<quint32> documentIds;
+  for (const std::unique_ptr<Segment> &segment : m_segments) {
+    const quint32 termIndex = segment->LowerBound(termView);
+    if (termIndex < segment->TermCount() && segment->TermAt(termIndex) == termView) {
+      segment->AppendPostings(termIndex, documentIds);
+    }
+  }
+  return documentIds;
+}
+
+std::vector<quint32> SearchIndex::PrefixPostings(const QByteArray &prefix) const {
+  const std::string_view prefixView(prefix.constData(), static_cast<size_t>(prefix.size()));
+  std::vector<quint32> documentIds;
+  for (const std::unique_ptr<Segment> &segment : m_segments) {
+    const size_t segmentStart = documentIds.size();
+    quint32 expandedTerms = 0;
+    for (quint32 termIndex = segment->LowerBound(prefixView);
+         termIndex < segment->TermCount() && expandedTerms < kMaxPrefixTerms &&
+         segment->TermAt(termIndex).starts_with(prefixView);
+         ++termIndex, ++expandedTerms) {
+      segment->AppendPostings(termIndex, documentIds);
+    }
+    // Several terms can share a document, sorting per segment keeps the whole list ordered
+    std::sort(documentIds.begin() + static_cast<std::ptrdiff_t>(segmentStart), documentIds.end());
+    documentIds.erase(std::unique(documentIds.begin() + static_cast<std::ptrdiff_t>(segmentStart), documentIds.end()),
+                      documentIds.end());
+  }
+  return documentIds;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringView>
+#include <QtGlobal>
+#include <memory>
+#include <vector>
+
+class QFile;
+struct ConversationSnapshot;
+
+struct SearchHit {
+  QString conversationKey;
+  QString title;
+  int turnIndex = 0;
+  QString snippet;
+};
+
+// Inverted index over conversation turns, every turn is one document
+class SearchIndex final {
+public:
+  // The app index lives next to the profile storage and shares the snapshot opt out
+  static SearchIndex &Instance();
+
+  explicit SearchIndex(const QString &directoryPath);
+  ~SearchIndex();
+  SearchIndex(const SearchIndex &) = delete;
+  SearchIndex &operator=(const SearchIndex &) = delete;
+
+  // Case folded words, with Han and kana characters as single tokens, shared by indexing and queries
+  static QList<QByteArray> Tokenize(QStringView text);
+
+  // Turns whose text did not change keep their document, only the rest are tokenized again
+  void IndexConversation(const QString &conversationKey, const QString &title, const ConversationSnapshot &snapshot);
+  // Every word must match, the last one also as a prefix; newest turns first, one hit per conversation
+  QList<SearchHit> Search(const QString &query, int limit);
+
+  int ConversationCount();
+  qint64 DiskBytes();
+
+private:
+  class Segment;
+  class SegmentWriter;
+
+  struct Conversation {
+    QString key;
+    QString title;
+    // Live document for each turn, in turn order
+    QList<quint32> documentIds;
+    // Size of the newest log record, the rest of the log is dead weight
+    qint64 recordBytes = 0;
+  };
+
+  struct DocumentRecord {
+    qint64 textOffset = 0;
+    quint64 textHash = 0;
+    quint32 textBytes = 0;
+    quint32 conversationId = 0;
+    quint32 turnIndex = 0;
+  };
+
+  // Files are opened and indexed on first use so startup never touches them
+  bool EnsureOpen();
+  void LoadConversations();
+  void LoadSegments();
+  // Documents written after the newest segment were never indexed, a crash or failed write leaves these
+  void IndexUnsegmentedTail();
+  quint32 FirstUnsegmentedDocument() const;
+
+  DocumentRecord ReadDocument(quint32 documentId);
+  QString ReadDocumentText(quint32 documentId);
+  qint64 AppendDocument(DocumentRecord record, const QByteArray &utf8Text);
+  static QByteArray EncodeDocumentRow(const DocumentRecord &record);
+  bool AppendConversationRecord(quint32 conversationId);
+  void CompactConversationLogIfNeeded();
+  bool RewriteConversationLog();
+
+  bool WriteSegment(const SegmentWriter &writer);
+  // Keep the segment count logarithmic by folding the newest segment into its older neighbour
+  void MergeNewestSegments();
+  // Renumber the live documents from zero, rewriting texts, table, conversation log and one merged segment
+  void CompactDocuments();
+  // Conversation that still uses a document, or none once its turn changed
+  quint32 OwnerOf(quint32 documentId) const;
+
+  // Posting lists from every segment, already in document order because segments never overlap
+  std::vector<quint32> Postings(const QByteArray &term) const;
+  std::vector<quint32> PrefixPostings(const QByteArray &prefix) const;
+
+  QString m_directoryPath;
+  bool m_opened = false;
+  bool m_usable = false;
+  std::unique_ptr<QFile> m_documentTable;
+  std::unique_ptr<QFile> m_documentTexts;
+  std::unique_ptr<QFile> m_conversationLog;
+  quint32 m_documentCount = 0;
+  std::vector<quint32> m_documentOwners;
+  quint32 m_liveDocumentCount = 0;
+  QList<Conversation> m_conversations;
+  QHash<QString, quint32> m_conversationIds;
+  qint64 m_liveConversationLogBytes = 0;
+  std::vector<std::unique_ptr<Segment>> m_segments;
+  quint64 m_nextSegmentNumber = 1;
+};
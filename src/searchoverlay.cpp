@@ -0,0 +1,143 @@
+#include "searchoverlay.h"
+#include "perflog.h"
+#include "searchindex.h"
+
+#include <QElapsedTimer>
+#include <QEvent>
+#include <QKeyEvent>
+#include <QLabel>
+#include <QLineEdit>
+#include <QList>
+#include <QListWidget>
+#include <QListWidgetItem>
+#include <QVBoxLayout>
+#include <QVariant>
+#include <QWidget>
+#include <algorithm>
+#include <utility>
+
+namespace {
+// More than a screenful of hits means the query needs another word
+constexpr int kMaxResults = 50;
+constexpr int kOverlayWidth = 640;
+constexpr int kOverlayMaxHeight = 480;
+constexpr int kOverlayTopMargin = 48;
+constexpr int kOverlayMinMargin = 16;
+constexpr int kConversationKeyRole = Qt::UserRole;
+constexpr int kTurnIndexRole = Qt::UserRole + 1;
+} // namespace
+
+SearchOverlay::SearchOverlay(OpenHandler openHandler, QWidget *parent)
+    : QFrame(parent), m_openHandler(std::move(openHandler)) {
+  setFrameShape(QFrame::StyledPanel);
+  setAutoFillBackground(true);
+
+  m_queryEdit = new QLineEdit(this);
+  m_queryEdit->setPlaceholderText(QStringLiteral("Search conversations"));
+  m_queryEdit->setClearButtonEnabled(true);
+  m_resultList = new QListWidget(this);
+  m_resultList->setWordWrap(true);
+  m_resultList->setFocusPolicy(Qt::NoFocus);
+  m_statusLabel = new QLabel(this);
+
+  auto *layout = new QVBoxLayout(this);
+  layout->addWidget(m_queryEdit);
+  layout->addWidget(m_resultList);
+  layout->addWidget(m_statusLabel);
+
+  connect(m_queryEdit, &QLineEdit::textChanged, this, [this](const QString &query) { RunQuery(query); });
+  connect(m_resultList, &QListWidget::itemActivated, this, [this]([[maybe_unused]] QListWidgetItem *item) {
+    OpenCurrentHit();
+  });
+  // Arrow keys and Enter stay in the query field so typing never loses focus
+  m_queryEdit->installEventFilter(this);
+  parent->installEventFilter(this);
+  hide();
+}
+
+void SearchOverlay::Open() {
+  UpdateGeometry();
+  show();
+  raise();
+  m_queryEdit->setFocus();
+  m_queryEdit->selectAll();
+}
+
+void SearchOverlay::Close() {
+  hide();
+  if (parentWidget() != nullptr) {
+    parentWidget()->setFocus();
+  }
+}
+
+bool SearchOverlay::eventFilter(QObject *watched, QEvent *event) {
+  if (watched == parent() && event->type() == QEvent::Resize && isVisible()) {
+    UpdateGeometry();
+  }
+  if (watched != m_queryEdit || event->type() != QEvent::KeyPress) {
+    return QFrame::eventFilter(watched, event);
+  }
+
+  const auto *keyEvent = static_cast<QKeyEvent *>(event);
+  switch (keyEvent->key()) {
+  case Qt::Key_Down:
+  case Qt::Key_Up: {
+    const int step = keyEvent->key() == Qt::Key_Down ? 1 : -1;
+    const int lastRow = m_resultList->count() - 1;
+    m_resultList->setCurrentRow(std::clamp(m_resultList->currentRow() + step, 0, std::max(0, lastRow)));
+    return true;
+  }
+  case Qt::Key_Return:
+  case Qt::Key_Enter:
+    OpenCurrentHit();
+    return true;
+  case Qt::Key_Escape:
+    Close();
+    return true;
+  default:
+    return QFrame::eventFilter(watched, event);
+  }
+}
+
+void SearchOverlay::RunQuery(const QString &query) {
+  m_resultList->clear();
+  if (query.trimmed().isEmpty()) {
+    m_statusLabel->clear();
+    return;
+  }
+
+  QElapsedTimer queryTimer;
+  queryTimer.start();
+  const QList<SearchHit> hits = SearchIndex::Instance().Search(query, kMaxResults);
+  const qint64 queryMs = queryTimer.elapsed();
+  for (const SearchHit &hit : hits) {
+    const QString title = hit.title.trimmed().isEmpty() ? QStringLiteral("Untitled conversation") : hit.title;
+    auto *item = new QListWidgetItem(title + QLatin1Char('\n') + hit.snippet, m_resultList);
+    item->setData(kConversationKeyRole, hit.conversationKey);
+    item->setData(kTurnIndexRole, hit.turnIndex);
+  }
+  m_resultList->setCurrentRow(0);
+  m_statusLabel->setText(QStringLiteral("%1 results in %2 ms").arg(hits.size()).arg(queryMs));
+  qCInfo(lcPerformance).noquote() << "Search for" << query.size() << "chars returned" << hits.size() << "hits in"
+                                  << queryMs << "ms";
+}
+
+void SearchOverlay::OpenCurrentHit() {
+  const QListWidgetItem *item = m_resultList->currentItem();
+  if (item == nullptr) {
+    return;
+  }
+  SearchHit hit;
+  hit.conversationKey = item->data(kConversationKeyRole).toString();
+  hit.title = item->text().section(QLatin1Char('\n'), 0, 0);
+  hit.turnIndex = item->data(kTurnIndexRole).toInt();
+  Close();
+  m_openHandler(hit);
+}
+
+void SearchOverlay::UpdateGeometry() {
+  const QWidget *host = parentWidget();
+  const int width = std::min(kOverlayWidth, host->width() - 2 * kOverlayMinMargin);
+  const int height = std::min(kOverlayMaxHeight, host->height() - 2 * kOverlayTopMargin);
+  setGeometry((host->width() - width) / 2, kOverlayTopMargin, std::max(0, width), std::max(0, height));
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QFrame>
+#include <functional>
+
+struct SearchHit;
+class QEvent;
+class QLabel;
+class QLineEdit;
+class QListWidget;
+class QObject;
+class QWidget;
+
+// Search box over the window content, results come from the local conversation index
+class SearchOverlay final : public QFrame {
+public:
+  using OpenHandler = std::function<void(const SearchHit &hit)>;
+
+  SearchOverlay(OpenHandler openHandler, QWidget *parent);
+
+  // Show on top of the parent with the previous query selected
+  void Open();
+  void Close();
+
+protected:
+  // Follows parent resizes and drives the result list from the query field
+  bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+  void RunQuery(const QString &query);
+  void OpenCurrentHit();
+  void UpdateGeometry();
+
+  OpenHandler m_openHandler;
+  QLineEdit *m_queryEdit = nullptr;
+  QListWidget *m_resultList = nullptr;
+  QLabel *m_statusLabel = nullptr;
+};
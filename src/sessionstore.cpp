@@ -0,0 +1,251 @@
+#include "sessionstore.h"
+#include "appwindow.h"
+#include "browserprofile.h"
+#include "chatview.h"
+#include "perflog.h"
+#include "trustedorigins.h"
+
+#include <QApplication>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileDevice>
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QSaveFile>
+#include <QTimer>
+#include <QWidget>
+#include <algorithm>
+#include <utility>
+
+namespace {
+constexpr auto kSessionFileName = "session.json";
+constexpr int kFormatVersion = 1;
+// Window drags and route changes arrive in bursts, one write once they have stopped is enough
+constexpr int kSaveDebounceMs = 1000;
+// Scrolling alone triggers no native event, so anchors are read back on a slow beat
+constexpr int kAnchorRefreshIntervalMs = 30 * 1000;
+
+QList<AppWindow *> VisibleAppWindows(const AppWindow *closingWindow) {
+  QList<AppWindow *> windows;
+  for (QWidget *widget : QApplication::topLevelWidgets()) {
+    AppWindow *window = dynamic_cast<AppWindow *>(widget);
+    if (window != nullptr && window != closingWindow && window->isVisible()) {
+      windows.append(window);
+    }
+  }
+  return windows;
+}
+
+SessionWindow ReadWindow(const QJsonObject &object) {
+  SessionWindow window;
+  window.geometry = QByteArray::fromBase64(object.value(QStringLiteral("geometry")).toString().toLatin1());
+  window.focused = object.value(QStringLiteral("focused")).toBool();
+  const QJsonArray tabs = object.value(QStringLiteral("tabs")).toArray();
+  const int savedCurrentTab = object.value(QStringLiteral("currentTab")).toInt();
+  for (qsizetype index = 0; index < tabs.size(); ++index) {
+    const QJsonObject tabObject = tabs.at(index).toObject();
+    SessionTab tab;
+    tab.url = QUrl(tabObject.value(QStringLiteral("url")).toString());
+    // The file is plain text on disk, only pages the app would open on its own come back
+    if (!TrustedOrigins::IsTrustedHttpsUrl(tab.url)) {
+      continue;
+    }
+    tab.title = tabObject.value(QStringLiteral("title")).toString();
+    tab.scrollTurn = tabObject.value(QStringLiteral("scrollTurn")).toInt(-1);
+    if (index == savedCurrentTab) {
+      window.currentTab = static_cast<int>(window.tabs.size());
+    }
+    window.tabs.append(tab);
+  }
+  return window;
+}
+
+QJsonObject WriteWindow(const SessionWindow &window) {
+  QJsonArray tabs;
+  for (const SessionTab &tab : window.tabs) {
+    tabs.append(QJsonObject{{QStringLiteral("url"), tab.url.toString(QUrl::FullyEncoded)},
+                            {QStringLiteral("title"), tab.title},
+                            {QStringLiteral("scrollTurn"), tab.scrollTurn}});
+  }
+  return QJsonObject{{QStringLiteral("geometry"), QString::fromLatin1(window.geometry.toBase64())},
+                     {QStringLiteral("focused"), window.focused},
+                     {QStringLiteral("currentTab"), window.currentTab},
+                     {QStringLiteral("tabs"), tabs}};
+}
+} // namespace
+
+SessionStore &SessionStore::Instance() {
+  // Function static keeps one session writer for the whole process
+  static SessionStore instance;
+  return instance;
+}
+
+SessionStore::SessionStore() {
+  m_saveTimer = new QTimer(QCoreApplication::instance());
+  m_saveTimer->setSingleShot(true);
+  m_saveTimer->setInterval(kSaveDebounceMs);
+  QObject::connect(m_saveTimer, &QTimer::timeout, m_saveTimer, [this]() {
+    RefreshScrollAnchors();
+    SaveNow();
+  });
+  m_anchorTimer = new QTimer(QCoreApplication::instance());
+  m_anchorTimer->setInterval(kAnchorRefreshIntervalMs);
+  QObject::connect(m_anchorTimer, &QTimer::timeout, m_anchorTimer, [this]() { RefreshScrollAnchors(); });
+}
+
+bool SessionStore::IsEnabled() {
+  const QString value = qEnvironmentVariable("CHATGPT_DESKTOP_RESTORE_SESSION").trimmed().toLower();
+  return value != QStringLiteral("0") && value != QStringLiteral("false") && value != QStringLiteral("off");
+}
+
+bool SessionStore::CanUseSessionFile() const {
+  return IsEnabled() && BrowserProfile::Instance().OwnsMainProfile() &&
+         !BrowserProfile::Instance().StoragePath().isEmpty();
+}
+
+QString SessionStore::SessionFilePath() const {
+  return QDir(BrowserProfile::Instance().StoragePath()).filePath(QString::fromLatin1(kSessionFileName));
+}
+
+QList<SessionWindow> SessionStore::Load(bool keepTabs) {
+  if (!CanUseSessionFile()) {
+    return {};
+  }
+  m_saving = true;
+  m_anchorTimer->start();
+
+  QElapsedTimer readTimer;
+  readTimer.start();
+  QFile file(SessionFilePath());
+  if (!file.open(QIODevice::ReadOnly)) {
+    return {};
+  }
+  m_lastWritten = file.readAll();
+  const QJsonObject root = QJsonDocument::fromJson(m_lastWritten).object();
+  if (root.value(QStringLiteral("version")).toInt() != kFormatVersion) {
+    return {};
+  }
+
+  QList<SessionWindow> windows;
+  qsizetype tabCount = 0;
+  for (const QJsonValue &value : root.value(QStringLiteral("windows")).toArray()) {
+    SessionWindow window = ReadWindow(value.toObject());
+    if (window.tabs.isEmpty()) {
+      continue;
+    }
+    tabCount += window.tabs.size();
+    if (keepTabs || window.tabs.size() == 1) {
+      windows.append(std::move(window));
+      continue;
+    }
+    // Without tabs every saved tab gets a window of its own, only the one that was in front keeps focus
+    for (qsizetype index = 0; index < window.tabs.size(); ++index) {
+      SessionWindow single;
+      single.geometry = window.geometry;
+      single.tabs = {window.tabs.at(index)};
+      single.focused = window.focused && index == window.currentTab;
+      windows.append(std::move(single));
+    }
+  }
+  // Exactly one window loads at startup, the focused one or else the first
+  const auto focused = std::find_if(windows.begin(), windows.end(),
+                                    [](const SessionWindow &window) { return window.focused; });
+  if (focused != windows.end()) {
+    std::rotate(windows.begin(), focused, focused + 1);
+  }
+  for (qsizetype index = 0; index < windows.size(); ++index) {
+    windows[index].focused = index == 0;
+  }
+  qCInfo(lcPerformance).noquote() << "Session file:" << windows.size() << "windows," << tabCount << "tabs read in"
+                                  << readTimer.elapsed() << "ms";
+  return windows;
+}
+
+void SessionStore::ScheduleSave() {
+  if (!m_saving || m_finished) {
+    return;
+  }
+  // Restarting keeps pushing the write back while changes keep coming
+  m_saveTimer->start();
+}
+
+void SessionStore::SaveNow() {
+  if (!m_saving || m_finished) {
+    return;
+  }
+  m_saveTimer->stop();
+  const QList<SessionWindow> windows = CollectWindows();
+  // With every window gone the last layout on disk is the one to come back to
+  if (!windows.isEmpty()) {
+    Write(windows);
+  }
+}
+
+void SessionStore::Finish() {
+  SaveNow();
+  m_anchorTimer->stop();
+  m_finished = true;
+}
+
+void SessionStore::NoteActiveWindow(AppWindow *window) {
+  m_activeWindow = window;
+  ScheduleSave();
+}
+
+void SessionStore::NoteWindowClosing(const AppWindow *window) {
+  if (!VisibleAppWindows(window).isEmpty()) {
+    ScheduleSave();
+    return;
+  }
+  SaveNow();
+}
+
+QList<SessionWindow> SessionStore::CollectWindows() const {
+  QList<SessionWindow> windows;
+  const AppWindow *focusedWindow = m_activeWindow.data();
+  for (const AppWindow *window : VisibleAppWindows(nullptr)) {
+    SessionWindow state = window->SessionState();
+    if (state.tabs.isEmpty()) {
+      continue;
+    }
+    state.focused = window == focusedWindow;
+    windows.append(std::move(state));
+  }
+  return windows;
+}
+
+void SessionStore::Write(const QList<SessionWindow> &windows) {
+  QJsonArray windowArray;
+  for (const SessionWindow &window : windows) {
+    windowArray.append(WriteWindow(window));
+  }
+  const QByteArray bytes =
+      QJsonDocument(QJsonObject{{QStringLiteral("version"), kFormatVersion}, {QStringLiteral("windows"), windowArray}})
+          .toJson(QJsonDocument::Compact);
+  if (bytes == m_lastWritten) {
+    return;
+  }
+
+  const QString path = SessionFilePath();
+  QSaveFile file(path);
+  if (!file.open(QIODevice::WriteOnly) || file.write(bytes) != bytes.size() || !file.commit()) {
+    qWarning() << "Failed to write session file:" << path << file.errorString();
+    return;
+  }
+  // Conversation URLs and titles are private, keep them to the owning user
+  QFile::setPermissions(path, QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+  m_lastWritten = bytes;
+}
+
+void SessionStore::RefreshScrollAnchors() const {
+  for (const AppWindow *window : VisibleAppWindows(nullptr)) {
+    for (ChatView *view : window->ChatViews()) {
+      view->RefreshScrollAnchor();
+    }
+  }
+}
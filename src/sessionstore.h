@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QPointer>
+#include <QString>
+#include <QUrl>
+
+class AppWindow;
+class QTimer;
+
+struct SessionTab {
+  QUrl url;
+  QString title;
+  // First conversation turn on screen, -1 when unknown
+  int scrollTurn = -1;
+};
+
+struct SessionWindow {
+  // QWidget::saveGeometry output, covers screen, size and maximized state
+  QByteArray geometry;
+  QList<SessionTab> tabs;
+  int currentTab = 0;
+  bool focused = false;
+};
+
+class SessionStore final {
+public:
+  // One session file per profile, shared by every window in the process
+  static SessionStore &Instance();
+
+  // CHATGPT_DESKTOP_RESTORE_SESSION=0 starts with one fresh window and saves nothing
+  static bool IsEnabled();
+
+  // Windows of the last run, focused one first, tabs split into windows when tabs are off
+  QList<SessionWindow> Load(bool keepTabs);
+  // Moves, navigations and tab changes all end up here, one write follows once they stop
+  void ScheduleSave();
+  // Writes right away, a window closing may be the last one for a while but the app keeps running
+  void SaveNow();
+  // Quit paths write once more, the teardown that follows does not overwrite it
+  void Finish();
+  // The focused window is the one that loads right away next launch
+  void NoteActiveWindow(AppWindow *window);
+  // The last window to close writes its layout before it goes away
+  void NoteWindowClosing(const AppWindow *window);
+
+private:
+  SessionStore();
+  ~SessionStore() = default;
+
+  // Isolated copies neither restore nor save, the profile owner's session is the one that comes back
+  bool CanUseSessionFile() const;
+  QString SessionFilePath() const;
+  QList<SessionWindow> CollectWindows() const;
+  void Write(const QList<SessionWindow> &windows);
+  // Page scroll positions are read asynchronously, a changed one schedules another save
+  void RefreshScrollAnchors() const;
+
+  QTimer *m_saveTimer = nullptr;
+  QTimer *m_anchorTimer = nullptr;
+  QPointer<AppWindow> m_activeWindow;
+  // Unchanged sessions are not written again
+  QByteArray m_lastWritten;
+  // Saving starts with Load, runs with a start URL override leave the session alone
+  bool m_saving = false;
+  bool m_finished = false;
+};
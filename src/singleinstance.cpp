@@ -0,0 +1,178 @@
+#include "singleinstance.h"
+
+#include <QByteArray>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+constexpr auto kSocketName = "chatgpt-desktop-unix-instance.sock";
+// A healthy owner answers almost at once, a stuck one should not hold the launcher
+constexpr int kReplyTimeoutMs = 1500;
+constexpr int kConnectionTimeoutMs = 3000;
+// Start URLs are short, so anything bigger is not a real launch request
+constexpr qint64 kMaxRequestBytes = 64 * 1024;
+const QByteArray kReplyOk = QByteArrayLiteral("ok\n");
+
+QString ResolveSocketPath() {
+  // The runtime dir is private to the user and cleared on logout
+  const QString runtimeRoot = qEnvironmentVariable("XDG_RUNTIME_DIR");
+  if (!runtimeRoot.isEmpty()) {
+    return QDir(runtimeRoot).filePath(QString::fromLatin1(kSocketName));
+  }
+
+  // Keep the fallback name per user so shared temp dirs do not mix owners
+  return QDir(QDir::tempPath())
+      .filePath(QStringLiteral("%1-%2").arg(::getuid()).arg(QString::fromLatin1(kSocketName)));
+}
+
+bool WriteAll(int socketDescriptor, const QByteArray &bytes) {
+  qsizetype offset = 0;
+  while (offset < bytes.size()) {
+    const ssize_t written = ::write(socketDescriptor, bytes.constData() + offset,
+                                    static_cast<size_t>(bytes.size() - offset));
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    offset += written;
+  }
+  return true;
+}
+
+bool WaitForReply(int socketDescriptor) {
+  QByteArray reply;
+  pollfd pollDescriptor{};
+  pollDescriptor.fd = socketDescriptor;
+  pollDescriptor.events = POLLIN;
+
+  // The reply is a single short line, so a few reads are always enough
+  while (reply.size() < kReplyOk.size()) {
+    const int ready = ::poll(&pollDescriptor, 1, kReplyTimeoutMs);
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ready <= 0) {
+      return false;
+    }
+
+    char buffer[16];
+    const ssize_t bytesRead = ::read(socketDescriptor, buffer, sizeof(buffer));
+    if (bytesRead < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytesRead <= 0) {
+      return false;
+    }
+    reply.append(buffer, bytesRead);
+  }
+
+  return reply.startsWith(kReplyOk);
+}
+
+QUrl ParseForwardedUrl(const QByteArray &line) {
+  const QByteArray encodedUrl = line.trimmed();
+  if (encodedUrl.isEmpty()) {
+    // An empty line asks for the normal start page
+    return QUrl();
+  }
+
+  const QUrl forwardedUrl = QUrl::fromEncoded(encodedUrl);
+  return forwardedUrl.isValid() ? forwardedUrl : QUrl();
+}
+
+void HandleConnection(QLocalSocket *connection, const std::function<void(const QUrl &)> &openWindow) {
+  QObject::connect(connection, &QLocalSocket::disconnected, connection, &QObject::deleteLater);
+  // Drop clients that connect and then never finish their request
+  QTimer::singleShot(kConnectionTimeoutMs, connection, [connection]() { connection->abort(); });
+
+  QObject::connect(connection, &QLocalSocket::readyRead, connection, [connection, openWindow]() {
+    if (!connection->canReadLine()) {
+      if (connection->bytesAvailable() > kMaxRequestBytes) {
+        connection->abort();
+      }
+      return;
+    }
+
+    const QUrl forwardedUrl = ParseForwardedUrl(connection->readLine(kMaxRequestBytes));
+    // Answer first so the second launch can exit while the window is built
+    connection->write(kReplyOk);
+    connection->flush();
+    connection->disconnectFromServer();
+
+    if (openWindow) {
+      openWindow(forwardedUrl);
+    }
+  });
+}
+} // namespace
+
+namespace SingleInstance {
+
+bool IsEnabled() {
+  const QString value = qEnvironmentVariable("CHATGPT_DESKTOP_SINGLE_INSTANCE").trimmed().toLower();
+  return value != QStringLiteral("0") && value != QStringLiteral("false") && value != QStringLiteral("off");
+}
+
+bool ForwardToRunningInstance(const QUrl &startUrl) {
+  // Plain POSIX calls work before QApplication exists and keep this path fast
+  const QByteArray socketPath = QFile::encodeName(ResolveSocketPath());
+  sockaddr_un address{};
+  if (socketPath.isEmpty() || static_cast<size_t>(socketPath.size()) >= sizeof(address.sun_path)) {
+    return false;
+  }
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, socketPath.constData(), static_cast<size_t>(socketPath.size()));
+
+  const int socketDescriptor = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (socketDescriptor < 0) {
+    return false;
+  }
+
+  // A missing or refused socket just means no owner is running
+  bool forwarded = ::connect(socketDescriptor, reinterpret_cast<const sockaddr *>(&address),
+                             sizeof(address)) == 0;
+  if (forwarded) {
+    forwarded = WriteAll(socketDescriptor, startUrl.toEncoded() + '\n') && WaitForReply(socketDescriptor);
+  }
+
+  ::close(socketDescriptor);
+  return forwarded;
+}
+
+void StartListening(QObject *parent, const std::function<void(const QUrl &)> &openWindow) {
+  const QString socketPath = ResolveSocketPath();
+  QLocalServer *server = new QLocalServer(parent);
+  server->setSocketOptions(QLocalServer::UserAccessOption);
+
+  if (!server->listen(socketPath)) {
+    // Only the main profile owner listens, so a leftover socket file is stale
+    QLocalServer::removeServer(socketPath);
+    if (!server->listen(socketPath)) {
+      qWarning() << "Failed to listen for other app launches:" << socketPath << server->errorString();
+      delete server;
+      return;
+    }
+  }
+
+  QObject::connect(server, &QLocalServer::newConnection, server, [server, openWindow]() {
+    while (QLocalSocket *connection = server->nextPendingConnection()) {
+      HandleConnection(connection, openWindow);
+    }
+  });
+}
+
+} // namespace SingleInstance
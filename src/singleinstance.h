@@ -0,0 +1,17 @@
+#pragma once
+
+#include <QUrl>
+#include <functional>
+
+class QObject;
+
+namespace SingleInstance {
+
+// Users can opt out with CHATGPT_DESKTOP_SINGLE_INSTANCE=0
+bool IsEnabled();
+// Hand the start URL to a running owner before any Qt app setup
+bool ForwardToRunningInstance(const QUrl &startUrl);
+// Accept later launches once this process owns the main profile
+void StartListening(QObject *parent, const std::function<void(const QUrl &)> &openWindow);
+
+} // namespace SingleInstance
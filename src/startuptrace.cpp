@@ -0,0 +1,214 @@
+#include "startuptrace.h"
+#include "metrics.h"
+
+#include <QByteArray>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QVariantMap>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+constexpr auto kTraceFlagPrefix = "--trace-startup=";
+// Separate trace rows keep native phases and page marks easy to tell apart
+constexpr int kNativeThreadId = 1;
+constexpr int kPageThreadId = 2;
+
+struct TraceEvent {
+  QString name;
+  char phase = 'X';
+  qint64 timestampUs = 0;
+  qint64 durationUs = 0;
+  int threadId = kNativeThreadId;
+};
+
+struct OpenPhase {
+  const char *name = nullptr;
+  qint64 startedAtUs = 0;
+};
+
+struct TraceState {
+  QString outputPath;
+  bool finished = false;
+  // Monotonic time drives native events, wall time lines up page marks with them
+  std::chrono::steady_clock::time_point steadyOrigin;
+  qint64 wallOriginUs = 0;
+  std::vector<OpenPhase> openPhases;
+  std::vector<TraceEvent> events;
+};
+
+TraceState &State() {
+  static TraceState state;
+  return state;
+}
+
+bool IsRecording() {
+  const TraceState &state = State();
+  return !state.outputPath.isEmpty() && !state.finished;
+}
+
+qint64 NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                               State().steadyOrigin)
+      .count();
+}
+
+QJsonObject ToJson(const TraceEvent &event) {
+  QJsonObject object;
+  object.insert(QStringLiteral("name"), event.name);
+  object.insert(QStringLiteral("ph"), QString(QLatin1Char(event.phase)));
+  object.insert(QStringLiteral("ts"), event.timestampUs);
+  object.insert(QStringLiteral("pid"), static_cast<qint64>(::getpid()));
+  object.insert(QStringLiteral("tid"), event.threadId);
+  if (event.phase == 'X') {
+    object.insert(QStringLiteral("dur"), event.durationUs);
+  } else if (event.phase == 'i') {
+    // Process scoped instants draw as full height lines in Perfetto
+    object.insert(QStringLiteral("s"), QStringLiteral("p"));
+  }
+  return object;
+}
+
+QJsonObject ThreadNameEvent(int threadId, const QString &threadName) {
+  QJsonObject args;
+  args.insert(QStringLiteral("name"), threadName);
+  QJsonObject object;
+  object.insert(QStringLiteral("name"), QStringLiteral("thread_name"));
+  object.insert(QStringLiteral("ph"), QStringLiteral("M"));
+  object.insert(QStringLiteral("pid"), static_cast<qint64>(::getpid()));
+  object.insert(QStringLiteral("tid"), threadId);
+  object.insert(QStringLiteral("args"), args);
+  return object;
+}
+} // namespace
+
+namespace StartupTrace {
+
+void Initialize(int argc, char *argv[]) {
+  TraceState &state = State();
+  state.steadyOrigin = std::chrono::steady_clock::now();
+  state.wallOriginUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                           .count();
+
+  // The CLI flag wins so one traced run does not need a changed environment
+  state.outputPath = qEnvironmentVariable("CHATGPT_DESKTOP_TRACE_FILE");
+  const size_t flagLength = std::strlen(kTraceFlagPrefix);
+  for (int index = 1; index < argc; ++index) {
+    if (std::strncmp(argv[index], kTraceFlagPrefix, flagLength) == 0) {
+      state.outputPath = QString::fromLocal8Bit(argv[index] + flagLength);
+    }
+  }
+
+  if (!state.outputPath.isEmpty()) {
+    state.events.reserve(64);
+    Instant("main");
+  }
+}
+
+bool IsEnabled() { return IsRecording(); }
+
+void Begin(const char *phaseName) {
+  // Phases are timed even without a trace file, the metrics endpoint reports them too
+  State().openPhases.push_back(OpenPhase{phaseName, NowUs()});
+}
+
+void End(const char *phaseName) {
+  TraceState &state = State();
+  // Phases nest, so the newest open phase with this name is the one ending
+  for (auto phase = state.openPhases.rbegin(); phase != state.openPhases.rend(); ++phase) {
+    if (std::strcmp(phase->name, phaseName) != 0) {
+      continue;
+    }
+    const qint64 endedAtUs = NowUs();
+    Metrics::RecordStartupPhase(phaseName, endedAtUs - phase->startedAtUs);
+    if (IsRecording()) {
+      state.events.push_back(TraceEvent{QString::fromLatin1(phaseName), 'X', phase->startedAtUs,
+                                        endedAtUs - phase->startedAtUs, kNativeThreadId});
+    }
+    state.openPhases.erase(std::next(phase).base());
+    return;
+  }
+}
+
+void Instant(const char *eventName) {
+  const qint64 nowUs = NowUs();
+  Metrics::RecordStartupMark(eventName, nowUs);
+  if (!IsRecording()) {
+    return;
+  }
+  State().events.push_back(TraceEvent{QString::fromLatin1(eventName), 'i', nowUs, 0, kNativeThreadId});
+}
+
+void MergePageEvents(const QVariantList &pageEvents) {
+  if (!IsRecording()) {
+    return;
+  }
+
+  TraceState &state = State();
+  for (const QVariant &pageEvent : pageEvents) {
+    const QVariantMap fields = pageEvent.toMap();
+    const QString name = fields.value(QStringLiteral("name")).toString();
+    const double epochMs = fields.value(QStringLiteral("ts")).toDouble();
+    if (name.isEmpty() || epochMs <= 0.0) {
+      continue;
+    }
+
+    // Page time is wall clock, shift it onto the native trace origin
+    const qint64 timestampUs = static_cast<qint64>(epochMs * 1000.0) - state.wallOriginUs;
+    const qint64 durationUs = static_cast<qint64>(fields.value(QStringLiteral("dur")).toDouble() * 1000.0);
+    state.events.push_back(
+        TraceEvent{name, durationUs > 0 ? 'X' : 'i', timestampUs, durationUs, kPageThreadId});
+  }
+}
+
+void Finish() {
+  if (!IsRecording()) {
+    return;
+  }
+
+  TraceState &state = State();
+  state.finished = true;
+
+  QJsonArray traceEvents;
+  traceEvents.append(ThreadNameEvent(kNativeThreadId, QStringLiteral("native")));
+  traceEvents.append(ThreadNameEvent(kPageThreadId, QStringLiteral("page")));
+  for (const TraceEvent &event : state.events) {
+    traceEvents.append(ToJson(event));
+  }
+
+  QJsonObject root;
+  root.insert(QStringLiteral("traceEvents"), traceEvents);
+  root.insert(QStringLiteral("displayTimeUnit"), QStringLiteral("ms"));
+
+  const QFileInfo outputInfo(state.outputPath);
+  if (!QDir().mkpath(outputInfo.absolutePath())) {
+    qWarning() << "Failed to create startup trace directory:" << outputInfo.absolutePath();
+    return;
+  }
+
+  // QSaveFile keeps a half written trace from replacing a good one
+  QSaveFile outputFile(state.outputPath);
+  if (!outputFile.open(QIODevice::WriteOnly)) {
+    qWarning() << "Failed to open startup trace file:" << state.outputPath;
+    return;
+  }
+  outputFile.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+  if (!outputFile.commit()) {
+    qWarning() << "Failed to write startup trace file:" << state.outputPath;
+  }
+}
+
+Scope::Scope(const char *phaseName) : m_phaseName(phaseName) { Begin(m_phaseName); }
+
+Scope::~Scope() { End(m_phaseName); }
+
+} // namespace StartupTrace
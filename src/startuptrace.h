@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QString>
+#include <QVariantList>
+#include <QtGlobal>
+
+namespace StartupTrace {
+
+// Tracing turns on when CHATGPT_DESKTOP_TRACE_FILE or --trace-startup=<path> names an output file
+void Initialize(int argc, char *argv[]);
+bool IsEnabled();
+
+// Phases that start and end in different places, such as QApplication construction
+void Begin(const char *phaseName);
+void End(const char *phaseName);
+// Point events like the first loadStarted
+void Instant(const char *eventName);
+// Page marks arrive as maps with a name, an epoch ms timestamp and an optional duration
+void MergePageEvents(const QVariantList &pageEvents);
+// Write the Chrome trace JSON once, later events are dropped
+void Finish();
+
+// Covers one native phase for the lifetime of the scope
+class Scope final {
+public:
+  explicit Scope(const char *phaseName);
+  ~Scope();
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+private:
+  const char *m_phaseName;
+};
+
+} // namespace StartupTrace
@@ -1,29 +1,53 @@
 #include "trustedorigins.h"
+#include "originpolicy.h"
 
 #include <QString>
+#include <QStringView>
+#include <cstddef>
+#include <string_view>
 
-namespace TrustedOrigins {
+namespace {
+constexpr bool MatchesPolicy(std::u16string_view host) {
+  return OriginPolicy::MatchesTrustedDomain(host.data(), host.size());
+}
 
-bool IsTrustedHost(const QString &host) {
-  if (host.isEmpty()) {
-    return false;
-  }
+// The generated matcher is constexpr, so a broken policy fails the build instead of a page
+static_assert(MatchesPolicy(u"chatgpt.com"));
+static_assert(MatchesPolicy(u"CDN.OAISTATIC.COM"));
+static_assert(!MatchesPolicy(u"evilchatgpt.com"));
+static_assert(!MatchesPolicy(u"chatgpt.com.evil.net"));
+static_assert(!MatchesPolicy(u"openai.com."));
 
-  const QString normalizedHost = host.toLower();
-  if (normalizedHost == QStringLiteral("chatgpt.com") ||
-      normalizedHost.endsWith(QStringLiteral(".chatgpt.com"))) {
-    return true;
+// Host part of "https://host[:port]/..." without building another QUrl
+QStringView EmbeddedHttpsHost(QStringView embeddedUrl) {
+  const QStringView prefix = u"https://";
+  if (!embeddedUrl.startsWith(prefix)) {
+    return {};
   }
-  if (normalizedHost == QStringLiteral("openai.com") ||
-      normalizedHost.endsWith(QStringLiteral(".openai.com"))) {
-    return true;
+  QStringView authority = embeddedUrl.mid(prefix.size());
+  for (qsizetype index = 0; index < authority.size(); ++index) {
+    const QChar character = authority.at(index);
+    if (character == u'/' || character == u'?' || character == u'#') {
+      authority.truncate(index);
+      break;
+    }
   }
-  if (normalizedHost == QStringLiteral("oaistatic.com") ||
-      normalizedHost.endsWith(QStringLiteral(".oaistatic.com"))) {
-    return true;
+  // Credentials and IPv6 literals never appear in page origins, treat them as untrusted
+  if (authority.contains(u'@') || authority.startsWith(u'[')) {
+    return {};
   }
+  const qsizetype portSeparator = authority.indexOf(u':');
+  return portSeparator >= 0 ? authority.first(portSeparator) : authority;
+}
+} // namespace
 
-  return false;
+namespace TrustedOrigins {
+
+bool IsTrustedHost(QStringView host) {
+  if (host.isEmpty()) {
+    return false;
+  }
+  return MatchesPolicy(std::u16string_view(host.utf16(), static_cast<std::size_t>(host.size())));
 }
 
 bool IsTrustedHttpsUrl(const QUrl &url) {
@@ -50,12 +74,8 @@ bool IsTrustedClipboardOrigin(const QUrl &origin, const QUrl &fallbackPageUrl) {
 
   // Blob URLs wrap an HTTPS origin in the URL text
   if (origin.scheme() == QStringLiteral("blob")) {
-    const QString originString = origin.toString();
-    const QString blobPrefix = QStringLiteral("blob:https://");
-    if (originString.startsWith(blobPrefix)) {
-      const QUrl embeddedOrigin(QStringLiteral("https://") + originString.mid(blobPrefix.size()));
-      return IsTrustedHost(embeddedOrigin.host());
-    }
+    const QString embeddedUrl = origin.path();
+    return IsTrustedHost(EmbeddedHttpsHost(embeddedUrl));
   }
 
   // Same-document jumps can report these light-weight schemes
@@ -1,12 +1,12 @@
 #pragma once
 
-#include <QString>
+#include <QStringView>
 #include <QUrl>
 
 namespace TrustedOrigins {
 
-// Keep the small allowlist in one native place
-bool IsTrustedHost(const QString &host);
+// Backed by the generated OriginPolicy matcher, the same list the page helper gets
+bool IsTrustedHost(QStringView host);
 // Gate browser settings that should only run on trusted HTTPS pages
 bool IsTrustedHttpsUrl(const QUrl &url);
 // Accept the same origin forms the page bridge can emit
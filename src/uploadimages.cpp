@@ -0,0 +1,213 @@
+#include "uploadimages.h"
+#include "browserprofile.h"
+#include "perflog.h"
+
+#include <QBuffer>
+#include <QByteArray>
+#include <QColorSpace>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QImage>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QSaveFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QtGlobal>
+#include <algorithm>
+#include <vector>
+
+namespace {
+constexpr int kJpegQuality = 85;
+// Each worker can hold a full size decode, so a few are enough to keep the cores busy
+constexpr int kMaxWorkers = 4;
+// Larger files are passed through, decoding them would hold up the picker too long
+constexpr qint64 kMaxSourceBytes = 256LL * 1024 * 1024;
+// Cached copies not attached again for this long are removed at the next batch
+constexpr qint64 kCacheMaxAgeMs = 7LL * 24 * 60 * 60 * 1000;
+// Animated GIFs and vector images would lose what they are, so only still raster formats qualify
+const QList<QByteArray> kProcessedFormats = {"jpeg", "jpg", "png", "webp", "heic", "heif", "bmp", "tiff"};
+
+enum class Outcome { PassedThrough, Downscaled, Cached };
+
+struct PreparedFile {
+  QString path;
+  Outcome outcome = Outcome::PassedThrough;
+  qint64 sourceBytes = 0;
+  qint64 outputBytes = 0;
+};
+
+// First file in the entry directory, named after the original so the page shows a familiar name
+QString CachedOutput(const QString &entryDirectory) {
+  const QStringList entries = QDir(entryDirectory).entryList(QDir::Files);
+  return entries.isEmpty() ? QString() : QDir(entryDirectory).filePath(entries.first());
+}
+
+QImage StrippedImage(QImage image) {
+  // Pixels are moved to sRGB, the profile, EXIF and text chunks stay behind with the source
+  if (image.colorSpace().isValid() && image.colorSpace() != QColorSpace(QColorSpace::SRgb)) {
+    image.convertToColorSpace(QColorSpace(QColorSpace::SRgb));
+  }
+  const QImage converted =
+      image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+  // Wrapping the raw bits gives an image with no text keys or color space, copy() detaches it
+  return QImage(converted.constBits(), converted.width(), converted.height(), converted.bytesPerLine(),
+                converted.format())
+      .copy();
+}
+
+PreparedFile PrepareFile(const QString &path, const QString &cacheDirectory, int maxEdge) {
+  PreparedFile result;
+  result.path = path;
+  QFile source(path);
+  if (!source.open(QIODevice::ReadOnly)) {
+    return result;
+  }
+  result.sourceBytes = source.size();
+  result.outputBytes = result.sourceBytes;
+  if (result.sourceBytes > kMaxSourceBytes) {
+    return result;
+  }
+
+  // The reader pulls from the file as it decodes, the source is never held in memory whole
+  QImageReader reader(&source);
+  // Phones store orientation in EXIF, it has to be applied before the tag is dropped
+  reader.setAutoTransform(true);
+  const QSize sourceSize = reader.size();
+  if (!kProcessedFormats.contains(reader.format().toLower()) || !sourceSize.isValid() ||
+      std::max(sourceSize.width(), sourceSize.height()) <= maxEdge) {
+    return result;
+  }
+
+  // The key covers content and settings, the same photo attached again is not decoded twice
+  // A second handle streams the file through the hash and leaves the reader's position alone
+  QFile hashSource(path);
+  QCryptographicHash hash(QCryptographicHash::Sha256);
+  if (!hashSource.open(QIODevice::ReadOnly) || !hash.addData(&hashSource)) {
+    return result;
+  }
+  hashSource.close();
+  hash.addData(QByteArray::number(maxEdge) + ':' + QByteArray::number(kJpegQuality));
+  const QString entryDirectory = QDir(cacheDirectory).filePath(QString::fromLatin1(hash.result().toHex().left(32)));
+  const QString cachedPath = CachedOutput(entryDirectory);
+  if (!cachedPath.isEmpty()) {
+    QFile cachedFile(cachedPath);
+    if (cachedFile.open(QIODevice::ReadWrite)) {
+      // Reuse counts as a fresh attach for the age based cleanup
+      cachedFile.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+    }
+    result.path = cachedPath;
+    result.outcome = Outcome::Cached;
+    result.outputBytes = QFileInfo(cachedPath).size();
+    return result;
+  }
+
+  // JPEG and WebP decoders scale while decoding, so large photos never exist at full size in memory
+  reader.setScaledSize(sourceSize.scaled(maxEdge, maxEdge, Qt::KeepAspectRatio));
+  const QImage decoded = reader.read();
+  if (decoded.isNull()) {
+    return result;
+  }
+  const QImage stripped = StrippedImage(decoded);
+
+  // Screenshots and transparent images stay lossless so text and edges survive
+  const bool lossless = reader.format().toLower() == "png" || stripped.hasAlphaChannel();
+  QBuffer encodedBuffer;
+  encodedBuffer.open(QIODevice::WriteOnly);
+  QImageWriter writer(&encodedBuffer, lossless ? QByteArrayLiteral("png") : QByteArrayLiteral("jpeg"));
+  writer.setQuality(lossless ? -1 : kJpegQuality);
+  writer.setOptimizedWrite(true);
+  if (!writer.write(stripped) || encodedBuffer.size() >= result.sourceBytes) {
+    return result;
+  }
+
+  const QString outputName =
+      QFileInfo(path).completeBaseName() + (lossless ? QStringLiteral(".png") : QStringLiteral(".jpg"));
+  QSaveFile output(QDir(entryDirectory).filePath(outputName));
+  if (!QDir().mkpath(entryDirectory) || !output.open(QIODevice::WriteOnly) ||
+      output.write(encodedBuffer.data()) != encodedBuffer.size() || !output.commit()) {
+    qWarning() << "Failed to write downscaled upload for" << path;
+    return result;
+  }
+  result.path = output.fileName();
+  result.outcome = Outcome::Downscaled;
+  result.outputBytes = encodedBuffer.size();
+  return result;
+}
+
+void RemoveStaleEntries(const QString &cacheDirectory) {
+  const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+  for (const QFileInfo &entry : QDir(cacheDirectory).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+    const QString cachedPath = CachedOutput(entry.absoluteFilePath());
+    const qint64 touchedMs = cachedPath.isEmpty() ? entry.lastModified().toMSecsSinceEpoch()
+                                                  : QFileInfo(cachedPath).lastModified().toMSecsSinceEpoch();
+    if (nowMs - touchedMs > kCacheMaxAgeMs) {
+      QDir(entry.absoluteFilePath()).removeRecursively();
+    }
+  }
+}
+} // namespace
+
+namespace UploadImages {
+
+int MaxEdge() {
+  static const int maxEdge = std::max(0, qEnvironmentVariableIntValue("CHATGPT_DESKTOP_UPLOAD_MAX_EDGE"));
+  return maxEdge;
+}
+
+bool IsEnabled() { return MaxEdge() > 0; }
+
+QStringList Prepare(const QStringList &files) {
+  if (!IsEnabled() || files.isEmpty()) {
+    return files;
+  }
+
+  QElapsedTimer batchTimer;
+  batchTimer.start();
+  const int maxEdge = MaxEdge();
+  const QString cacheDirectory =
+      QDir(BrowserProfile::Instance().ResolveCacheRoot()).filePath(QStringLiteral("upload-images"));
+
+  std::vector<PreparedFile> results(static_cast<size_t>(files.size()));
+  QThreadPool workers;
+  workers.setMaxThreadCount(std::clamp(QThread::idealThreadCount(), 1, kMaxWorkers));
+  for (qsizetype index = 0; index < files.size(); ++index) {
+    workers.start([&, index]() {
+      results[static_cast<size_t>(index)] = PrepareFile(files.at(index), cacheDirectory, maxEdge);
+    });
+  }
+  // Blocking on purpose, an event loop here would let timers discard or close the page that asked
+  // Scaled decodes keep the wait short
+  workers.waitForDone();
+
+  QStringList preparedFiles;
+  preparedFiles.reserve(files.size());
+  qint64 sourceBytes = 0;
+  qint64 outputBytes = 0;
+  int downscaledCount = 0;
+  int cachedCount = 0;
+  for (const PreparedFile &prepared : results) {
+    preparedFiles.append(prepared.path);
+    sourceBytes += prepared.sourceBytes;
+    outputBytes += prepared.outputBytes;
+    downscaledCount += prepared.outcome == Outcome::Downscaled ? 1 : 0;
+    cachedCount += prepared.outcome == Outcome::Cached ? 1 : 0;
+  }
+  qCInfo(lcPerformance).noquote() << "Upload images:" << files.size() << "files," << downscaledCount << "downscaled,"
+                                  << cachedCount << "from cache," << sourceBytes / 1024 << "KiB to"
+                                  << outputBytes / 1024 << "KiB, saved" << (sourceBytes - outputBytes) / 1024
+                                  << "KiB in" << batchTimer.elapsed() << "ms on" << workers.maxThreadCount()
+                                  << "threads";
+
+  // Cleanup only touches the cache, the batch does not wait for it
+  QThreadPool::globalInstance()->start([cacheDirectory]() { RemoveStaleEntries(cacheDirectory); });
+  return preparedFiles;
+}
+
+} // namespace UploadImages
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <QStringList>
+
+namespace UploadImages {
+
+// Longest edge in pixels from CHATGPT_DESKTOP_UPLOAD_MAX_EDGE, 0 leaves uploads untouched
+int MaxEdge();
+bool IsEnabled();
+// Downscaled copies without metadata for the larger images in files, everything else comes back as it was
+// Runs on a few worker threads, the calling thread blocks until the batch is done
+QStringList Prepare(const QStringList &files);
+
+} // namespace UploadImages